@@ -0,0 +1,106 @@
+#include "Benchmarks.hpp"
+
+#include <BoundaryField.hpp>
+#include <ParticleSet.hpp>
+#include <ParticleSimulation.hpp>
+#include <chrono>         // std::chrono::steady_clock
+#include <glm/common.hpp> // glm::min, glm::max
+#include <iomanip>        // std::setw
+#include <iostream>       // std::cout
+#include <vector>         // std::vector
+
+namespace
+{
+    struct BoundaryRun
+    {
+        double setupSeconds; // Freezing the walls, or integrating the maps of the field
+        double seconds;
+        size_t boundarySamples; // Boundary particles, or nodes of the maps
+    };
+
+    // Simulates a dam break in a tank whose walls are `thickness' particles thick, as particles or as the
+    // boxes of a boundary field.
+    BoundaryRun SimulateDamBreak(bool field, int thickness, float timeStep, float duration)
+    {
+        const float spacing = 3.f;
+        const int countX = 40, countY = 40;
+        std::vector<ParticleSet> particleSets;
+        particleSets.push_back(ParticleSet(countX, countY, spacing, 3e3f, 4e7f, 2e-7f));
+        particleSets.push_back(ParticleSet(3 * countX + 2 * thickness, thickness, spacing, 3e3f, 4e7f, 4e-2f));
+        particleSets.back().TranslateAll(-thickness * spacing, -thickness * spacing);
+        particleSets.push_back(ParticleSet(thickness, 2 * countY, spacing, 3e3f, 4e7f, 4e-2f));
+        particleSets.back().TranslateAll(-thickness * spacing, 0.f);
+        particleSets.push_back(ParticleSet(thickness, 2 * countY, spacing, 3e3f, 4e7f, 4e-2f));
+        particleSets.back().TranslateAll(3.f * countX * spacing, 0.f);
+        ParticleSimulation particleSimulation;
+        particleSimulation.SetPressureSolver(PressureSolver::IISPH);
+        BoundaryField boundaryField;
+        boundaryField.viscosity = 4e-2f;
+        BoundaryRun run = {0., 0., 0};
+        for (size_t s = 0; s < particleSets.size(); s++)
+        {
+            particleSets[s].isBoundary = s > 0;
+            if (s == 0 || !field)
+            {
+                particleSimulation.AddParticleSet(particleSets[s]);
+                run.boundarySamples += s > 0 ? particleSets[s].size() : 0;
+                continue;
+            }
+            glm::vec2 lower = particleSets[s].positions.front(), upper = lower;
+            for (const glm::vec2 &position : particleSets[s].positions)
+            {
+                lower = glm::min(lower, position);
+                upper = glm::max(upper, position);
+            }
+            boundaryField.AddBox(lower - .5f * spacing, upper + .5f * spacing);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        if (field)
+        {
+            particleSimulation.SetBoundaryField(boundaryField);
+            // Integrates the maps
+            particleSimulation.UpdateNeighbors(2.f * spacing);
+            particleSimulation.UpdateParticleQuantities(glm::vec2(0.f, -9.81f));
+            run.boundarySamples = particleSimulation.GetBoundaryField().NodeCount();
+        }
+        else
+        {
+            particleSimulation.FreezeBoundaries(2.f * spacing);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        run.setupSeconds = elapsed.count();
+
+        const int steps = static_cast<int>(duration / timeStep + .5f);
+        start = std::chrono::steady_clock::now();
+        for (int step = 0; step < steps; step++)
+        {
+            particleSimulation.UpdateNeighbors(2.f * spacing);
+            particleSimulation.UpdateParticleQuantities(glm::vec2(0.f, -9.81f));
+            particleSimulation.SolvePressure(timeStep);
+            particleSimulation.UpdateParticlePositions(timeStep);
+        }
+        elapsed = std::chrono::steady_clock::now() - start;
+        run.seconds = elapsed.count();
+        return run;
+    }
+} // namespace
+
+void BenchmarkBoundaries()
+{
+    const float timeStep = .02f, duration = 1.f;
+    std::cout << "Boundaries, time to simulate " << duration << " s of a dam break with IISPH (dt " << timeStep << ")" << std::endl;
+    std::cout << std::setw(12) << "walls" << std::setw(12) << "thickness" << std::setw(12) << "samples"
+              << std::setw(12) << "setup (s)" << std::setw(12) << "seconds" << std::endl;
+    for (int thickness : {3, 10})
+    {
+        for (bool field : {false, true})
+        {
+            const BoundaryRun run = SimulateDamBreak(field, thickness, timeStep, duration);
+            std::cout << std::setw(12) << (field ? "field" : "particles") << std::setw(12) << thickness
+                      << std::setw(12) << run.boundarySamples
+                      << std::setw(12) << std::fixed << std::setprecision(3) << run.setupSeconds
+                      << std::setw(12) << run.seconds << std::defaultfloat << std::endl;
+        }
+    }
+}
@@ -0,0 +1,57 @@
+#include "Benchmarks.hpp"
+
+#include <ParticleSet.hpp>
+#include <ParticleSimulation.hpp>
+#include <chrono>   // std::chrono::steady_clock
+#include <iomanip>  // std::setw
+#include <iostream> // std::cout
+#include <random>   // std::mt19937
+#include <string>   // std::string
+
+void BenchmarkPairwiseForces()
+{
+    const float spacing = 3.f;
+    const glm::vec2 gravity(0.f, -9.81f);
+    const int repetitions = 10;
+    // Jittered fluid block resting on a boundary layer
+    ParticleSet fluid(300, 300, spacing, 3e3f, 4e7f, 2e-7f);
+    std::mt19937 generator(1234);
+    std::uniform_real_distribution<float> jitter(-.1f * spacing, .1f * spacing);
+    for (auto &&particle : fluid.particles)
+    {
+        particle.position.x += jitter(generator);
+        particle.position.y += jitter(generator);
+        particle.velocity = glm::vec2(jitter(generator), jitter(generator));
+    }
+    ParticleSet floor(306, 3, spacing, 3e3f, 4e7f, 4e-2f);
+    floor.TranslateAll(-3.f * spacing, -3.f * spacing);
+    floor.isBoundary = true;
+
+    std::cout << "Density, pressure and forces (" << fluid.size() << " fluid particles)" << std::endl;
+    std::cout << std::setw(14) << "evaluation" << std::setw(12) << "ms/update" << std::setw(16) << "ns/particle" << std::endl;
+    for (int mode = 0; mode < 3; mode++)
+    {
+        // Per-particle, per-particle with SIMD kernel batches, and pairwise evaluation
+        const bool pairwise = mode == 2;
+        ParticleSimulation particleSimulation;
+        particleSimulation.SetPairwiseForces(pairwise);
+        particleSimulation.SetSimdLevel(mode == 1 ? KernelBatch::DetectedLevel() : SimdLevel::Scalar);
+        particleSimulation.AddParticleSet(fluid);
+        particleSimulation.AddParticleSet(floor);
+        particleSimulation.UpdateNeighbors(2.f * spacing);
+        // Warm up (allocates the per-thread buffers)
+        particleSimulation.UpdateParticleQuantities(gravity);
+
+        const auto start = std::chrono::steady_clock::now();
+        for (int repetition = 0; repetition < repetitions; repetition++)
+        {
+            particleSimulation.UpdateParticleQuantities(gravity);
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        const double seconds = elapsed.count() / repetitions;
+        const std::string evaluation = mode == 0 ? "per-particle" : mode == 1 ? std::string("simd ") + KernelBatch::Name(particleSimulation.GetSimdLevel()) : "pairwise";
+        std::cout << std::setw(14) << evaluation
+                  << std::setw(12) << std::fixed << std::setprecision(2) << seconds * 1e3
+                  << std::setw(16) << std::setprecision(1) << seconds * 1e9 / fluid.size() << std::endl;
+    }
+}
@@ -0,0 +1,140 @@
+#include "Benchmarks.hpp"
+
+#include <Kernel.hpp>
+#include <KernelFunctions.hpp>
+#include <KernelTable.hpp>
+#include <ParticleSet.hpp>
+#include <ParticleSimulation.hpp>
+#include <chrono>   // std::chrono::steady_clock
+#include <cmath>    // std::fabs
+#include <iomanip>  // std::setw
+#include <iostream> // std::cout
+#include <random>   // std::mt19937
+
+// Sum of the kernel and of its gradient over the neighbors of the interior particles of a block,
+// returns the mean density error (relative to a particle volume of spacing^2) and the mean
+// gradient error (sum of V grad W, zero for an exact gradient), both dimensionless.
+template <typename KernelFunction>
+static void KernelErrors(const KernelFunction &kernel, const ParticleSet &particleSet, const NeighborTable &table,
+                         int side, double &densityError, double &gradientError)
+{
+    const float volume = particleSet.particleVolume();
+    densityError = gradientError = 0.;
+    int count = 0;
+    for (int y = 3; y < side - 3; y++)
+    {
+        for (int x = 3; x < side - 3; x++)
+        {
+            const size_t i = y * side + x;
+            float density = 0.f;
+            glm::vec2 gradient(0.f, 0.f);
+            for (unsigned j : table.Neighbors(i, 0))
+            {
+                density += kernel.Function(particleSet.positions[i], particleSet.positions[j]);
+                gradient += kernel.Derivative(particleSet.positions[i], particleSet.positions[j]);
+            }
+            densityError += std::fabs(density * volume - 1.f);
+            gradientError += glm::length(gradient) * volume * particleSet.spacing;
+            count++;
+        }
+    }
+    densityError /= count;
+    gradientError /= count;
+}
+
+void BenchmarkKernels()
+{
+    const float spacing = 1.f;
+    const int side = 200;
+    const glm::vec2 gravity(0.f, -9.81f);
+    const int repetitions = 10;
+    ParticleSet lattice(side, side, spacing, 1.f, 0.f, 0.f);
+    ParticleSet jittered = lattice;
+    std::mt19937 generator(1234);
+    std::uniform_real_distribution<float> jitter(-.1f * spacing, .1f * spacing);
+    for (auto &&particle : jittered.particles)
+    {
+        particle.position.x += jitter(generator);
+        particle.position.y += jitter(generator);
+    }
+    ParticleSimulation latticeSimulation, jitteredSimulation;
+    latticeSimulation.AddParticleSet(lattice);
+    latticeSimulation.UpdateNeighbors(2.f * spacing);
+    jitteredSimulation.AddParticleSet(jittered);
+    jitteredSimulation.UpdateNeighbors(2.f * spacing);
+
+    const unsigned tableResolution = 1024;
+    std::cout << "Kernels (support 2h, h = spacing, " << jittered.size() << " jittered particles, tables of "
+              << tableResolution << " samples)" << std::endl;
+    std::cout << std::setw(14) << "kernel" << std::setw(10) << "table" << std::setw(12) << "ns/pair" << std::setw(12) << "ms/update"
+              << std::setw(16) << "density error" << std::setw(16) << "(jittered)" << std::setw(16) << "gradient error" << std::endl;
+    for (KernelType type : Kernel::Types())
+    {
+        KernelTable kernelTable;
+        kernelTable.Build<2>(type, spacing, tableResolution);
+        for (int mode = 0; mode < 3; mode++)
+        {
+            // Analytic kernel, then linear and cubic tables
+            const unsigned resolution = mode == 0 ? 0 : tableResolution;
+            const KernelInterpolation interpolation = mode == 2 ? KernelInterpolation::Cubic : KernelInterpolation::Linear;
+            double densityError = 0., jitteredDensityError = 0., gradientError = 0., unused = 0.;
+            double pairSeconds = 0.;
+            float checksum = 0.f;
+            const auto measure = [&](const auto &kernel) {
+                KernelErrors(kernel, lattice, latticeSimulation.GetNeighborTable(0), side, densityError, unused);
+                KernelErrors(kernel, jittered, jitteredSimulation.GetNeighborTable(0), side, jitteredDensityError, gradientError);
+                // Throughput of a function and a gradient evaluation per neighbor pair
+                const NeighborTable &table = jitteredSimulation.GetNeighborTable(0);
+                const auto start = std::chrono::steady_clock::now();
+                for (int repetition = 0; repetition < repetitions; repetition++)
+                {
+                    for (size_t i = 0; i < jittered.size(); i++)
+                    {
+                        for (unsigned j : table.Neighbors(i, 0))
+                        {
+                            checksum += kernel.Function(jittered.positions[i], jittered.positions[j]);
+                            checksum += kernel.Derivative(jittered.positions[i], jittered.positions[j]).x;
+                        }
+                    }
+                }
+                const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                pairSeconds = elapsed.count() / (repetitions * table.Size());
+            };
+            if (mode == 0)
+            {
+                DispatchKernel<2>(type, spacing, measure);
+            }
+            else if (mode == 1)
+            {
+                measure(TabulatedKernel<2, KernelInterpolation::Linear>(kernelTable));
+            }
+            else
+            {
+                measure(TabulatedKernel<2, KernelInterpolation::Cubic>(kernelTable));
+            }
+            // Full update of the particle quantities
+            ParticleSet fluid = jittered;
+            ParticleSimulation particleSimulation;
+            particleSimulation.SetKernel(type);
+            particleSimulation.SetKernelTable(resolution, interpolation);
+            particleSimulation.AddParticleSet(fluid);
+            particleSimulation.UpdateNeighbors(2.f * spacing);
+            particleSimulation.UpdateParticleQuantities(gravity);
+            const auto start = std::chrono::steady_clock::now();
+            for (int repetition = 0; repetition < repetitions; repetition++)
+            {
+                particleSimulation.UpdateParticleQuantities(gravity);
+            }
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            std::cout << std::setw(14) << Kernel::Name(type)
+                      << std::setw(10) << (mode == 0 ? "-" : mode == 1 ? "linear" : "cubic")
+                      << std::setw(12) << std::fixed << std::setprecision(2) << pairSeconds * 1e9
+                      << std::setw(12) << std::setprecision(2) << elapsed.count() / repetitions * 1e3
+                      << std::setw(16) << std::scientific << std::setprecision(2) << densityError
+                      << std::setw(16) << jitteredDensityError
+                      << std::setw(16) << gradientError << std::defaultfloat
+                      << (checksum == 0.f ? " " : "") << std::endl;
+        }
+    }
+}
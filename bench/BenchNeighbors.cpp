@@ -0,0 +1,47 @@
+#include "Benchmarks.hpp"
+
+#include <ParticleSet.hpp>
+#include <ParticleSimulation.hpp>
+#include <chrono>   // std::chrono::steady_clock
+#include <cmath>    // std::sqrt
+#include <iomanip>  // std::setw
+#include <iostream> // std::cout
+#include <random>   // std::mt19937
+
+void BenchmarkNeighborSearch()
+{
+    const float spacing = 1.f;
+    const float kernelSupport = 2.f * spacing;
+    std::cout << "Neighbor search (jittered square block, search radius = 2 * spacing)" << std::endl;
+    std::cout << std::setw(10) << "particles" << std::setw(14) << "ms/update" << std::setw(18) << "ns/particle" << std::endl;
+    for (int targetCount : {1000, 4000, 16000, 64000, 256000, 1000000})
+    {
+        const int side = static_cast<int>(std::sqrt(static_cast<float>(targetCount)) + .5f);
+        ParticleSet particleSet(side, side, spacing, 1.f, 0.f, 0.f);
+        // Fixed seed so that runs are comparable
+        std::mt19937 generator(1234);
+        std::uniform_real_distribution<float> jitter(-.25f * spacing, .25f * spacing);
+        for (auto &&particle : particleSet.particles)
+        {
+            particle.position.x += jitter(generator);
+            particle.position.y += jitter(generator);
+        }
+        ParticleSimulation particleSimulation;
+        particleSimulation.AddParticleSet(particleSet);
+        // Warm up (allocates the neighbor storage)
+        particleSimulation.UpdateNeighbors(kernelSupport);
+
+        const int repetitions = static_cast<int>(2000000 / particleSet.particles.size()) + 1;
+        const auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < repetitions; r++)
+        {
+            particleSimulation.UpdateNeighbors(kernelSupport);
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        const double seconds = elapsed.count() / repetitions;
+        std::cout << std::setw(10) << particleSet.particles.size()
+                  << std::setw(14) << std::fixed << std::setprecision(3) << seconds * 1e3
+                  << std::setw(18) << std::setprecision(1) << seconds * 1e9 / particleSet.particles.size()
+                  << std::endl;
+    }
+}
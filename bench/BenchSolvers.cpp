@@ -0,0 +1,93 @@
+#include "Benchmarks.hpp"
+
+#include <ParticleSet.hpp>
+#include <ParticleSimulation.hpp>
+#include <chrono>   // std::chrono::steady_clock
+#include <iomanip>  // std::setw
+#include <iostream> // std::cout
+#include <vector>   // std::vector
+
+namespace
+{
+    struct SolverRun
+    {
+        double seconds;
+        int steps;
+        double iterations;   // Average per step
+        double densityError; // Average per step
+    };
+
+    // Simulates a dam break in a tank until `duration'.
+    SolverRun SimulateDamBreak(PressureSolver solver, float timeStep, float duration, float tolerance)
+    {
+        const float spacing = 3.f;
+        const int countX = 40, countY = 40;
+        std::vector<ParticleSet> particleSets;
+        particleSets.push_back(ParticleSet(countX, countY, spacing, 3e3f, 4e7f, 2e-7f));
+        particleSets.push_back(ParticleSet(3 * countX + 6, 3, spacing, 3e3f, 4e7f, 4e-2f));
+        particleSets.back().TranslateAll(-3.f * spacing, -3.f * spacing);
+        particleSets.push_back(ParticleSet(3, 2 * countY, spacing, 3e3f, 4e7f, 4e-2f));
+        particleSets.back().TranslateAll(-3.f * spacing, 0.f);
+        particleSets.push_back(ParticleSet(3, 2 * countY, spacing, 3e3f, 4e7f, 4e-2f));
+        particleSets.back().TranslateAll(3.f * countX * spacing, 0.f);
+        ParticleSimulation particleSimulation;
+        particleSimulation.SetPressureSolver(solver);
+        particleSimulation.SetPressureTolerance(tolerance);
+        for (size_t s = 0; s < particleSets.size(); s++)
+        {
+            particleSets[s].isBoundary = s > 0;
+            particleSimulation.AddParticleSet(particleSets[s]);
+        }
+
+        SolverRun run = {0., static_cast<int>(duration / timeStep + .5f), 0., 0.};
+        const auto start = std::chrono::steady_clock::now();
+        for (int step = 0; step < run.steps; step++)
+        {
+            particleSimulation.UpdateNeighbors(2.f * spacing);
+            particleSimulation.UpdateParticleQuantities(glm::vec2(0.f, -9.81f));
+            particleSimulation.SolvePressure(timeStep);
+            particleSimulation.UpdateParticlePositions(timeStep);
+            run.iterations += particleSimulation.GetPressureIterations();
+            run.densityError += particleSimulation.GetDensityError();
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        run.seconds = elapsed.count();
+        run.iterations /= run.steps;
+        run.densityError /= run.steps;
+        return run;
+    }
+
+    void PrintRun(PressureSolver solver, float timeStep, const SolverRun &run)
+    {
+        std::cout << std::setw(16) << ParticleSimulation::Name(solver)
+                  << std::setw(10) << std::setprecision(4) << timeStep
+                  << std::setw(8) << run.steps
+                  << std::setw(12) << std::fixed << std::setprecision(3) << run.seconds
+                  << std::setw(12) << std::setprecision(1) << run.iterations
+                  << std::setw(16) << std::scientific << std::setprecision(2) << run.densityError
+                  << std::defaultfloat << std::endl;
+    }
+} // namespace
+
+void BenchmarkPressureSolvers()
+{
+    const float duration = 1.f;
+    std::cout << "Pressure solvers, time to simulate " << duration << " s of a dam break" << std::endl;
+    std::cout << std::setw(16) << "solver" << std::setw(10) << "dt" << std::setw(8) << "steps" << std::setw(12) << "seconds"
+              << std::setw(12) << "iterations" << std::setw(16) << "density error" << std::endl;
+    // The iterative solvers reach the average density error of the state equation, at larger steps
+    const float stateEquationStep = 1e-3f;
+    const SolverRun reference = SimulateDamBreak(PressureSolver::StateEquation, stateEquationStep, duration, 0.f);
+    PrintRun(PressureSolver::StateEquation, stateEquationStep, reference);
+    for (PressureSolver solver : ParticleSimulation::PressureSolvers())
+    {
+        if (solver == PressureSolver::StateEquation)
+        {
+            continue;
+        }
+        for (float timeStep : {.01f, .02f, .05f})
+        {
+            PrintRun(solver, timeStep, SimulateDamBreak(solver, timeStep, duration, static_cast<float>(reference.densityError)));
+        }
+    }
+}
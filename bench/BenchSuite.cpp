@@ -0,0 +1,248 @@
+#include "Benchmarks.hpp"
+
+#include <Kernel.hpp>
+#include <KernelBatch.hpp>
+#include <ParticleSet.hpp>
+#include <ParticleSimulation.hpp>
+#include <ThreadPool.hpp>
+#include <chrono>   // std::chrono::steady_clock
+#include <cmath>    // std::sqrt
+#include <fstream>  // std::ofstream
+#include <iomanip>  // std::setw
+#include <iostream> // std::cout
+#include <random>   // std::mt19937
+#include <string>   // std::string
+#include <vector>   // std::vector
+
+#ifndef MYSOLVER_BUILD_TYPE
+#define MYSOLVER_BUILD_TYPE ""
+#endif
+
+namespace
+{
+    // Result of a benchmark case, where an item is a kernel evaluation or a particle moved by one step.
+    struct Result
+    {
+        std::string name;
+        size_t items;           // Items per iteration.
+        unsigned long iterations;
+        double seconds;         // Per iteration.
+    };
+
+    // Runs `iteration' (after one warm-up call) until it has run for at least `minSeconds', doubling the
+    // number of iterations of each attempt, and returns the time per iteration.
+    template <typename Iteration>
+    Result Measure(const std::string &name, size_t items, const Iteration &iteration, double minSeconds = .25)
+    {
+        iteration();
+        unsigned long iterations = 1;
+        while (true)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            for (unsigned long k = 0; k < iterations; k++)
+            {
+                iteration();
+            }
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            if (elapsed.count() >= minSeconds || iterations >= (1ul << 30))
+            {
+                return Result{name, items, iterations, elapsed.count() / iterations};
+            }
+            iterations *= 2;
+        }
+    }
+
+    // Like Measure, but calls `reset' before each iteration, outside of the timing: cases that advance the
+    // simulation then do the same work from the same state, however many iterations a build needs.
+    template <typename Reset, typename Iteration>
+    Result MeasureFrom(const std::string &name, size_t items, const Reset &reset, const Iteration &iteration, double minSeconds = .25)
+    {
+        reset();
+        iteration();
+        unsigned long iterations = 1;
+        while (true)
+        {
+            std::chrono::duration<double> elapsed(0.);
+            for (unsigned long k = 0; k < iterations; k++)
+            {
+                reset();
+                const auto start = std::chrono::steady_clock::now();
+                iteration();
+                elapsed += std::chrono::steady_clock::now() - start;
+            }
+            if (elapsed.count() >= minSeconds || iterations >= (1ul << 30))
+            {
+                return Result{name, items, iterations, elapsed.count() / iterations};
+            }
+            iterations *= 2;
+        }
+    }
+
+    void Print(const Result &result)
+    {
+        std::cout << std::setw(32) << std::left << result.name << std::right
+                  << std::setw(10) << result.items
+                  << std::setw(12) << result.iterations
+                  << std::setw(14) << std::fixed << std::setprecision(3) << result.seconds * 1e3
+                  << std::setw(16) << std::scientific << std::setprecision(3) << result.items / result.seconds
+                  << std::setw(14) << std::fixed << std::setprecision(2) << result.seconds * 1e9 / result.items
+                  << std::defaultfloat << std::endl;
+    }
+
+    // Google Benchmark-like JSON: a context and one entry per case.
+    void WriteJson(const std::string &path, const std::vector<Result> &results)
+    {
+        std::ofstream file(path);
+        file << "{\n  \"context\": {\n"
+             << "    \"build_type\": \"" << MYSOLVER_BUILD_TYPE << "\",\n"
+             << "    \"hardware_threads\": " << ThreadPool::HardwareThreadCount() << ",\n"
+             << "    \"simd\": \"" << KernelBatch::Name(KernelBatch::DetectedLevel()) << "\"\n"
+             << "  },\n  \"benchmarks\": [";
+        for (size_t r = 0; r < results.size(); r++)
+        {
+            const Result &result = results[r];
+            file << (r == 0 ? "\n" : ",\n") << std::setprecision(9)
+                 << "    {\"name\": \"" << result.name << "\", \"items\": " << result.items
+                 << ", \"iterations\": " << result.iterations
+                 << ", \"real_time_ns\": " << result.seconds * 1e9
+                 << ", \"items_per_second\": " << result.items / result.seconds
+                 << ", \"ns_per_item\": " << result.seconds * 1e9 / result.items << "}";
+        }
+        file << "\n  ]\n}\n";
+        std::cout << "Results written to " << path << std::endl;
+    }
+
+    // Box of BoundaryExperiment scaled to a side x side fluid block: a floor and two walls (three
+    // particles thick) around a box twice as wide and as high as the fluid. The fluid is jittered.
+    void MakeScene(int side, float spacing, std::vector<ParticleSet> &particleSets)
+    {
+        particleSets.clear();
+        particleSets.push_back(ParticleSet(side, side, spacing, 3e3f, 4e7f, 2e-7f));
+        std::mt19937 generator(1234);
+        std::uniform_real_distribution<float> jitter(-.1f * spacing, .1f * spacing);
+        for (auto &&particle : particleSets.front().particles)
+        {
+            particle.position.x += jitter(generator);
+            particle.position.y += jitter(generator);
+        }
+        particleSets.push_back(ParticleSet(2 * side + 6, 3, spacing, 3e3f, 4e7f, 4e-2f));
+        particleSets.back().TranslateAll(-3.f * spacing, -3.f * spacing);
+        particleSets.push_back(ParticleSet(3, 2 * side, spacing, 3e3f, 4e7f, 4e-2f));
+        particleSets.back().TranslateAll(-3.f * spacing, 0.f);
+        particleSets.push_back(ParticleSet(3, 2 * side, spacing, 3e3f, 4e7f, 4e-2f));
+        particleSets.back().TranslateAll(2.f * side * spacing, 0.f);
+        for (size_t s = 1; s < particleSets.size(); s++)
+        {
+            particleSets[s].isBoundary = true;
+        }
+    }
+} // namespace
+
+void BenchmarkSuite()
+{
+    const float spacing = 3.f;
+    const float kernelSupport = 2.f * spacing;
+    const glm::vec2 gravity(0.f, -9.81f);
+    const float timeStep = 1e-3f;
+    const int stepsPerIteration = 10;
+    std::vector<Result> results;
+    std::cout << "Benchmark suite (1 thread, items are kernel evaluations or particle steps)" << std::endl;
+    std::cout << std::setw(32) << std::left << "benchmark" << std::right << std::setw(10) << "items" << std::setw(12) << "iterations"
+              << std::setw(14) << "ms/iteration" << std::setw(16) << "items/s" << std::setw(14) << "ns/item" << std::endl;
+    const auto add = [&](const Result &result) {
+        Print(result);
+        results.push_back(result);
+    };
+
+    // Runtime kernels, on pairs of points at random distances within the support
+    {
+        const size_t pairCount = 1 << 16;
+        std::mt19937 generator(1234);
+        std::uniform_real_distribution<float> coordinate(-1.5f * spacing, 1.5f * spacing);
+        std::vector<glm::vec2> points(2 * pairCount);
+        for (auto &&point : points)
+        {
+            point = glm::vec2(coordinate(generator), coordinate(generator));
+        }
+        for (KernelType type : Kernel::Types())
+        {
+            const Kernel kernel(spacing, type);
+            volatile float sink = 0.f;
+            add(Measure(std::string("kernel/function/") + Kernel::Name(type), pairCount, [&] {
+                float sum = 0.f;
+                for (size_t k = 0; k < pairCount; k++)
+                {
+                    sum += kernel.Function(points[2 * k], points[2 * k + 1]);
+                }
+                sink = sum;
+            }));
+            add(Measure(std::string("kernel/derivative/") + Kernel::Name(type), pairCount, [&] {
+                glm::vec2 sum(0.f, 0.f);
+                for (size_t k = 0; k < pairCount; k++)
+                {
+                    sum += kernel.Derivative(points[2 * k], points[2 * k + 1]);
+                }
+                sink = sum.x + sum.y;
+            }));
+        }
+    }
+
+    // Neighbor search alone, on the fluid block
+    for (int side : {32, 100, 316, 1000})
+    {
+        std::vector<ParticleSet> particleSets;
+        MakeScene(side, spacing, particleSets);
+        ParticleSimulation particleSimulation;
+        particleSimulation.AddParticleSet(particleSets.front());
+        add(Measure("neighbors/" + std::to_string(particleSets.front().size()), particleSets.front().size(), [&] {
+            particleSimulation.UpdateNeighbors(kernelSupport);
+        }));
+    }
+
+    // Phases of a step, and the whole step, in the box
+    for (int side : {10, 100, 300})
+    {
+        std::vector<ParticleSet> initialSets, particleSets;
+        MakeScene(side, spacing, initialSets);
+        particleSets = initialSets;
+        ParticleSimulation particleSimulation;
+        for (auto &&particleSet : particleSets)
+        {
+            particleSimulation.AddParticleSet(particleSet);
+        }
+        const size_t fluidCount = particleSets.front().size();
+        const std::string suffix = "/" + std::to_string(fluidCount);
+        particleSimulation.UpdateNeighbors(kernelSupport);
+        add(Measure("quantities" + suffix, fluidCount, [&] {
+            particleSimulation.UpdateParticleQuantities(gravity);
+        }));
+        // The cases that move the particles restart from a fixed state at each iteration, and run a fixed
+        // number of steps from it
+        const std::vector<ParticleSet> updatedSets = particleSets;
+        const auto restore = [&](const std::vector<ParticleSet> &sets) {
+            for (size_t s = 0; s < particleSets.size(); s++)
+            {
+                particleSets[s] = sets[s];
+            }
+        };
+        add(MeasureFrom("positions" + suffix, stepsPerIteration * fluidCount, [&] { restore(updatedSets); }, [&] {
+            for (int step = 0; step < stepsPerIteration; step++)
+            {
+                particleSimulation.UpdateParticlePositions(timeStep);
+            }
+        }));
+        add(MeasureFrom("step" + suffix, stepsPerIteration * fluidCount, [&] { restore(initialSets); }, [&] {
+            for (int step = 0; step < stepsPerIteration; step++)
+            {
+                particleSimulation.UpdateNeighbors(kernelSupport);
+                particleSimulation.UpdateParticleQuantities(gravity);
+                particleSimulation.UpdateParticlePositions(timeStep);
+            }
+        }));
+    }
+
+    if (!JsonOutputPath().empty())
+    {
+        WriteJson(JsonOutputPath(), results);
+    }
+}
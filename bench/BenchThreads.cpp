@@ -0,0 +1,63 @@
+#include "Benchmarks.hpp"
+
+#include <ParticleSet.hpp>
+#include <ParticleSimulation.hpp>
+#include <ThreadPool.hpp>
+#include <chrono>   // std::chrono::steady_clock
+#include <iomanip>  // std::setw
+#include <iostream> // std::cout
+#include <random>   // std::mt19937
+
+void BenchmarkThreadScaling()
+{
+    const float spacing = 3.f;
+    const glm::vec2 gravity(0.f, -9.81f);
+    const float timeStep = 1e-3f;
+    const int steps = 5;
+    // Fixed problem size (strong scaling): a jittered fluid block resting on a boundary layer
+    ParticleSet initialFluid(400, 400, spacing, 3e3f, 4e7f, 2e-7f);
+    std::mt19937 generator(1234);
+    std::uniform_real_distribution<float> jitter(-.1f * spacing, .1f * spacing);
+    for (auto &&particle : initialFluid.particles)
+    {
+        particle.position.x += jitter(generator);
+        particle.position.y += jitter(generator);
+    }
+    ParticleSet floor(406, 3, spacing, 3e3f, 4e7f, 4e-2f);
+    floor.TranslateAll(-3.f * spacing, -3.f * spacing);
+    floor.isBoundary = true;
+
+    std::cout << "Strong scaling of a full simulation step (" << initialFluid.size() << " fluid particles, "
+              << ThreadPool::HardwareThreadCount() << " hardware threads)" << std::endl;
+    std::cout << std::setw(8) << "threads" << std::setw(12) << "ms/step" << std::setw(10) << "speedup" << std::setw(12) << "efficiency" << std::endl;
+    double sequentialSeconds = 0.;
+    for (unsigned threadCount : {1, 2, 4, 8, 16, 32, 64})
+    {
+        ParticleSet fluid = initialFluid;
+        ParticleSimulation particleSimulation;
+        particleSimulation.SetThreadCount(threadCount);
+        particleSimulation.AddParticleSet(fluid);
+        particleSimulation.AddParticleSet(floor);
+        // Warm up (allocates the neighbor storage)
+        particleSimulation.UpdateNeighbors(2.f * spacing);
+
+        const auto start = std::chrono::steady_clock::now();
+        for (int step = 0; step < steps; step++)
+        {
+            particleSimulation.UpdateNeighbors(2.f * spacing);
+            particleSimulation.UpdateParticleQuantities(gravity);
+            particleSimulation.UpdateParticlePositions(timeStep);
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        const double seconds = elapsed.count() / steps;
+        if (threadCount == 1)
+        {
+            sequentialSeconds = seconds;
+        }
+        const double speedup = sequentialSeconds / seconds;
+        std::cout << std::setw(8) << threadCount
+                  << std::setw(12) << std::fixed << std::setprecision(2) << seconds * 1e3
+                  << std::setw(10) << std::setprecision(2) << speedup
+                  << std::setw(11) << std::setprecision(0) << 100. * speedup / threadCount << "%" << std::endl;
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string> // std::string
+
+// Path of the JSON file given with --json (empty if none).
+const std::string &JsonOutputPath();
+
+// Scaling of the neighbor search with the number of particles.
+void BenchmarkNeighborSearch();
+
+// Strong scaling of a full simulation step with the number of threads.
+void BenchmarkThreadScaling();
+
+// Per-particle (scalar and SIMD) against pairwise evaluation of the particle quantities.
+void BenchmarkPairwiseForces();
+
+// Throughput and accuracy of the SPH kernels.
+void BenchmarkKernels();
+
+// Wall-clock time of the pressure solvers to simulate the same time at the same density error.
+void BenchmarkPressureSolvers();
+
+// Boundary particles against a boundary field, for walls of increasing thickness.
+void BenchmarkBoundaries();
+
+// Fixed-seed suite of the kernels, neighbor search, phases and full steps, also written as JSON.
+void BenchmarkSuite();
@@ -0,0 +1,80 @@
+/**
+ * bench-main
+ *
+ * Runs the benchmarks whose names are given as arguments (all of them if none is given).
+ * With --json FILE, the results of the suite are also written to FILE.
+ * Build with -DCMAKE_BUILD_TYPE=Release for meaningful numbers.
+ */
+
+#include "Benchmarks.hpp"
+#include <cstdlib>  // EXIT_SUCCESS
+#include <cstring>  // std::strcmp
+#include <iostream> // std::cerr
+#include <string>   // std::string
+#include <vector>   // std::vector
+
+struct NamedBenchmark
+{
+    const char *name;
+    void (*run)();
+};
+
+static const NamedBenchmark benchmarks[] = {
+    {"neighbors", BenchmarkNeighborSearch},
+    {"threads", BenchmarkThreadScaling},
+    {"forces", BenchmarkPairwiseForces},
+    {"kernels", BenchmarkKernels},
+    {"suite", BenchmarkSuite},
+    {"solvers", BenchmarkPressureSolvers},
+    {"boundaries", BenchmarkBoundaries},
+};
+
+static std::string jsonOutputPath;
+
+const std::string &JsonOutputPath()
+{
+    return jsonOutputPath;
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<const char *> names;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+        {
+            jsonOutputPath = argv[++i];
+        }
+        else
+        {
+            names.push_back(argv[i]);
+        }
+    }
+    bool foundAll = true;
+    for (auto &&benchmark : benchmarks)
+    {
+        bool selected = names.empty();
+        for (const char *name : names)
+        {
+            selected = selected || std::strcmp(name, benchmark.name) == 0;
+        }
+        if (selected)
+        {
+            benchmark.run();
+        }
+    }
+    for (const char *name : names)
+    {
+        bool found = false;
+        for (auto &&benchmark : benchmarks)
+        {
+            found = found || std::strcmp(name, benchmark.name) == 0;
+        }
+        if (!found)
+        {
+            std::cerr << "Unknown benchmark: " << name << std::endl;
+            foundAll = false;
+        }
+    }
+    return foundAll ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,42 @@
+#include "AdaptiveTimeStep.hpp"
+
+#include <glm/common.hpp> // glm::clamp, glm::min
+
+AdaptiveTimeStep::AdaptiveTimeStep(float maxTimeStep)
+    : CFLNumber(.4f), forceNumber(.25f), viscousNumber(.125f),
+      maxGrowth(1.1f),
+      minTimeStep(1e-6f), maxTimeStep(maxTimeStep),
+      current(maxTimeStep), smallest(maxTimeStep)
+{
+}
+
+float AdaptiveTimeStep::Next(const ParticleSimulation &particleSimulation)
+{
+    const float stable = particleSimulation.ComputeTimeStep(CFLNumber, forceNumber, viscousNumber);
+    // Only the growth is limited: a step above the constraints could blow the simulation up
+    current = glm::min(stable, current * maxGrowth);
+    current = glm::clamp(current, minTimeStep, maxTimeStep);
+    smallest = glm::min(smallest, current);
+    return current;
+}
+
+float AdaptiveTimeStep::Current() const
+{
+    return current;
+}
+
+float AdaptiveTimeStep::Smallest() const
+{
+    return smallest;
+}
+
+void AdaptiveTimeStep::Reset()
+{
+    current = smallest = maxTimeStep;
+}
+
+void AdaptiveTimeStep::Resume(float current, float smallest)
+{
+    this->current = current;
+    this->smallest = smallest;
+}
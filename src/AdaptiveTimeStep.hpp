@@ -0,0 +1,33 @@
+#pragma once
+
+#include "ParticleSimulation.hpp"
+
+// Chooses the time step of each simulation step from the stability constraints of the simulation
+// (ParticleSimulation::ComputeTimeStep). The step follows the constraints down at once, but grows by at
+// most a factor maxGrowth from one step to the next, which avoids oscillations; it stays within
+// [minTimeStep, maxTimeStep].
+class AdaptiveTimeStep
+{
+public:
+    // Starts at `maxTimeStep'.
+    explicit AdaptiveTimeStep(float maxTimeStep = .01f);
+    // Next time step, to be called after UpdateParticleQuantities.
+    float Next(const ParticleSimulation &particleSimulation);
+    // Time step returned by the last call to Next (maxTimeStep before the first one).
+    float Current() const;
+    // Smallest time step returned since the last Reset.
+    float Smallest() const;
+    // Starts again from maxTimeStep.
+    void Reset();
+    // Continues from the current and smallest time steps of a saved run (see Checkpoint).
+    void Resume(float current, float smallest);
+
+    // Numbers of the velocity (CFL), force and viscous constraints
+    float CFLNumber, forceNumber, viscousNumber;
+    // Largest factor of increase (> 1) between two steps
+    float maxGrowth;
+    float minTimeStep, maxTimeStep;
+
+private:
+    float current, smallest;
+};
@@ -1,5 +1,18 @@
 #include "BoundaryExperiment.hpp"
 
+#include "Checkpoint.hpp"     // Checkpoint
+#include "HeadlessRunner.hpp" // HeadlessRunner
+#include "Kernel.hpp"         // Kernel::Types, Kernel::Name
+#include "KernelBatch.hpp"    // KernelBatch::Name, KernelBatch::DetectedLevel
+#include "PhaseTimer.hpp"     // PhaseTimings
+#include "ThreadPool.hpp"     // ThreadPool::HardwareThreadCount
+#include <algorithm>          // std::max
+#include <chrono>             // std::chrono::steady_clock
+#include <cstdio>             // std::remove
+#include <glm/common.hpp>     // glm::min, glm::max
+#include <iostream>           // std::cout, std::cerr
+#include <stdexcept>          // std::exception
+
 BoundaryExperiment::BoundaryExperiment()
     : defaultCountX(10), defaultCountY(10),
       defaultSpacing(3.f),
@@ -9,10 +22,41 @@ BoundaryExperiment::BoundaryExperiment()
       defaultBoundaryViscosity(4e-2),
       currentTime(0.f),
       timeStep(.01f),
+      adaptiveTimeStepEnabled(false),
+      adaptiveTimeStep(timeStep),
+      pressureSolver(PressureSolver::StateEquation),
+      pressureTolerance(1e-3f),
+      maxPressureIterations(100),
+      pressureRelaxation(.5f),
       simulationStepsPerRender(5),
+      threadCount(1),
+      verletSkinFactor(0.f),
+      pairwiseForces(false),
+      kernelType(KernelType::CubicSpline),
+      kernelTableResolution(0),
+      cubicKernelTable(false),
+      simdLevel(SimdLevel::Scalar),
+      sdfBoundaries(false),
+      hydrostaticInitialization(false),
+      relaxationSteps(0),
+      relaxationTimeStep(0.f),
+      historyParticle(0),
+      closingCheckpointNeighbors(false),
+      snapshotPath("snapshot.bin"),
+      snapshotInterval(0),
+      stepsSinceSnapshot(0),
+      snapshotNeighbors(false),
+      forkedSnapshots(true),
+      snapshotRequested(false),
+      lastSnapshotPause(0.),
+      maxSnapshotPause(0.),
+      collectingSnapshot(false),
+      writtenSnapshots(0),
+      failedSnapshots(0),
       gravity(0.f, -9.81f),
       graphics(*this)
 {
+    SetHistoryBounds({0}, 512);
     InitializeSimulation(defaultCountX, defaultCountY, defaultSpacing, defaultRestDensity, defaultStiffness, defaultViscosity, defaultBoundaryViscosity);
 }
 
@@ -26,6 +70,222 @@ void BoundaryExperiment::Run()
     graphics.Run();
 }
 
+void BoundaryExperiment::RunHeadless(unsigned long steps)
+{
+    HeadlessRunner(*this).Run(steps);
+}
+
+int BoundaryExperiment::StepsPerUpdate() const
+{
+    return simulationStepsPerRender;
+}
+
+size_t BoundaryExperiment::ParticleCount() const
+{
+    size_t count = 0;
+    for (auto &&particleSet : particleSets)
+    {
+        if (!particleSet.isBoundary)
+        {
+            count += particleSet.size();
+        }
+    }
+    return count;
+}
+
+
+void BoundaryExperiment::SetThreadCount(unsigned threadCount)
+{
+    this->threadCount = static_cast<int>(threadCount);
+    particleSimulation.SetThreadCount(threadCount);
+}
+
+void BoundaryExperiment::SetVerletSkin(float skinFactor)
+{
+    verletSkinFactor = skinFactor;
+    particleSimulation.SetVerletSkin(verletSkinFactor * defaultSpacing);
+}
+
+void BoundaryExperiment::SetPairwiseForces(bool pairwise)
+{
+    pairwiseForces = pairwise;
+    particleSimulation.SetPairwiseForces(pairwiseForces);
+}
+
+void BoundaryExperiment::SetKernel(KernelType type)
+{
+    kernelType = type;
+    particleSimulation.SetKernel(kernelType);
+}
+
+void BoundaryExperiment::SetKernelTable(unsigned resolution, KernelInterpolation interpolation)
+{
+    kernelTableResolution = static_cast<int>(resolution);
+    cubicKernelTable = interpolation == KernelInterpolation::Cubic;
+    particleSimulation.SetKernelTable(resolution, interpolation);
+}
+
+void BoundaryExperiment::SetSimdLevel(SimdLevel level)
+{
+    particleSimulation.SetSimdLevel(level);
+    simdLevel = particleSimulation.GetSimdLevel();
+}
+
+void BoundaryExperiment::SetSdfBoundaries(bool sdf)
+{
+    sdfBoundaries = sdf;
+    InitializeSimulation(defaultCountX, defaultCountY, defaultSpacing, defaultRestDensity, defaultStiffness, defaultViscosity, defaultBoundaryViscosity);
+}
+
+void BoundaryExperiment::SetInitialization(bool hydrostatic, unsigned relaxationSteps, float relaxationTimeStep)
+{
+    hydrostaticInitialization = hydrostatic;
+    this->relaxationSteps = static_cast<int>(relaxationSteps);
+    this->relaxationTimeStep = relaxationTimeStep;
+    InitializeSimulation(defaultCountX, defaultCountY, defaultSpacing, defaultRestDensity, defaultStiffness, defaultViscosity, defaultBoundaryViscosity);
+}
+
+void BoundaryExperiment::SetHistoryBounds(const std::vector<size_t> &trackedParticles, size_t capacity)
+{
+    // 8 levels merging 4 buckets each: 512 recent samples cover the last 11 million steps
+    historyTracker.SetBounds(trackedParticles, capacity, 8, 4);
+    historyParticle = 0;
+}
+
+void BoundaryExperiment::StartRecording(const std::string &path)
+{
+    historyRecorder.Start(path, particleSets.front());
+}
+
+void BoundaryExperiment::SaveCheckpoint(const std::string &path, bool withNeighbors)
+{
+    Checkpoint checkpoint;
+    checkpoint.currentTime = currentTime;
+    checkpoint.timeStep = timeStep;
+    checkpoint.adaptiveTimeStep = adaptiveTimeStep.Current();
+    checkpoint.smallestTimeStep = adaptiveTimeStep.Smallest();
+    if (withNeighbors)
+    {
+        checkpoint.neighbors = particleSimulation.GetNeighborState();
+    }
+    checkpoint.Save(path, particleSets);
+}
+
+void BoundaryExperiment::LoadCheckpoint(const std::string &path)
+{
+    Checkpoint checkpoint;
+    checkpoint.Load(path, particleSets);
+    // The recorded particle set is replaced
+    historyRecorder.Stop();
+    historyTracker.Clear();
+    AddParticleSets();
+    particleSimulation.SetNeighborState(checkpoint.neighbors);
+    currentTime = checkpoint.currentTime;
+    SetTimeStep(checkpoint.timeStep);
+    adaptiveTimeStep.Resume(checkpoint.adaptiveTimeStep, checkpoint.smallestTimeStep);
+}
+
+void BoundaryExperiment::SetCheckpointOnClose(const std::string &path, bool withNeighbors)
+{
+    closingCheckpointPath = path;
+    closingCheckpointNeighbors = withNeighbors;
+}
+
+void BoundaryExperiment::SetSnapshots(const std::string &path, unsigned long interval, bool withNeighbors, bool forked)
+{
+    snapshotPath = path;
+    snapshotInterval = interval;
+    snapshotNeighbors = withNeighbors;
+    forkedSnapshots = forked;
+    stepsSinceSnapshot = 0;
+}
+
+bool BoundaryExperiment::TakeSnapshot()
+{
+    MYSOLVER_TIME_PHASE(Phase::Snapshot);
+    const auto start = std::chrono::steady_clock::now();
+    const std::string path = snapshotPath;
+    const bool withNeighbors = snapshotNeighbors;
+    if (forkedSnapshots)
+    {
+        const auto write = [this, path, withNeighbors] {
+            try
+            {
+                SaveCheckpoint(path, withNeighbors);
+            }
+            catch (const std::exception &exception)
+            {
+                // The parent only learns that the child failed
+                std::cerr << "Snapshot failed: " << exception.what() << std::endl;
+                throw;
+            }
+        };
+        if (!snapshot.Start(write))
+        {
+            return false;
+        }
+        forkedSnapshotPath = path;
+        collectingSnapshot = true;
+    }
+    else
+    {
+        SaveCheckpoint(path, withNeighbors);
+        writtenSnapshots++;
+    }
+    lastSnapshotPause = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    maxSnapshotPause = std::max(maxSnapshotPause, lastSnapshotPause);
+    return true;
+}
+
+void BoundaryExperiment::CollectSnapshot()
+{
+    if (!collectingSnapshot || snapshot.IsWriting())
+    {
+        return;
+    }
+    collectingSnapshot = false;
+    if (snapshot.Succeeded())
+    {
+        writtenSnapshots++;
+        return;
+    }
+    // A child killed while writing leaves its temporary file next to the previous snapshot, which is intact
+    failedSnapshots++;
+    snapshotFailure = "forked snapshot to " + forkedSnapshotPath + " failed";
+    std::remove(Checkpoint::TemporaryPath(forkedSnapshotPath, snapshot.LastChild()).c_str());
+    std::cerr << "Snapshot failed: " << snapshotFailure << std::endl;
+}
+
+void BoundaryExperiment::SetTimeStep(float timeStep)
+{
+    this->timeStep = timeStep;
+    adaptiveTimeStep.maxTimeStep = timeStep;
+    adaptiveTimeStep.Reset();
+}
+
+void BoundaryExperiment::SetAdaptiveTimeStep(bool adaptive)
+{
+    adaptiveTimeStepEnabled = adaptive;
+    adaptiveTimeStep.Reset();
+}
+
+void BoundaryExperiment::SetPressureSolver(PressureSolver solver)
+{
+    pressureSolver = solver;
+    particleSimulation.SetPressureSolver(pressureSolver);
+}
+
+void BoundaryExperiment::SetPressureTolerance(float tolerance)
+{
+    particleSimulation.SetPressureTolerance(tolerance);
+    pressureTolerance = particleSimulation.GetPressureTolerance();
+}
+
+void BoundaryExperiment::SetMaxPressureIterations(unsigned maxIterations)
+{
+    particleSimulation.SetMaxPressureIterations(maxIterations);
+    maxPressureIterations = static_cast<int>(particleSimulation.GetMaxPressureIterations());
+}
 
 void BoundaryExperiment::OnInit()
 {
@@ -39,16 +299,44 @@ void BoundaryExperiment::OnUpdate()
         // Simulation step
         particleSimulation.UpdateNeighbors(2 * defaultSpacing);
         particleSimulation.UpdateParticleQuantities(gravity);
-        particleSimulation.UpdateParticlePositions(timeStep);
-        currentTime += timeStep;
+        adaptiveTimeStep.maxTimeStep = timeStep;
+        const float stepTime = adaptiveTimeStepEnabled ? adaptiveTimeStep.Next(particleSimulation) : timeStep;
+        particleSimulation.SolvePressure(stepTime);
+        particleSimulation.UpdateParticlePositions(stepTime);
+        currentTime += stepTime;
         // Record history (for plotting)
-        historyTracker.Step(currentTime);
+        historyTracker.Step(currentTime, stepTime);
+        historyTracker.RecordPressureSolve(particleSimulation.GetPressureIterations(), particleSimulation.GetDensityError());
+        historyRecorder.Record(currentTime);
+        // Periodic checkpoints, delayed while the previous one is written
+        stepsSinceSnapshot++;
+        CollectSnapshot();
+        if ((snapshotInterval > 0 && stepsSinceSnapshot >= snapshotInterval) || snapshotRequested)
+        {
+            try
+            {
+                if (TakeSnapshot())
+                {
+                    stepsSinceSnapshot = 0;
+                    snapshotRequested = false;
+                }
+            }
+            catch (const std::exception &exception)
+            {
+                std::cerr << "Snapshot failed: " << exception.what() << std::endl;
+                failedSnapshots++;
+                snapshotFailure = exception.what();
+                stepsSinceSnapshot = 0;
+                snapshotRequested = false;
+            }
+        }
     }
     // Update models (for visualization)
     for (auto &&model : _models)
     {
         model->Update();
     }
+    PhaseTimings::Global().EndFrame();
 }
 
 void BoundaryExperiment::OnRender()
@@ -66,38 +354,193 @@ void BoundaryExperiment::OnRender()
     {
         ImGui::Text("t = %f", currentTime);
         ImGui::SameLine();
-        ImGui::InputFloat("Time step", &timeStep, 0.f, 0.f, "%f");
+        ImGui::InputFloat(adaptiveTimeStepEnabled ? "Maximum time step" : "Time step", &timeStep, 0.f, 0.f, "%f");
         ImGui::SliderInt("Simulation steps per render step", &simulationStepsPerRender, 1, 20);
+        if (ImGui::Checkbox("Adaptive time step", &adaptiveTimeStepEnabled))
+        {
+            SetAdaptiveTimeStep(adaptiveTimeStepEnabled);
+        }
+        if (adaptiveTimeStepEnabled)
+        {
+            ImGui::SliderFloat("CFL number", &adaptiveTimeStep.CFLNumber, .05f, 1.f);
+            ImGui::SliderFloat("Force number", &adaptiveTimeStep.forceNumber, .05f, 1.f);
+            ImGui::SliderFloat("Largest growth per step", &adaptiveTimeStep.maxGrowth, 1.f, 2.f);
+            // Steps that a fixed time step small enough for the whole run would have taken
+            const size_t stepCount = historyTracker.StepCount();
+            ImGui::Text("dt = %f (smallest %f), %lu steps instead of %.0f", adaptiveTimeStep.Current(), adaptiveTimeStep.Smallest(),
+                        static_cast<unsigned long>(stepCount), stepCount > 0 ? currentTime / adaptiveTimeStep.Smallest() : 0.f);
+        }
+        if (ImPlot::BeginPlot("Time step", "time", "dt", ImVec2(-1, 150), 0, 0, ImPlotAxisFlags_AutoFit))
+        {
+            PlotHistory("Time step", historyTracker.timeSteps);
+            ImPlot::EndPlot();
+        }
         ImGui::Text("h = %f", defaultSpacing);
         if (ImPlot::BeginPlot("Maximum distance traveled by a particle", "time", "magnitude", ImVec2(-1, 0), 0, 0, ImPlotAxisFlags_AutoFit))
         {
-            ImPlot::PlotLine("Maximum distance", historyTracker.GetTimeHistory().data(), historyTracker.maxDistance.data(), historyTracker.maxDistance.size());
+            PlotHistory("Maximum distance", historyTracker.maxDistance);
             float particleSize[2] = {defaultSpacing, defaultSpacing};
             float time[2] = {0.f, 0.f};
-            if (historyTracker.GetTimeHistory().size() >= 1)
+            if (!historyTracker.maxDistance.Empty())
             {
-                time[0] = historyTracker.GetTimeHistory().front();
-                time[1] = historyTracker.GetTimeHistory().back();
+                time[0] = historyTracker.maxDistance.FirstTime();
+                time[1] = historyTracker.maxDistance.LastTime();
             }
             ImPlot::PlotLine("Particle size", time, particleSize, 2);
 
             ImPlot::EndPlot();
         }
     }
-    if (ImGui::CollapsingHeader("Particle Quantities", ImGuiTreeNodeFlags_DefaultOpen))
+    if (ImGui::CollapsingHeader("Pressure solver"))
+    {
+        ImGui::Text("%s (change on reset)", ParticleSimulation::Name(pressureSolver));
+        if (pressureSolver != PressureSolver::StateEquation)
+        {
+            if (ImGui::InputFloat("Density error tolerance", &pressureTolerance, 0.f, 0.f, "%e"))
+            {
+                SetPressureTolerance(pressureTolerance);
+            }
+            if (ImGui::SliderInt("Maximum iterations", &maxPressureIterations, 1, 500))
+            {
+                SetMaxPressureIterations(static_cast<unsigned>(maxPressureIterations));
+            }
+            if (ImGui::SliderFloat("Relaxation", &pressureRelaxation, .05f, 1.f))
+            {
+                particleSimulation.SetPressureRelaxation(pressureRelaxation);
+            }
+        }
+        if (ImPlot::BeginPlot("Pressure iterations", "time", "iterations", ImVec2(-1, 150), 0, 0, ImPlotAxisFlags_AutoFit))
+        {
+            PlotHistory("Iterations", historyTracker.pressureIterations);
+            ImPlot::EndPlot();
+        }
+        if (ImPlot::BeginPlot("Average density error", "time", "error", ImVec2(-1, 150), 0, 0, ImPlotAxisFlags_AutoFit))
+        {
+            PlotHistory("Density error", historyTracker.densityError);
+            ImPlot::EndPlot();
+        }
+    }
+    if (ImGui::CollapsingHeader("Performance"))
+    {
+        if (ImGui::SliderInt("Threads", &threadCount, 1, static_cast<int>(ThreadPool::HardwareThreadCount())))
+        {
+            particleSimulation.SetThreadCount(threadCount);
+        }
+        if (ImGui::SliderFloat("Verlet skin (x h)", &verletSkinFactor, 0.f, 1.f))
+        {
+            particleSimulation.SetVerletSkin(verletSkinFactor * defaultSpacing);
+        }
+        if (ImGui::Checkbox("Pairwise forces", &pairwiseForces))
+        {
+            particleSimulation.SetPairwiseForces(pairwiseForces);
+        }
+        if (ImGui::SliderInt("Kernel table samples (0: analytic)", &kernelTableResolution, 0, 8192) ||
+            ImGui::Checkbox("Cubic table interpolation", &cubicKernelTable))
+        {
+            SetKernelTable(kernelTableResolution, cubicKernelTable ? KernelInterpolation::Cubic : KernelInterpolation::Linear);
+        }
+        if (ImGui::BeginCombo("SIMD kernel batches", KernelBatch::Name(simdLevel)))
+        {
+            for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512})
+            {
+                if (level <= KernelBatch::DetectedLevel() && ImGui::Selectable(KernelBatch::Name(level), level == simdLevel))
+                {
+                    SetSimdLevel(level);
+                }
+            }
+            ImGui::EndCombo();
+        }
+        ImGui::Text("Neighbor lists rebuilt %lu times in %lu steps",
+                    particleSimulation.GetNeighborRebuildCount(), particleSimulation.GetNeighborUpdateCount());
+        if (historyRecorder.IsRecording())
+        {
+            ImGui::Text("Recording: %lu steps, %lu chunk buffers, %lu stalls", static_cast<unsigned long>(historyRecorder.StepCount()),
+                        static_cast<unsigned long>(historyRecorder.BufferCount()), static_cast<unsigned long>(historyRecorder.StallCount()));
+        }
+        RenderPhaseTimings();
+    }
+    const std::vector<size_t> &trackedParticles = historyTracker.TrackedParticles();
+    if (ImGui::CollapsingHeader("Particle Quantities", ImGuiTreeNodeFlags_DefaultOpen) && !trackedParticles.empty())
     {
-        if (ImPlot::BeginPlot("Properties of the particle of index 0", "time", "magnitude", ImVec2(-1, 0), 0, 0, ImPlotAxisFlags_AutoFit))
+        historyParticle = glm::min(historyParticle, static_cast<int>(trackedParticles.size()) - 1);
+        if (trackedParticles.size() > 1)
+        {
+            ImGui::SliderInt("Tracked particle", &historyParticle, 0, static_cast<int>(trackedParticles.size()) - 1);
+        }
+        ImGui::Text("Particle of index %lu, %lu steps in %lu samples", static_cast<unsigned long>(trackedParticles[historyParticle]),
+                    static_cast<unsigned long>(historyTracker.StepCount()), static_cast<unsigned long>(historyTracker.density[historyParticle].Size()));
+        if (ImPlot::BeginPlot("Properties of the tracked particle", "time", "magnitude", ImVec2(-1, 0), 0, 0, ImPlotAxisFlags_AutoFit))
         {
             ImPlot::SetLegendLocation(ImPlotLocation_South, ImPlotOrientation_Vertical, true);
-            ImPlot::PlotLine("Density", historyTracker.GetTimeHistory().data(), historyTracker.density[0].data(), historyTracker.density[0].size());
-            ImPlot::PlotLine("Pressure", historyTracker.GetTimeHistory().data(), historyTracker.pressure[0].data(), historyTracker.pressure[0].size());
-            ImPlot::PlotLine("Pressure acceleration", historyTracker.GetTimeHistory().data(), historyTracker.pressureAcceleration[0].data(), historyTracker.pressureAcceleration[0].size());
-            ImPlot::PlotLine("Viscosity acceleration", historyTracker.GetTimeHistory().data(), historyTracker.viscosityAcceleration[0].data(), historyTracker.viscosityAcceleration[0].size());
-            ImPlot::PlotLine("Other accelerations", historyTracker.GetTimeHistory().data(), historyTracker.otherAccelerations[0].data(), historyTracker.otherAccelerations[0].size());
-            ImPlot::PlotLine("Velocity", historyTracker.GetTimeHistory().data(), historyTracker.velocity[0].data(), historyTracker.velocity[0].size());
+            PlotHistory("Density", historyTracker.density[historyParticle]);
+            PlotHistory("Pressure", historyTracker.pressure[historyParticle]);
+            PlotHistory("Pressure acceleration", historyTracker.pressureAcceleration[historyParticle]);
+            PlotHistory("Viscosity acceleration", historyTracker.viscosityAcceleration[historyParticle]);
+            PlotHistory("Other accelerations", historyTracker.otherAccelerations[historyParticle]);
+            PlotHistory("Velocity", historyTracker.velocity[historyParticle]);
             ImPlot::EndPlot();
         }
     }
+    if (ImGui::CollapsingHeader("Checkpoint"))
+    {
+        static char checkpointPath[256] = "checkpoint.bin";
+        static bool checkpointNeighbors = false;
+        static std::string checkpointStatus;
+        ImGui::InputText("File", checkpointPath, sizeof(checkpointPath));
+        ImGui::Checkbox("With neighbor lists", &checkpointNeighbors);
+        try
+        {
+            if (ImGui::Button("Save"))
+            {
+                SaveCheckpoint(checkpointPath, checkpointNeighbors);
+                checkpointStatus = "Saved at t = " + std::to_string(currentTime);
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Load"))
+            {
+                LoadCheckpoint(checkpointPath);
+                InitializeModels();
+                checkpointStatus = "Loaded at t = " + std::to_string(currentTime);
+            }
+        }
+        catch (const std::exception &exception)
+        {
+            checkpointStatus = exception.what();
+        }
+        ImGui::TextUnformatted(checkpointStatus.c_str());
+        // Snapshots are taken by OnUpdate, between two steps
+        ImGui::Separator();
+        ImGui::Checkbox("Forked snapshots", &forkedSnapshots);
+        ImGui::SameLine();
+        if (ImGui::Button("Snapshot"))
+        {
+            snapshotPath = checkpointPath;
+            snapshotNeighbors = checkpointNeighbors;
+            snapshotRequested = true;
+        }
+        CollectSnapshot();
+        const bool writing = snapshot.IsWriting();
+        if (writtenSnapshots + failedSnapshots > 0)
+        {
+            ImGui::Text("Snapshots: %lu written, %lu failed", writtenSnapshots, failedSnapshots);
+        }
+        if (failedSnapshots > 0)
+        {
+            ImGui::Text("Last failure: %s", snapshotFailure.c_str());
+        }
+        if (lastSnapshotPause > 0.)
+        {
+            ImGui::Text("Last snapshot: paused %.2f ms (longest %.2f ms)", 1e3 * lastSnapshotPause, 1e3 * maxSnapshotPause);
+        }
+        if (writing)
+        {
+            ImGui::TextUnformatted("Writing...");
+        }
+        else if (snapshot.WrittenCount() + snapshot.FailedCount() > 0)
+        {
+            ImGui::Text("Forked snapshot %s in %.2f s", snapshot.Succeeded() ? "written" : "failed", snapshot.WriteSeconds());
+        }
+    }
     if (ImGui::CollapsingHeader("Reset simulation", ImGuiTreeNodeFlags_DefaultOpen))
     {
         ImGui::Text("Number of particles");
@@ -119,12 +562,52 @@ void BoundaryExperiment::OnRender()
         static float newBoundaryViscosity = defaultBoundaryViscosity;
         ImGui::InputFloat("Boundary viscosity", &newBoundaryViscosity, 0.0F, 0.0F, "%e");
 
+        static KernelType newKernelType = kernelType;
+        if (ImGui::BeginCombo("Kernel", Kernel::Name(newKernelType)))
+        {
+            for (KernelType type : Kernel::Types())
+            {
+                if (ImGui::Selectable(Kernel::Name(type), type == newKernelType))
+                {
+                    newKernelType = type;
+                }
+            }
+            ImGui::EndCombo();
+        }
+
+        static PressureSolver newPressureSolver = pressureSolver;
+        if (ImGui::BeginCombo("Pressure solver", ParticleSimulation::Name(newPressureSolver)))
+        {
+            for (PressureSolver solver : ParticleSimulation::PressureSolvers())
+            {
+                if (ImGui::Selectable(ParticleSimulation::Name(solver), solver == newPressureSolver))
+                {
+                    newPressureSolver = solver;
+                }
+            }
+            ImGui::EndCombo();
+        }
+
+        static bool newSdfBoundaries = sdfBoundaries;
+        ImGui::Checkbox("SDF boundaries", &newSdfBoundaries);
+
+        ImGui::Checkbox("Hydrostatic initialization", &hydrostaticInitialization);
+        ImGui::SliderInt("Relaxation steps", &relaxationSteps, 0, 500);
+        ImGui::InputFloat("Relaxation time step", &relaxationTimeStep, 0.0F, 0.0F, "%e");
+
         if (ImGui::Button("Reset"))
         {
             historyTracker.Clear();
+            // The recorded particle set is replaced
+            historyRecorder.Stop();
+            sdfBoundaries = newSdfBoundaries;
+            // The initialization depends on the kernel and the solver
+            SetKernel(newKernelType);
+            SetPressureSolver(newPressureSolver);
             InitializeSimulation(newNoParticlesX, newNoParticlesY, defaultSpacing, newRestDensity, newStiffness, newViscosity, newBoundaryViscosity);
             InitializeModels();
             currentTime = 0.f;
+            adaptiveTimeStep.Reset();
         }
     }
     ImGui::End();
@@ -132,6 +615,82 @@ void BoundaryExperiment::OnRender()
 
 void BoundaryExperiment::OnClose()
 {
+    historyRecorder.Stop();
+    snapshot.Wait();
+    CollectSnapshot();
+    if (writtenSnapshots + failedSnapshots > 0)
+    {
+        std::cout << "Snapshots: " << writtenSnapshots << " written, " << failedSnapshots << " failed, "
+                  << "longest pause " << 1e3 * maxSnapshotPause << " ms" << std::endl;
+    }
+    if (!closingCheckpointPath.empty())
+    {
+        SaveCheckpoint(closingCheckpointPath, closingCheckpointNeighbors);
+    }
+}
+
+void BoundaryExperiment::PlotHistory(const char *label, const HistoryBuffer &history)
+{
+    static std::vector<float> times, values;
+    history.Linearize(times, values);
+    ImPlot::PlotLine(label, times.data(), values.data(), static_cast<int>(times.size()));
+}
+
+void BoundaryExperiment::RenderPhaseTimings()
+{
+#ifdef MYSOLVER_PHASE_TIMERS
+    const PhaseTimings &timings = PhaseTimings::Global();
+    const int frameCount = static_cast<int>(timings.FrameCount());
+    if (ImGui::BeginTable("Phase timings", 4))
+    {
+        ImGui::TableSetupColumn("Phase (ms per update)");
+        ImGui::TableSetupColumn("mean");
+        ImGui::TableSetupColumn("p50");
+        ImGui::TableSetupColumn("p99");
+        ImGui::TableHeadersRow();
+        for (size_t p = 0; p < PhaseTimings::phaseCount; p++)
+        {
+            const Phase phase = static_cast<Phase>(p);
+            const PhaseTimings::Statistics statistics = timings.GetStatistics(phase);
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(PhaseTimings::Name(phase));
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", statistics.mean);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", statistics.p50);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", statistics.p99);
+        }
+        ImGui::EndTable();
+    }
+    // Stacked areas: each phase is drawn between the sum of the previous phases and the sum including it
+    static std::vector<float> frames, lower, upper, phaseHistory;
+    frames.resize(frameCount);
+    lower.assign(frameCount, 0.f);
+    upper.assign(frameCount, 0.f);
+    for (int k = 0; k < frameCount; k++)
+    {
+        frames[k] = static_cast<float>(k - frameCount + 1);
+    }
+    if (ImPlot::BeginPlot("Time per update", "update", "ms", ImVec2(-1, 0), 0, ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit))
+    {
+        for (size_t p = 0; p < PhaseTimings::phaseCount; p++)
+        {
+            const Phase phase = static_cast<Phase>(p);
+            timings.GetHistory(phase, phaseHistory);
+            for (int k = 0; k < frameCount; k++)
+            {
+                upper[k] = lower[k] + phaseHistory[k];
+            }
+            ImPlot::PlotShaded(PhaseTimings::Name(phase), frames.data(), lower.data(), upper.data(), frameCount);
+            lower.swap(upper);
+        }
+        ImPlot::EndPlot();
+    }
+#else
+    ImGui::TextUnformatted("Phase timers disabled (MYSOLVER_PHASE_TIMERS=OFF)");
+#endif
 }
 
 void BoundaryExperiment::InitializeSimulation(int countX, int countY, float spacing, float restDensity, float stiffness, float viscosity, float boundaryViscosity)
@@ -141,6 +700,11 @@ void BoundaryExperiment::InitializeSimulation(int countX, int countY, float spac
 
     // - Fluid
     particleSets.push_back(ParticleSet(countX, countY, spacing, restDensity, stiffness, viscosity));
+    if (hydrostaticInitialization)
+    {
+        // Only the state equation needs a compressed fluid to have a pressure
+        particleSets.back().InitHydrostatic(-gravity.y, pressureSolver == PressureSolver::StateEquation);
+    }
 
     // - Boundaries
     particleSets.push_back(ParticleSet(26, 3, spacing, restDensity, stiffness, boundaryViscosity));
@@ -155,15 +719,49 @@ void BoundaryExperiment::InitializeSimulation(int countX, int countY, float spac
     particleSets.back().TranslateAll(20.f * spacing, 0.f * spacing);
     particleSets.back().isBoundary = true;
 
+    AddParticleSets();
+    if (relaxationSteps > 0)
+    {
+        particleSimulation.Relax(2.f * defaultSpacing, gravity, relaxationTimeStep > 0.f ? relaxationTimeStep : timeStep, relaxationSteps);
+    }
+}
+
+void BoundaryExperiment::AddParticleSets()
+{
     // Bind history tracker to the particle fluid
     historyTracker.SetTarget(&particleSets.front());
 
     // Add particle sets to simulation
     particleSimulation.Clear();
+    if (sdfBoundaries)
+    {
+        // The walls are the boxes covered by their particles, which are only displayed
+        BoundaryField boundaryField;
+        for (auto &&ps : particleSets)
+        {
+            if (!ps.isBoundary)
+            {
+                particleSimulation.AddParticleSet(ps);
+                continue;
+            }
+            glm::vec2 lower = ps.positions.front(), upper = ps.positions.front();
+            for (auto &&position : ps.positions)
+            {
+                lower = glm::min(lower, position);
+                upper = glm::max(upper, position);
+            }
+            boundaryField.AddBox(lower - .5f * ps.spacing, upper + .5f * ps.spacing);
+            boundaryField.viscosity = ps.viscosity;
+        }
+        particleSimulation.SetBoundaryField(boundaryField);
+        return;
+    }
     for (auto &&ps : particleSets)
     {
         particleSimulation.AddParticleSet(ps);
     }
+    // The walls never move: build their grids and volumes once, for the kernel support plus the Verlet skin
+    particleSimulation.FreezeBoundaries(2.f * defaultSpacing + particleSimulation.GetVerletSkin());
 }
 
 void BoundaryExperiment::InitializeModels()
@@ -1,6 +1,7 @@
 #pragma once
 
 // Project headers
+#include "AdaptiveTimeStep.hpp"
 #include "Experiment.hpp"
 #include "Graphics.hpp"
 #include "ParticleSet.hpp"
@@ -8,12 +9,15 @@
 #include "Model.hpp"
 #include "ParticleSetModel.hpp"
 #include "HistoryTracker.hpp"
+#include "HistoryRecorder.hpp"
+#include "ForkedSnapshot.hpp"
 // Third-party libraries
 #include "imgui/imgui.h"           // ImGui::, for displaying user controls in a graphical frame
 #include "imgui/implot.h"          // ImPlot::, for plots within ImGui frames
 #include <glm/vec2.hpp>            // glm::, for vector maths
 #include <glm/gtx/string_cast.hpp> // for casting glm:: objects to string (debug)
 // Standard C++ libraries
+#include <string>
 #include <vector>
 
 // Experiment where a fluid body and some boundaries are simulated.
@@ -24,6 +28,54 @@ public:
     const std::vector<Model *> &models();
     // Starts simulation and visualization.
     void Run();
+    // Runs `steps' simulation steps without visualization and prints the throughput.
+    void RunHeadless(unsigned long steps);
+    int StepsPerUpdate() const;
+    size_t ParticleCount() const;
+    // Number of threads used by the simulation.
+    void SetThreadCount(unsigned threadCount);
+    // Verlet skin of the neighbor lists, in multiples of the particle spacing (0 disables list reuse).
+    void SetVerletSkin(float skinFactor);
+    // Evaluates the forces once per pair of fluid particles.
+    void SetPairwiseForces(bool pairwise);
+    // SPH kernel of the simulation (also selectable when resetting from the GUI).
+    void SetKernel(KernelType type);
+    // Evaluates the kernel from a table of `resolution' samples (0 for the analytic kernel).
+    void SetKernelTable(unsigned resolution, KernelInterpolation interpolation);
+    // Instruction set of the batched cubic spline evaluation (Scalar disables batches).
+    void SetSimdLevel(SimdLevel level);
+    // Models the walls by the boxes of a BoundaryField instead of boundary particles (resets the scene).
+    void SetSdfBoundaries(bool sdf);
+    // Starts the fluid at hydrostatic pressure (see ParticleSet::InitHydrostatic), compressed for the state
+    // equation, then lets it settle for `relaxationSteps' damped steps of `relaxationTimeStep' (of the time step
+    // if 0) before t = 0 (resets the scene, with the current pressure solver).
+    void SetInitialization(bool hydrostatic, unsigned relaxationSteps, float relaxationTimeStep = 0.f);
+    // Records the history of the particles of indices `trackedParticles' only (all of them if empty), in
+    // `capacity' recent samples and older min/max buckets (see HistoryBuffer; 0 keeps every sample).
+    void SetHistoryBounds(const std::vector<size_t> &trackedParticles, size_t capacity);
+    // Streams the state of the fluid at every step into the history file at `path' (see HistoryRecorder),
+    // until the simulation is closed or reset.
+    void StartRecording(const std::string &path);
+    // Saves the particle sets, the time and the time steps, and the neighbor lists if `withNeighbors', to
+    // the checkpoint at `path' (see Checkpoint).
+    void SaveCheckpoint(const std::string &path, bool withNeighbors);
+    // Resumes the simulation from the checkpoint at `path', with the current settings.
+    void LoadCheckpoint(const std::string &path);
+    // Checkpoint written when the simulation is closed (none if empty).
+    void SetCheckpointOnClose(const std::string &path, bool withNeighbors);
+    // Saves a checkpoint to `path' every `interval' steps (never if 0), from a forked child process that
+    // writes it while the simulation continues (see ForkedSnapshot), or from the simulation thread if `forked'
+    // is false. The pause of each update is timed as the Snapshot phase.
+    void SetSnapshots(const std::string &path, unsigned long interval, bool withNeighbors, bool forked = true);
+    // Fixed time step, or largest adaptive time step.
+    void SetTimeStep(float timeStep);
+    // Chooses each time step from the stability constraints (see AdaptiveTimeStep), up to the fixed time step.
+    void SetAdaptiveTimeStep(bool adaptive);
+    // Pressure model of the simulation (also selectable when resetting from the GUI).
+    void SetPressureSolver(PressureSolver solver);
+    // Average density error and iteration limit of the iterative pressure solvers.
+    void SetPressureTolerance(float tolerance);
+    void SetMaxPressureIterations(unsigned maxIterations);
     // CALLBACKS
     void OnInit();
     // Updates the particle sets for 1 render step
@@ -35,8 +87,18 @@ public:
 private:
     // Setup fluid body and boundaries
     void InitializeSimulation(int countX, int countY, float spacing, float restDensity, float stiffness, float viscosity, float boundaryViscosity);
+    // Saves a checkpoint to snapshotPath, forked or not; returns false if the previous one is still being written.
+    bool TakeSnapshot();
+    // Counts the forked snapshot once its child is done, and removes the temporary file of a failed one.
+    void CollectSnapshot();
+    // Adds the particle sets to the simulation, the walls as a boundary field with sdfBoundaries
+    void AddParticleSets();
     // Initialize a graphical model for each particle set
     void InitializeModels();
+    // Line plot of a history, with the minimum and maximum of its older buckets
+    void PlotHistory(const char *label, const HistoryBuffer &history);
+    // Statistics and stacked plot of the time spent in each phase of the updates
+    void RenderPhaseTimings();
 
 private:
     // Initial properties of the particle sets
@@ -49,14 +111,45 @@ private:
     const float defaultBoundaryViscosity;
     // Simulation parameters
     float currentTime;
-    float timeStep;
+    float timeStep; // Fixed time step, or largest adaptive time step
+    bool adaptiveTimeStepEnabled;
+    AdaptiveTimeStep adaptiveTimeStep;
+    PressureSolver pressureSolver;
+    float pressureTolerance;
+    int maxPressureIterations;
+    float pressureRelaxation;
     int simulationStepsPerRender;
+    int threadCount;
+    float verletSkinFactor;
+    bool pairwiseForces;
+    KernelType kernelType;
+    int kernelTableResolution;
+    bool cubicKernelTable;
+    SimdLevel simdLevel;
+    bool sdfBoundaries;
+    bool hydrostaticInitialization;
+    int relaxationSteps;
+    float relaxationTimeStep; // 0 for the time step
+    int historyParticle; // Index in the tracked particles of the plotted particle
+    std::string closingCheckpointPath;
+    bool closingCheckpointNeighbors;
+    // Periodic checkpoints
+    ForkedSnapshot snapshot;
+    std::string snapshotPath;
+    unsigned long snapshotInterval, stepsSinceSnapshot;
+    bool snapshotNeighbors, forkedSnapshots, snapshotRequested;
+    double lastSnapshotPause, maxSnapshotPause; // Seconds
+    std::string forkedSnapshotPath; // Of the snapshot being written by the child
+    bool collectingSnapshot;
+    unsigned long writtenSnapshots, failedSnapshots; // Forked or not
+    std::string snapshotFailure; // Reason of the last failed snapshot
     const glm::vec2 gravity;
     // Simulation entities
     std::vector<ParticleSet> particleSets;
     ParticleSimulation particleSimulation;
     // Simulation history
     HistoryTracker historyTracker;
+    HistoryRecorder historyRecorder;
     // Visualization entities
     Graphics graphics;
     std::vector<Model *> _models;
@@ -0,0 +1,393 @@
+#include "BoundaryField.hpp"
+
+#include "ThreadPool.hpp"    // ThreadPool
+#include <algorithm>         // std::min
+#include <cmath>             // std::ceil, std::sqrt
+#include <glm/common.hpp>    // glm::abs, glm::clamp, glm::max, glm::min
+#include <glm/geometric.hpp> // glm::dot, glm::length, glm::normalize
+#include <glm/matrix.hpp>    // glm::outerProduct
+#include <limits>            // std::numeric_limits
+
+namespace
+{
+    // Nodes of the maps per smoothing length, cells of the quadrature per node spacing, and nodes per
+    // side of a tile
+    const int nodesPerSpacing = 4;
+    const int cellsPerNode = 4;
+    const int tileSize = 8;
+    // Tiles that are not stored
+    const int emptyTile = -1;
+    const int fullTile = -2;
+} // namespace
+
+BoundaryField::BoundaryField()
+    : viscosity(0.f), hasDomain(false), domainLower(0.f), domainUpper(0.f),
+      mapsValid(false), mapKernel(KernelType::CubicSpline), mapSpacing(0.f),
+      origin(0.f), nodeSpacing(0.f), countX(0), countY(0), tileCountX(0),
+      fullVolume(0.f), fullViscosity(0.f)
+{
+}
+
+void BoundaryField::AddBox(const glm::vec2 &lower, const glm::vec2 &upper)
+{
+    shapes.push_back(Shape{ShapeType::Box, {glm::min(lower, upper), glm::max(lower, upper)}, glm::vec2(0.f)});
+    mapsValid = false;
+}
+
+void BoundaryField::AddHalfPlane(const glm::vec2 &point, const glm::vec2 &normal)
+{
+    shapes.push_back(Shape{ShapeType::HalfPlane, {point}, glm::normalize(normal)});
+    mapsValid = false;
+}
+
+void BoundaryField::AddPolygon(const std::vector<glm::vec2> &vertices)
+{
+    if (vertices.size() >= 3)
+    {
+        shapes.push_back(Shape{ShapeType::Polygon, vertices, glm::vec2(0.f)});
+        mapsValid = false;
+    }
+}
+
+void BoundaryField::SetDomain(const glm::vec2 &lower, const glm::vec2 &upper)
+{
+    hasDomain = true;
+    domainLower = glm::min(lower, upper);
+    domainUpper = glm::max(lower, upper);
+    mapsValid = false;
+}
+
+void BoundaryField::Clear()
+{
+    shapes.clear();
+    hasDomain = false;
+    mapsValid = false;
+    countX = countY = tileCountX = 0;
+    tiles.clear();
+    volumes.clear();
+    gradients.clear();
+    viscosities.clear();
+}
+
+bool BoundaryField::Empty() const
+{
+    return shapes.empty();
+}
+
+float BoundaryField::SignedDistance(const glm::vec2 &position) const
+{
+    float distance = std::numeric_limits<float>::max();
+    for (const Shape &shape : shapes)
+    {
+        if (shape.type == ShapeType::Box)
+        {
+            const glm::vec2 center = .5f * (shape.points[0] + shape.points[1]);
+            const glm::vec2 d = glm::abs(position - center) - .5f * (shape.points[1] - shape.points[0]);
+            distance = std::min(distance, glm::length(glm::max(d, 0.f)) + std::min(std::max(d.x, d.y), 0.f));
+        }
+        else if (shape.type == ShapeType::HalfPlane)
+        {
+            distance = std::min(distance, glm::dot(position - shape.points[0], shape.normal));
+        }
+        else
+        {
+            // Distance to the closest edge, negated inside (even-odd crossings of a ray towards +x)
+            const std::vector<glm::vec2> &v = shape.points;
+            float distance2 = std::numeric_limits<float>::max();
+            bool inside = false;
+            for (size_t i = 0, j = v.size() - 1; i < v.size(); j = i++)
+            {
+                const glm::vec2 edge = v[j] - v[i];
+                const glm::vec2 w = position - v[i];
+                const glm::vec2 b = w - edge * glm::clamp(glm::dot(w, edge) / glm::dot(edge, edge), 0.f, 1.f);
+                distance2 = std::min(distance2, glm::dot(b, b));
+                if ((v[i].y > position.y) != (v[j].y > position.y) &&
+                    position.x < v[i].x + (position.y - v[i].y) * edge.x / edge.y)
+                {
+                    inside = !inside;
+                }
+            }
+            distance = std::min(distance, (inside ? -1.f : 1.f) * std::sqrt(distance2));
+        }
+    }
+    return distance;
+}
+
+void BoundaryField::Update(KernelType type, float spacing, ThreadPool *threadPool)
+{
+    if (mapsValid && mapKernel == type && mapSpacing == spacing)
+    {
+        return;
+    }
+    mapsValid = true;
+    mapKernel = type;
+    mapSpacing = spacing;
+    countX = countY = tileCountX = 0;
+    tiles.clear();
+    volumes.clear();
+    gradients.clear();
+    viscosities.clear();
+    // Bounded region of the maps: the domain and the bounded shapes
+    glm::vec2 lower(std::numeric_limits<float>::max()), upper(std::numeric_limits<float>::lowest());
+    if (hasDomain)
+    {
+        lower = domainLower;
+        upper = domainUpper;
+    }
+    for (const Shape &shape : shapes)
+    {
+        if (shape.type != ShapeType::HalfPlane)
+        {
+            for (const glm::vec2 &point : shape.points)
+            {
+                lower = glm::min(lower, point);
+                upper = glm::max(upper, point);
+            }
+        }
+    }
+    if (shapes.empty() || lower.x > upper.x)
+    {
+        return;
+    }
+
+    ThreadPool serial(1);
+    ThreadPool &pool = threadPool != nullptr ? *threadPool : serial;
+    const float viscosityEpsilon = 0.01f * spacing * spacing;
+    DispatchKernel<2>(type, spacing, [&](const auto &kernel) {
+        const float support = kernel.SupportRadius();
+        nodeSpacing = spacing / nodesPerSpacing;
+        origin = lower - glm::vec2(support);
+        countX = static_cast<int>(std::ceil((upper.x - lower.x + 2.f * support) / nodeSpacing)) + 1;
+        countY = static_cast<int>(std::ceil((upper.y - lower.y + 2.f * support) / nodeSpacing)) + 1;
+
+        // Quadrature cells within the support of a node, whose contribution only depends on their offset:
+        // cell (a, b) of a node spans [a, a + 1] x [b, b + 1] cell sizes from it
+        const float cellSize = nodeSpacing / cellsPerNode;
+        const int margin = static_cast<int>(std::ceil(support / cellSize));
+        struct StencilCell
+        {
+            int a, b;
+            float volume;
+            glm::vec2 gradient;
+            glm::mat2 viscosity;
+        };
+        std::vector<StencilCell> stencil;
+        const float cellArea = cellSize * cellSize;
+        for (int b = -margin; b < margin; b++)
+        {
+            for (int a = -margin; a < margin; a++)
+            {
+                const glm::vec2 r = -cellSize * glm::vec2(a + .5f, b + .5f); // x - y
+                if (glm::dot(r, r) < support * support)
+                {
+                    const glm::vec2 gradient = cellArea * kernel.Derivative(r, glm::vec2(0.f));
+                    stencil.push_back(StencilCell{a, b, cellArea * kernel.Function(r, glm::vec2(0.f)), gradient,
+                                                  glm::outerProduct(gradient, r) / (glm::dot(r, r) + viscosityEpsilon)});
+                }
+            }
+        }
+
+        // The quadrature of the fluid density over neighbors 1 spacing apart is coarse: scale the maps so that
+        // a flat wall contributes to a particle 1 spacing away as much as a wall of particles of that spacing
+        // (whose surface lies half a spacing in front of them)
+        float wallVolume = 0.f, fieldVolume = 0.f;
+        const int rows = static_cast<int>(std::ceil(support / spacing));
+        for (int b = 1; b <= rows; b++)
+        {
+            for (int a = -rows; a <= rows; a++)
+            {
+                wallVolume += spacing * spacing * kernel.Function(glm::vec2(0.f), spacing * glm::vec2(a, -b));
+            }
+        }
+        for (const StencilCell &cell : stencil)
+        {
+            if ((cell.b + .5f) * cellSize <= -.5f * spacing)
+            {
+                fieldVolume += cell.volume;
+            }
+        }
+        const float scale = fieldVolume > 0.f ? wallVolume / fieldVolume : 1.f;
+        fullVolume = 0.f;
+        fullViscosity = glm::mat2(0.f);
+        for (StencilCell &cell : stencil)
+        {
+            cell.volume *= scale;
+            cell.gradient *= scale;
+            cell.viscosity *= scale;
+            fullVolume += cell.volume;
+            fullViscosity += cell.viscosity;
+        }
+
+        // Nodes further than the support (plus a cell) from the surface are entirely outside or inside S,
+        // and so are the tiles whose center is further than that plus their half diagonal
+        const float band = support + 2.f * cellSize;
+        tileCountX = (countX + tileSize - 1) / tileSize;
+        const int tileCountY = (countY + tileSize - 1) / tileSize;
+        const float tileRadius = .5f * std::sqrt(2.f) * (tileSize - 1) * nodeSpacing;
+        tiles.assign(static_cast<size_t>(tileCountX) * tileCountY, emptyTile);
+        int storedNodes = 0;
+        for (int ty = 0; ty < tileCountY; ty++)
+        {
+            for (int tx = 0; tx < tileCountX; tx++)
+            {
+                const glm::vec2 center = origin + nodeSpacing * (glm::vec2(tx, ty) * float(tileSize) + .5f * (tileSize - 1));
+                const float distance = SignedDistance(center);
+                int &tile = tiles[static_cast<size_t>(ty) * tileCountX + tx];
+                if (distance >= band + tileRadius)
+                {
+                    tile = emptyTile;
+                }
+                else if (distance <= -band - tileRadius)
+                {
+                    tile = fullTile;
+                }
+                else
+                {
+                    tile = storedNodes;
+                    storedNodes += tileSize * tileSize;
+                }
+            }
+        }
+        volumes.assign(storedNodes, 0.f);
+        gradients.assign(storedNodes, glm::vec2(0.f));
+        viscosities.assign(storedNodes, glm::mat2(0.f));
+
+        // Integrates the stored tiles, from a raster of S around each of them, whose cells are aligned with the nodes
+        const int rasterSize = (tileSize - 1) * cellsPerNode + 2 * margin;
+        std::vector<std::vector<unsigned char>> threadRasters(pool.ThreadCount());
+        pool.ParallelFor(tiles.size(), [&](size_t begin, size_t end, unsigned t) {
+            std::vector<unsigned char> &solid = threadRasters[t];
+            solid.resize(static_cast<size_t>(rasterSize) * rasterSize);
+            for (size_t k = begin; k < end; k++)
+            {
+                if (tiles[k] < 0)
+                {
+                    continue;
+                }
+                const int firstX = static_cast<int>(k % tileCountX) * tileSize, firstY = static_cast<int>(k / tileCountX) * tileSize;
+                // Cell (u, v) of the raster is cell (u - margin, v - margin) of node (firstX, firstY)
+                const glm::vec2 rasterOrigin = origin + nodeSpacing * glm::vec2(firstX, firstY) - glm::vec2(margin * cellSize);
+                for (int v = 0; v < rasterSize; v++)
+                {
+                    for (int u = 0; u < rasterSize; u++)
+                    {
+                        solid[v * rasterSize + u] = SignedDistance(rasterOrigin + cellSize * glm::vec2(u + .5f, v + .5f)) < 0.f;
+                    }
+                }
+                for (int y = 0; y < tileSize; y++)
+                {
+                    for (int x = 0; x < tileSize; x++)
+                    {
+                        const size_t n = tiles[k] + y * tileSize + x;
+                        const float distance = SignedDistance(origin + nodeSpacing * glm::vec2(firstX + x, firstY + y));
+                        if (distance >= band)
+                        {
+                            continue;
+                        }
+                        if (distance <= -band)
+                        {
+                            volumes[n] = fullVolume;
+                            viscosities[n] = fullViscosity;
+                            continue;
+                        }
+                        const int u0 = x * cellsPerNode + margin, v0 = y * cellsPerNode + margin;
+                        float volume = 0.f;
+                        glm::vec2 gradient(0.f);
+                        glm::mat2 viscosity(0.f);
+                        for (const StencilCell &cell : stencil)
+                        {
+                            if (solid[(v0 + cell.b) * rasterSize + u0 + cell.a])
+                            {
+                                volume += cell.volume;
+                                gradient += cell.gradient;
+                                viscosity += cell.viscosity;
+                            }
+                        }
+                        volumes[n] = volume;
+                        gradients[n] = gradient;
+                        viscosities[n] = viscosity;
+                    }
+                }
+            }
+        });
+    });
+}
+
+bool BoundaryField::Cell(const glm::vec2 &position, int &x, int &y, float &tx, float &ty) const
+{
+    const float fx = (position.x - origin.x) / nodeSpacing;
+    const float fy = (position.y - origin.y) / nodeSpacing;
+    // Also false for non-finite positions and empty maps
+    if (!(fx >= 0.f && fy >= 0.f && fx < countX - 1 && fy < countY - 1))
+    {
+        return false;
+    }
+    x = static_cast<int>(fx);
+    y = static_cast<int>(fy);
+    tx = fx - x;
+    ty = fy - y;
+    return true;
+}
+
+int BoundaryField::Node(int x, int y) const
+{
+    const int tile = tiles[(y / tileSize) * tileCountX + x / tileSize];
+    return tile < 0 ? tile : tile + (y % tileSize) * tileSize + x % tileSize;
+}
+
+BoundaryField::Sample BoundaryField::Lookup(const glm::vec2 &position) const
+{
+    Sample sample{0.f, glm::vec2(0.f), glm::mat2(0.f)};
+    int x, y;
+    float tx, ty;
+    if (Cell(position, x, y, tx, ty))
+    {
+        const int corners[4] = {Node(x, y), Node(x + 1, y), Node(x, y + 1), Node(x + 1, y + 1)};
+        const float weights[4] = {(1.f - tx) * (1.f - ty), tx * (1.f - ty), (1.f - tx) * ty, tx * ty};
+        for (int k = 0; k < 4; k++)
+        {
+            if (corners[k] >= 0)
+            {
+                sample.volume += weights[k] * volumes[corners[k]];
+                sample.gradient += weights[k] * gradients[corners[k]];
+                sample.viscosity += weights[k] * viscosities[corners[k]];
+            }
+            else if (corners[k] == fullTile)
+            {
+                sample.volume += weights[k] * fullVolume;
+                sample.viscosity += weights[k] * fullViscosity;
+            }
+        }
+    }
+    return sample;
+}
+
+float BoundaryField::Volume(const glm::vec2 &position) const
+{
+    // Same arithmetic as Lookup
+    float volume = 0.f;
+    int x, y;
+    float tx, ty;
+    if (Cell(position, x, y, tx, ty))
+    {
+        const int corners[4] = {Node(x, y), Node(x + 1, y), Node(x, y + 1), Node(x + 1, y + 1)};
+        const float weights[4] = {(1.f - tx) * (1.f - ty), tx * (1.f - ty), (1.f - tx) * ty, tx * ty};
+        for (int k = 0; k < 4; k++)
+        {
+            if (corners[k] >= 0)
+            {
+                volume += weights[k] * volumes[corners[k]];
+            }
+            else if (corners[k] == fullTile)
+            {
+                volume += weights[k] * fullVolume;
+            }
+        }
+    }
+    return volume;
+}
+
+size_t BoundaryField::NodeCount() const
+{
+    return volumes.size();
+}
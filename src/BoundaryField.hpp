@@ -0,0 +1,91 @@
+#pragma once
+
+#include "KernelFunctions.hpp" // KernelType
+#include <cstddef>             // size_t
+#include <glm/mat2x2.hpp>      // glm::mat2
+#include <glm/vec2.hpp>        // glm::vec2
+#include <vector>              // std::vector
+
+class ThreadPool;
+
+// Static boundaries given by their shapes (boxes, half-planes and polygons) instead of boundary particles.
+// The solid region S is the union of the shapes. A fluid particle at x gets from S the volume
+// V(x) = int_S W(x - y) dy, which counts as rho_0 V(x) in its density and replaces sum_b V_b W_ib, its
+// gradient, which replaces sum_b V_b grad W_ib in the pressure acceleration, and the matrix
+// M(x) = int_S grad W(x - y) (x - y)^T / (|x - y|^2 + eps) dy of the viscosity, M(x) v_i replacing
+// sum_b V_b grad W_ib (v_i . x_ib) / (|x_ib|^2 + eps). These maps are integrated once on a grid and
+// interpolated bilinearly (density maps, Koschier and Bender 2017), so walls add no neighbors. The grid
+// is stored in tiles, only near the surface of S: tiles away from it are zero or, inside S, constant, so
+// that the memory and the integration time grow with the area of the surface, not with that of S.
+class BoundaryField
+{
+public:
+    // Contribution of the boundary to a fluid particle (see above).
+    struct Sample
+    {
+        float volume;
+        glm::vec2 gradient;
+        glm::mat2 viscosity;
+    };
+
+    BoundaryField();
+    // Adds a solid axis-aligned box.
+    void AddBox(const glm::vec2 &lower, const glm::vec2 &upper);
+    // Adds the solid half-plane behind `point', `normal' pointing towards the fluid.
+    void AddHalfPlane(const glm::vec2 &point, const glm::vec2 &normal);
+    // Adds a solid simple polygon, in either orientation.
+    void AddPolygon(const std::vector<glm::vec2> &vertices);
+    // Region that the maps cover, at least. Required with half-planes, which are unbounded; otherwise
+    // the maps cover the bounding box of the shapes, extended by the kernel support.
+    void SetDomain(const glm::vec2 &lower, const glm::vec2 &upper);
+    // Removes all shapes and the domain.
+    void Clear();
+    bool Empty() const;
+    // Signed distance to the boundary of S, negative inside.
+    float SignedDistance(const glm::vec2 &position) const;
+    // Integrates the maps for the kernel `type' of smoothing length `spacing', if not done yet.
+    void Update(KernelType type, float spacing, ThreadPool *threadPool = nullptr);
+    // Interpolated maps at `position'; zero outside of the maps.
+    Sample Lookup(const glm::vec2 &position) const;
+    float Volume(const glm::vec2 &position) const;
+    // Number of grid nodes stored in the tiles of the maps (for diagnostics).
+    size_t NodeCount() const;
+
+    float viscosity; // Viscosity coefficient of the boundary, as for boundary particle sets
+
+private:
+    enum class ShapeType
+    {
+        Box,
+        HalfPlane,
+        Polygon
+    };
+    struct Shape
+    {
+        ShapeType type;
+        std::vector<glm::vec2> points; // Box: lower and upper corners; half-plane: point; polygon: vertices
+        glm::vec2 normal;              // Half-plane only, normalized
+    };
+    // Lower left node of the grid cell of `position', and its bilinear interpolation weights; false
+    // outside of the maps.
+    bool Cell(const glm::vec2 &position, int &x, int &y, float &tx, float &ty) const;
+    // Index of node (x, y) in the arrays of the maps, or a negative value for nodes that are not stored.
+    int Node(int x, int y) const;
+
+    std::vector<Shape> shapes;
+    bool hasDomain;
+    glm::vec2 domainLower, domainUpper;
+    // Maps, on nodes origin + (x, y) * nodeSpacing, grouped in square tiles with row-major indices
+    bool mapsValid;
+    KernelType mapKernel;
+    float mapSpacing;
+    glm::vec2 origin;
+    float nodeSpacing;
+    int countX, countY, tileCountX;
+    std::vector<int> tiles; // First node of each tile in the arrays below, or negative if not stored
+    std::vector<float> volumes;
+    std::vector<glm::vec2> gradients;
+    std::vector<glm::mat2> viscosities;
+    float fullVolume; // Maps deep inside S (the gradient is zero)
+    glm::mat2 fullViscosity;
+};
@@ -0,0 +1,343 @@
+#include "Checkpoint.hpp"
+
+#include "NeighborTable.hpp" // NeighborTable
+#include <algorithm>         // std::min
+#include <cerrno>            // errno, EINTR
+#include <cstdint>           // uint32_t, uint64_t
+#include <cstdio>            // std::rename, std::remove
+#include <cstring>           // std::memcpy, std::memcmp, std::strerror
+#include <fcntl.h>           // open
+#include <stdexcept>         // std::runtime_error
+#include <string>            // std::to_string
+#include <sys/mman.h>        // mmap, munmap
+#include <sys/stat.h>        // fstat
+#include <unistd.h>          // pwrite, fsync, close, getpid
+#include <utility>           // std::move
+
+namespace
+{
+    const char magic[8] = "MYSCKPT";
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t setCount;
+        float currentTime, timeStep, adaptiveTimeStep, smallestTimeStep;
+        uint32_t hasNeighbors;
+        uint32_t reserved;
+        uint64_t size;     // Of the whole file
+        uint64_t checksum; // Of everything after the header (see Checksum)
+    };
+    struct SetHeader
+    {
+        uint64_t particleCount;
+        float spacing, restDensity, stiffness, viscosity;
+        uint32_t isBoundary;
+        uint32_t reserved;
+    };
+    struct NeighborHeader
+    {
+        float radius;
+        uint32_t tableCount;
+        uint32_t referenceCount; // Sets with reference positions (all or none)
+        uint32_t reserved;
+    };
+    struct TableHeader
+    {
+        uint64_t setCount, rowCount, indexCount;
+    };
+
+    // Fletcher-like checksum of a sequence of 8-byte words, which detects truncated or overwritten data.
+    class Checksum
+    {
+    public:
+        Checksum() : sum(0), sumOfSums(0) {}
+        // Adds `size' bytes, padded with zeros to a multiple of 8.
+        void Add(const void *data, size_t size)
+        {
+            const char *bytes = static_cast<const char *>(data);
+            for (size_t offset = 0; offset < size; offset += 8)
+            {
+                uint64_t word = 0;
+                std::memcpy(&word, bytes + offset, std::min<size_t>(8, size - offset));
+                sum += word;
+                sumOfSums += sum;
+            }
+        }
+        uint64_t Value() const { return sum ^ (sumOfSums << 32 | sumOfSums >> 32); }
+
+    private:
+        uint64_t sum, sumOfSums;
+    };
+
+    // Writes `size' bytes at `offset' of the file, throwing on errors (e.g. a full disk).
+    void WriteAll(int descriptor, const void *data, size_t size, size_t offset, const std::string &path)
+    {
+        const char *bytes = static_cast<const char *>(data);
+        while (size > 0)
+        {
+            const ssize_t written = pwrite(descriptor, bytes, size, static_cast<off_t>(offset));
+            if (written < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (written <= 0)
+            {
+                throw std::runtime_error("cannot write checkpoint " + path + ": " + std::strerror(errno));
+            }
+            bytes += written;
+            offset += static_cast<size_t>(written);
+            size -= static_cast<size_t>(written);
+        }
+    }
+
+    // Writes arrays at consecutive 8-byte aligned offsets of a file, from the end of the header, or only
+    // counts their size if the file descriptor is negative.
+    class Writer
+    {
+    public:
+        Writer(int descriptor, const std::string &path) : descriptor(descriptor), path(path), offset(sizeof(Header)) {}
+        template <typename T>
+        void Write(const T *values, size_t count)
+        {
+            const size_t size = count * sizeof(T), padded = (size + 7) / 8 * 8;
+            if (descriptor >= 0 && count > 0)
+            {
+                static const char padding[8] = {};
+                WriteAll(descriptor, values, size, offset, path);
+                WriteAll(descriptor, padding, padded - size, offset + size, path);
+                checksum.Add(values, size);
+            }
+            offset += padded;
+        }
+        size_t Offset() const { return offset; }
+        uint64_t ChecksumValue() const { return checksum.Value(); }
+
+    private:
+        int descriptor;
+        const std::string &path;
+        size_t offset;
+        Checksum checksum;
+    };
+
+    // Reads the arrays written by a Writer in place, checking that they lie within the file.
+    class Reader
+    {
+    public:
+        Reader(const char *data, size_t size) : data(data), size(size), offset(0) {}
+        template <typename T>
+        const T *Read(size_t count)
+        {
+            if (count > (size - offset) / sizeof(T))
+            {
+                throw std::runtime_error("truncated checkpoint");
+            }
+            const T *values = reinterpret_cast<const T *>(data + offset);
+            offset = std::min(size, (offset + count * sizeof(T) + 7) / 8 * 8);
+            return values;
+        }
+
+    private:
+        const char *data;
+        size_t size, offset;
+    };
+
+    template <typename T>
+    void Assign(std::vector<T> &vector, const T *values, size_t count)
+    {
+        vector.assign(values, values + count);
+    }
+
+    // Writes everything after the header, or measures it if the writer has no file.
+    void WriteCheckpoint(Writer &writer, const Header &header, const std::vector<ParticleSet> &particleSets,
+                         const ParticleSimulation::NeighborState &neighbors)
+    {
+        for (const ParticleSet &particleSet : particleSets)
+        {
+            const SetHeader setHeader = {particleSet.size(), particleSet.spacing, particleSet.restDensity, particleSet.stiffness,
+                                         particleSet.viscosity, particleSet.isBoundary ? 1u : 0u, 0};
+            writer.Write(&setHeader, 1);
+            for (const std::vector<glm::vec2> *vectors : {&particleSet.positions, &particleSet.velocities, &particleSet.accelerations,
+                                                          &particleSet.pressureAccelerations, &particleSet.viscosityAccelerations,
+                                                          &particleSet.otherAccelerations})
+            {
+                writer.Write(vectors->data(), vectors->size());
+            }
+            writer.Write(particleSet.densities.data(), particleSet.densities.size());
+            writer.Write(particleSet.pressures.data(), particleSet.pressures.size());
+        }
+        if (header.hasNeighbors == 0)
+        {
+            return;
+        }
+        const NeighborHeader neighborHeader = {neighbors.radius, static_cast<uint32_t>(neighbors.tables.size()),
+                                               static_cast<uint32_t>(neighbors.referencePositions.size()), 0};
+        writer.Write(&neighborHeader, 1);
+        for (const NeighborTable &table : neighbors.tables)
+        {
+            const TableHeader tableHeader = {table.SetCount(), table.RowCount(), table.Size()};
+            writer.Write(&tableHeader, 1);
+            writer.Write(table.Offsets().data(), table.Offsets().size());
+            writer.Write(table.Indices().data(), table.Indices().size());
+        }
+        for (const std::vector<glm::vec2> &positions : neighbors.referencePositions)
+        {
+            const uint64_t count = positions.size();
+            writer.Write(&count, 1);
+            writer.Write(positions.data(), positions.size());
+        }
+    }
+} // namespace
+
+Checkpoint::Checkpoint()
+    : currentTime(0.f), timeStep(0.f), adaptiveTimeStep(0.f), smallestTimeStep(0.f)
+{
+}
+
+void Checkpoint::Save(const std::string &path, const std::vector<ParticleSet> &particleSets) const
+{
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.setCount = static_cast<uint32_t>(particleSets.size());
+    header.currentTime = currentTime;
+    header.timeStep = timeStep;
+    header.adaptiveTimeStep = adaptiveTimeStep;
+    header.smallestTimeStep = smallestTimeStep;
+    header.hasNeighbors = neighbors.tables.empty() ? 0 : 1;
+    // The checkpoint is written to a file of this process next to `path', header last, and only replaces
+    // `path' once complete: a save that fails or is interrupted leaves the previous checkpoint intact
+    const std::string temporaryPath = TemporaryPath(path, getpid());
+    const int descriptor = open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (descriptor < 0)
+    {
+        throw std::runtime_error("cannot open checkpoint " + temporaryPath + ": " + std::strerror(errno));
+    }
+    try
+    {
+        Writer writer(descriptor, temporaryPath);
+        WriteCheckpoint(writer, header, particleSets, neighbors);
+        header.size = writer.Offset();
+        header.checksum = writer.ChecksumValue();
+        WriteAll(descriptor, &header, sizeof(header), 0, temporaryPath);
+        if (fsync(descriptor) != 0)
+        {
+            throw std::runtime_error("cannot write checkpoint " + temporaryPath + ": " + std::strerror(errno));
+        }
+    }
+    catch (...)
+    {
+        close(descriptor);
+        std::remove(temporaryPath.c_str());
+        throw;
+    }
+    const bool closed = close(descriptor) == 0;
+    if (!closed || std::rename(temporaryPath.c_str(), path.c_str()) != 0)
+    {
+        const std::string reason = std::strerror(errno);
+        std::remove(temporaryPath.c_str());
+        throw std::runtime_error("cannot write checkpoint " + path + ": " + reason);
+    }
+}
+
+std::string Checkpoint::TemporaryPath(const std::string &path, long process)
+{
+    return path + ".tmp." + std::to_string(process);
+}
+
+void Checkpoint::Load(const std::string &path, std::vector<ParticleSet> &particleSets)
+{
+    const int descriptor = open(path.c_str(), O_RDONLY);
+    if (descriptor < 0)
+    {
+        throw std::runtime_error("cannot open checkpoint " + path);
+    }
+    struct stat status;
+    size_t size = 0;
+    void *mapping = MAP_FAILED;
+    if (fstat(descriptor, &status) == 0 && status.st_size >= static_cast<off_t>(sizeof(Header)))
+    {
+        size = static_cast<size_t>(status.st_size);
+        mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    }
+    close(descriptor);
+    if (mapping == MAP_FAILED)
+    {
+        throw std::runtime_error("cannot read checkpoint " + path);
+    }
+    // Unmaps the file on return and on exceptions
+    struct Mapping
+    {
+        void *data;
+        size_t size;
+        ~Mapping() { munmap(data, size); }
+    } unmap{mapping, size};
+
+    Reader reader(static_cast<const char *>(mapping), size);
+    const Header header = *reader.Read<Header>(1);
+    if (std::memcmp(header.magic, magic, sizeof(magic)) != 0)
+    {
+        throw std::runtime_error("not a checkpoint: " + path);
+    }
+    if (header.version != version)
+    {
+        throw std::runtime_error("checkpoint " + path + " has version " + std::to_string(header.version) +
+                                 ", expected " + std::to_string(version));
+    }
+    if (header.size != size)
+    {
+        throw std::runtime_error("truncated checkpoint " + path);
+    }
+    Checksum checksum;
+    checksum.Add(static_cast<const char *>(mapping) + sizeof(Header), size - sizeof(Header));
+    if (checksum.Value() != header.checksum)
+    {
+        throw std::runtime_error("corrupt checkpoint " + path);
+    }
+    std::vector<ParticleSet> sets;
+    sets.reserve(header.setCount);
+    for (uint32_t s = 0; s < header.setCount; s++)
+    {
+        const SetHeader setHeader = *reader.Read<SetHeader>(1);
+        // An empty set, whose mass and volume come from the spacing as for the saved set
+        sets.push_back(ParticleSet(0, 0, setHeader.spacing, setHeader.restDensity, setHeader.stiffness, setHeader.viscosity));
+        ParticleSet &particleSet = sets.back();
+        particleSet.isBoundary = setHeader.isBoundary != 0;
+        const size_t count = setHeader.particleCount;
+        for (std::vector<glm::vec2> *vectors : {&particleSet.positions, &particleSet.velocities, &particleSet.accelerations,
+                                                &particleSet.pressureAccelerations, &particleSet.viscosityAccelerations,
+                                                &particleSet.otherAccelerations})
+        {
+            Assign(*vectors, reader.Read<glm::vec2>(count), count);
+        }
+        Assign(particleSet.densities, reader.Read<float>(count), count);
+        Assign(particleSet.pressures, reader.Read<float>(count), count);
+    }
+    neighbors = ParticleSimulation::NeighborState();
+    if (header.hasNeighbors != 0)
+    {
+        const NeighborHeader neighborHeader = *reader.Read<NeighborHeader>(1);
+        neighbors.radius = neighborHeader.radius;
+        neighbors.tables.resize(neighborHeader.tableCount);
+        for (NeighborTable &table : neighbors.tables)
+        {
+            const TableHeader tableHeader = *reader.Read<TableHeader>(1);
+            const unsigned *offsets = reader.Read<unsigned>(tableHeader.rowCount + 1);
+            const unsigned *indices = reader.Read<unsigned>(tableHeader.indexCount);
+            table.Assign(tableHeader.setCount, offsets, tableHeader.rowCount, indices, tableHeader.indexCount);
+        }
+        neighbors.referencePositions.resize(neighborHeader.referenceCount);
+        for (std::vector<glm::vec2> &positions : neighbors.referencePositions)
+        {
+            const uint64_t count = *reader.Read<uint64_t>(1);
+            Assign(positions, reader.Read<glm::vec2>(count), count);
+        }
+    }
+    currentTime = header.currentTime;
+    timeStep = header.timeStep;
+    adaptiveTimeStep = header.adaptiveTimeStep;
+    smallestTimeStep = header.smallestTimeStep;
+    particleSets = std::move(sets);
+}
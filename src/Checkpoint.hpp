@@ -0,0 +1,39 @@
+#pragma once
+
+#include "ParticleSet.hpp"
+#include "ParticleSimulation.hpp"
+#include <string> // std::string
+#include <vector> // std::vector
+
+// Versioned binary checkpoint of a simulation, to resume it later: all arrays and uniform properties of the
+// particle sets, the time and the state of the time stepping, and optionally the neighbor tables.
+// Resuming from a checkpoint with the same settings (solver, kernel, threads...) gives the same results,
+// bit for bit, as not stopping: the iterative solvers only carry the pressures over from a step to the next,
+// and neighbor lists found again hold the same neighbors in the same order.
+// The file, in native byte order, is a header followed by the particle sets then the neighbor tables, each
+// array aligned to 8 bytes. The header holds the size of the file and a checksum of the rest, and is written
+// last, to a temporary file that then replaces the previous checkpoint; the file is read through a single
+// memory mapping.
+class Checkpoint
+{
+public:
+    static const unsigned version = 2;
+
+    Checkpoint();
+    // Writes the checkpoint with `particleSets' to the file at `path' (throws if it cannot be written, leaving
+    // the previous file intact).
+    void Save(const std::string &path, const std::vector<ParticleSet> &particleSets) const;
+    // Reads the checkpoint at `path' and replaces `particleSets' by its sets (throws if the file cannot be read,
+    // is not a checkpoint, has another version, or is truncated or corrupt).
+    void Load(const std::string &path, std::vector<ParticleSet> &particleSets);
+    // Temporary file a save to `path' by the process `process' writes before replacing `path'; a process killed
+    // while saving leaves it behind.
+    static std::string TemporaryPath(const std::string &path, long process);
+
+    float currentTime;
+    float timeStep;         // Fixed time step, or largest adaptive one
+    float adaptiveTimeStep; // Current and smallest steps of AdaptiveTimeStep
+    float smallestTimeStep;
+    // Saved and loaded only when it holds tables (see ParticleSimulation::GetNeighborState)
+    ParticleSimulation::NeighborState neighbors;
+};
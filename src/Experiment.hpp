@@ -1,9 +1,11 @@
 
 #pragma once
 
-#include "Model.hpp"
+#include <cstddef> // size_t
 #include <vector>
 
+class Model; // Model.hpp depends on OpenGL, which Experiment does not
+
 // Interface. Contains the callbacks that are called in the rendering loop.
 class Experiment
 {
@@ -18,4 +20,8 @@ public:
     // Called after the rendering loop, before destroying objects associated with the graphics library.
     virtual void OnClose() = 0;
     virtual const std::vector<Model *> &models() = 0;
+    // Number of simulation steps performed by each call to OnUpdate.
+    virtual int StepsPerUpdate() const = 0;
+    // Number of particles moved by each simulation step.
+    virtual size_t ParticleCount() const = 0;
 };
\ No newline at end of file
@@ -0,0 +1,120 @@
+#include "ForkedSnapshot.hpp"
+
+#include <stdexcept>  // std::runtime_error
+#include <sys/wait.h> // waitpid
+#include <unistd.h>   // fork, _exit
+
+ForkedSnapshot::ForkedSnapshot()
+    : child(-1), lastChild(-1), pauseSeconds(0.), writeSeconds(0.), succeeded(false), writtenCount(0), failedCount(0)
+{
+}
+
+ForkedSnapshot::~ForkedSnapshot()
+{
+    Wait();
+}
+
+bool ForkedSnapshot::Start(const std::function<void()> &write)
+{
+    if (IsWriting())
+    {
+        return false;
+    }
+    start = Clock::now();
+    const pid_t pid = fork();
+    if (pid < 0)
+    {
+        throw std::runtime_error("cannot fork to write a snapshot");
+    }
+    if (pid == 0)
+    {
+        // Child: _exit skips the destructors and the atexit handlers, which belong to the parent
+        int status = 0;
+        try
+        {
+            write();
+        }
+        catch (...)
+        {
+            status = 1;
+        }
+        _exit(status);
+    }
+    child = pid;
+    lastChild = pid;
+    succeeded = false;
+    pauseSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return true;
+}
+
+bool ForkedSnapshot::IsWriting()
+{
+    if (child < 0)
+    {
+        return false;
+    }
+    int status = 0;
+    const pid_t result = waitpid(child, &status, WNOHANG);
+    if (result == 0)
+    {
+        return true;
+    }
+    Collect(result == child ? status : -1);
+    return false;
+}
+
+bool ForkedSnapshot::Wait()
+{
+    if (child >= 0)
+    {
+        int status = 0;
+        const pid_t result = waitpid(child, &status, 0);
+        Collect(result == child ? status : -1);
+    }
+    return succeeded;
+}
+
+double ForkedSnapshot::PauseSeconds() const
+{
+    return pauseSeconds;
+}
+
+double ForkedSnapshot::WriteSeconds() const
+{
+    return writeSeconds;
+}
+
+bool ForkedSnapshot::Succeeded() const
+{
+    return succeeded;
+}
+
+unsigned long ForkedSnapshot::WrittenCount() const
+{
+    return writtenCount;
+}
+
+unsigned long ForkedSnapshot::FailedCount() const
+{
+    return failedCount;
+}
+
+pid_t ForkedSnapshot::LastChild() const
+{
+    return lastChild;
+}
+
+void ForkedSnapshot::Collect(int status)
+{
+    child = -1;
+    writeSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+    succeeded = status >= 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    if (succeeded)
+    {
+        writtenCount++;
+    }
+    else
+    {
+        failedCount++;
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <chrono>      // std::chrono::steady_clock
+#include <functional>  // std::function
+#include <sys/types.h> // pid_t
+
+// Writes snapshots of the process (typically a checkpoint) from a forked child process. The child gets a
+// copy-on-write image of the memory as of the fork, so the caller only pauses for the fork itself (copying
+// the page tables), and continues while the child writes; pages are only copied when the caller modifies them.
+// The child runs no destructors and no other thread than the one that forked, so the writing must not wait
+// for other threads.
+class ForkedSnapshot
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    ForkedSnapshot();
+    // Waits for the child.
+    ~ForkedSnapshot();
+    ForkedSnapshot(const ForkedSnapshot &) = delete;
+    ForkedSnapshot &operator=(const ForkedSnapshot &) = delete;
+
+    // Forks a child that runs `write' then exits, failing if it throws. Returns false without forking while the
+    // previous snapshot is being written (throws if the process cannot fork).
+    bool Start(const std::function<void()> &write);
+    // Whether the child is writing; collects it once it is done.
+    bool IsWriting();
+    // Waits for the child, and returns whether the last snapshot was written.
+    bool Wait();
+    // Pause of the caller in the last Start, in seconds.
+    double PauseSeconds() const;
+    // Time from the last Start until the child was found done by IsWriting or Wait, in seconds.
+    double WriteSeconds() const;
+    // Whether the last snapshot was written (false while it is being written).
+    bool Succeeded() const;
+    // Snapshots written, and those that failed, since construction.
+    unsigned long WrittenCount() const;
+    unsigned long FailedCount() const;
+    // Process id of the child of the last Start, to clean up after it (-1 before the first one).
+    pid_t LastChild() const;
+
+private:
+    // Records the exit status of the child.
+    void Collect(int status);
+
+    pid_t child; // -1 when no snapshot is being written
+    pid_t lastChild;
+    Clock::time_point start;
+    double pauseSeconds, writeSeconds;
+    bool succeeded;
+    unsigned long writtenCount, failedCount;
+};
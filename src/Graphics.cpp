@@ -4,6 +4,7 @@
 #include "imgui/imgui_impl_glfw.h"      // ...
 #include "imgui/imgui_impl_opengl3.h"   // ...
 #include "imgui/implot.h"               // ImPlot::, initialization of plots for ImGui
+#include "TraceRecorder.hpp"            // MYSOLVER_TRACE_SCOPE
 #include <GL/glew.h>                    // Runtime loading of OpenGL API functions
 #include <GLFW/glfw3.h>                 // Windowing and events
 #include <glm/common.hpp>               // glm::, vector maths
@@ -28,6 +29,7 @@ Graphics::~Graphics()
 
 void Graphics::Update()
 {
+    MYSOLVER_TRACE_SCOPE("Graphics::Update");
     if (!internalState.isPaused || internalState.shouldUpdateOneStep)
     {
         experiment.OnUpdate();
@@ -37,11 +39,13 @@ void Graphics::Update()
 
 void Graphics::Render()
 {
+    MYSOLVER_TRACE_SCOPE("Graphics::Render");
     glClearColor(1, 1, 1, 1);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     for (auto &&model : experiment.models())
     {
+        MYSOLVER_TRACE_SCOPE("Draw model");
         model->program->use();
         glBindVertexArray(model->vao);
         GLfloat aspect = SCREEN_SIZE.x / SCREEN_SIZE.y;
@@ -58,12 +62,16 @@ void Graphics::Render()
         model->program->stopUsing();
     }
 
-    experiment.OnRender();
+    {
+        MYSOLVER_TRACE_SCOPE("GUI");
+        experiment.OnRender();
 
-    // Render dear imgui into screen
-    ImGui::Render();
-    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        // Render dear imgui into screen
+        ImGui::Render();
+        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    }
 
+    MYSOLVER_TRACE_SCOPE("Swap buffers");
     glfwSwapBuffers(gWindow);
 }
 
@@ -135,7 +143,10 @@ void Graphics::Run()
     while (!glfwWindowShouldClose(gWindow))
     {
         // prossess events
-        glfwPollEvents();
+        {
+            MYSOLVER_TRACE_SCOPE("Poll events");
+            glfwPollEvents();
+        }
 
         // feed inputs to dear imgui, start new frame
         ImGui_ImplOpenGL3_NewFrame();
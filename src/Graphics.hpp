@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Experiment.hpp"
+#include "Model.hpp"
 #include <vector>
 #include <GLFW/glfw3.h>
 
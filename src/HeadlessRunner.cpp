@@ -0,0 +1,41 @@
+#include "HeadlessRunner.hpp"
+
+#include "PhaseTimer.hpp" // PhaseTimings
+#include <chrono>         // std::chrono::steady_clock
+#include <iostream>       // std::cout
+
+HeadlessRunner::HeadlessRunner(Experiment &experiment)
+    : experiment(experiment)
+{
+}
+
+void HeadlessRunner::Run(unsigned long steps)
+{
+    const unsigned long stepsPerUpdate = static_cast<unsigned long>(experiment.StepsPerUpdate() > 0 ? experiment.StepsPerUpdate() : 1);
+    const size_t particleCount = experiment.ParticleCount();
+    unsigned long doneSteps = 0;
+    const auto start = std::chrono::steady_clock::now();
+    while (doneSteps < steps)
+    {
+        experiment.OnUpdate();
+        doneSteps += stepsPerUpdate;
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    experiment.OnClose();
+
+    const double seconds = elapsed.count();
+    std::cout << doneSteps << " steps of " << particleCount << " particles in " << seconds << " s" << std::endl
+              << "Steps/sec: " << doneSteps / seconds << std::endl
+              << "Particle-updates/sec: " << doneSteps * static_cast<double>(particleCount) / seconds << std::endl;
+#ifdef MYSOLVER_PHASE_TIMERS
+    const PhaseTimings &timings = PhaseTimings::Global();
+    std::cout << "Milliseconds per update (mean, p50, p99) over the last " << timings.FrameCount() << " updates:" << std::endl;
+    for (size_t p = 0; p < PhaseTimings::phaseCount; p++)
+    {
+        const Phase phase = static_cast<Phase>(p);
+        const PhaseTimings::Statistics statistics = timings.GetStatistics(phase);
+        std::cout << "  " << PhaseTimings::Name(phase) << ": "
+                  << statistics.mean << ", " << statistics.p50 << ", " << statistics.p99 << std::endl;
+    }
+#endif
+}
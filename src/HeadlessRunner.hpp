@@ -0,0 +1,16 @@
+#pragma once
+
+#include "Experiment.hpp"
+
+// Runs an Experiment without the graphics library, as fast as possible.
+// Only OnUpdate and OnClose are called: OnInit and OnRender create and draw graphical models.
+class HeadlessRunner
+{
+public:
+    HeadlessRunner(Experiment &experiment);
+    // Calls OnUpdate until at least `steps' simulation steps are done, then prints the throughput.
+    void Run(unsigned long steps);
+
+private:
+    Experiment &experiment;
+};
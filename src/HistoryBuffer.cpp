@@ -0,0 +1,151 @@
+#include "HistoryBuffer.hpp"
+
+#include <algorithm> // std::min, std::max
+#include <stdexcept> // std::invalid_argument
+
+HistoryBuffer::HistoryBuffer(size_t capacity, size_t levels, size_t factor)
+    : capacity(capacity), factor(factor), levels(capacity == 0 ? 1 : levels), count(0), last{0.f, 0.f, 0.f}
+{
+    if (levels == 0 || factor < 2)
+    {
+        throw std::invalid_argument("a history buffer needs at least one level and a merge factor of at least 2");
+    }
+    for (Level &level : this->levels)
+    {
+        level.buckets.resize(capacity);
+    }
+    Clear();
+}
+
+void HistoryBuffer::Push(float time, float value)
+{
+    last = Bucket{time, value, value};
+    count++;
+    Insert(0, last);
+}
+
+void HistoryBuffer::Clear()
+{
+    for (Level &level : levels)
+    {
+        if (capacity == 0)
+        {
+            level.buckets.clear();
+        }
+        level.head = level.size = level.pendingCount = 0;
+    }
+    count = 0;
+}
+
+size_t HistoryBuffer::Count() const
+{
+    return count;
+}
+
+size_t HistoryBuffer::Size() const
+{
+    size_t size = 0;
+    for (const Level &level : levels)
+    {
+        size += level.size + (level.pendingCount > 0 ? 1 : 0);
+    }
+    return size;
+}
+
+bool HistoryBuffer::Empty() const
+{
+    return count == 0;
+}
+
+float HistoryBuffer::FirstTime() const
+{
+    for (size_t k = levels.size(); k-- > 0;)
+    {
+        const Level &level = levels[k];
+        if (level.size > 0)
+        {
+            return level.buckets[level.head].time;
+        }
+        if (level.pendingCount > 0)
+        {
+            return level.pending.time;
+        }
+    }
+    return 0.f;
+}
+
+float HistoryBuffer::LastTime() const
+{
+    return last.time;
+}
+
+float HistoryBuffer::LastValue() const
+{
+    return last.min;
+}
+
+void HistoryBuffer::Linearize(std::vector<float> &times, std::vector<float> &values) const
+{
+    times.clear();
+    values.clear();
+    // From the coarsest level, whose pending bucket is more recent than its ring
+    for (size_t k = levels.size(); k-- > 0;)
+    {
+        const Level &level = levels[k];
+        const size_t pendingCount = level.pendingCount > 0 ? 1 : 0;
+        for (size_t b = 0; b < level.size + pendingCount; b++)
+        {
+            const Bucket &bucket = b < level.size ? level.buckets[capacity == 0 ? b : (level.head + b) % capacity] : level.pending;
+            times.push_back(bucket.time);
+            values.push_back(bucket.min);
+            if (k > 0)
+            {
+                times.push_back(bucket.time);
+                values.push_back(bucket.max);
+            }
+        }
+    }
+}
+
+void HistoryBuffer::Insert(size_t level, const Bucket &bucket)
+{
+    Level &l = levels[level];
+    if (capacity == 0)
+    {
+        l.buckets.push_back(bucket);
+        l.size++;
+        return;
+    }
+    if (l.size < capacity)
+    {
+        l.buckets[(l.head + l.size) % capacity] = bucket;
+        l.size++;
+        return;
+    }
+    const Bucket oldest = l.buckets[l.head];
+    l.buckets[l.head] = bucket;
+    l.head = (l.head + 1) % capacity;
+    if (level + 1 < levels.size())
+    {
+        Merge(level + 1, oldest);
+    }
+}
+
+void HistoryBuffer::Merge(size_t level, const Bucket &bucket)
+{
+    Level &l = levels[level];
+    if (l.pendingCount == 0)
+    {
+        l.pending = bucket;
+    }
+    else
+    {
+        l.pending.min = std::min(l.pending.min, bucket.min);
+        l.pending.max = std::max(l.pending.max, bucket.max);
+    }
+    if (++l.pendingCount == factor)
+    {
+        l.pendingCount = 0;
+        Insert(level, l.pending);
+    }
+}
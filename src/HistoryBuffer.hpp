@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef> // size_t
+#include <vector>  // std::vector
+
+// Time series of bounded memory. The latest `capacity' samples are kept as they are, in a ring buffer.
+// Older samples are merged `factor' at a time into buckets holding their minimum and maximum, which go to
+// a ring buffer of the same capacity, and so on for `levels' levels: level k keeps capacity * factor^k
+// samples, and peaks are never lost. The oldest buckets of the last level are dropped. All buffers are
+// allocated upfront, so recording a sample never allocates.
+// A capacity of 0 keeps every sample, in a growing array.
+class HistoryBuffer
+{
+public:
+    HistoryBuffer(size_t capacity = 0, size_t levels = 1, size_t factor = 2);
+    // Records `value' at `time', after the previous samples.
+    void Push(float time, float value);
+    void Clear();
+    // Number of samples recorded since the last Clear, including dropped ones.
+    size_t Count() const;
+    // Number of samples and buckets held.
+    size_t Size() const;
+    bool Empty() const;
+    // Time of the oldest sample held and time and value of the latest one.
+    float FirstTime() const;
+    float LastTime() const;
+    float LastValue() const;
+    // Writes the history in chronological order, for plotting: one point per sample, and the minimum then the
+    // maximum (at the time of its first sample) of each bucket.
+    void Linearize(std::vector<float> &times, std::vector<float> &values) const;
+
+private:
+    struct Bucket
+    {
+        float time; // Of the first sample
+        float min, max;
+    };
+    struct Level
+    {
+        std::vector<Bucket> buckets; // Ring buffer
+        size_t head;                 // Oldest bucket
+        size_t size;
+        Bucket pending; // Buckets evicted from the previous level, until `factor' of them are merged
+        size_t pendingCount;
+    };
+    // Adds `bucket' to `level', evicting its oldest bucket if full.
+    void Insert(size_t level, const Bucket &bucket);
+    // Merges a bucket evicted from the level below into the pending bucket of `level'.
+    void Merge(size_t level, const Bucket &bucket);
+
+    size_t capacity, factor;
+    std::vector<Level> levels;
+    size_t count;
+    Bucket last;
+};
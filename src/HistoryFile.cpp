@@ -0,0 +1,122 @@
+#include "HistoryFile.hpp"
+
+#include <cstring>    // std::memcmp
+#include <fcntl.h>    // open
+#include <stdexcept>  // std::runtime_error, std::out_of_range
+#include <sys/mman.h> // mmap, munmap
+#include <sys/stat.h> // fstat
+#include <unistd.h>   // close
+
+namespace
+{
+    const char magic[8] = "MYSHIST";
+
+    size_t Align(size_t size, size_t alignment)
+    {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+} // namespace
+
+HistoryFile::HistoryFile(const std::string &path)
+    : data(nullptr), size(0), header(nullptr), index(nullptr)
+{
+    const int descriptor = open(path.c_str(), O_RDONLY);
+    if (descriptor < 0)
+    {
+        throw std::runtime_error("cannot open history file " + path);
+    }
+    struct stat status;
+    void *mapping = MAP_FAILED;
+    if (fstat(descriptor, &status) == 0 && status.st_size >= static_cast<off_t>(sizeof(Header)))
+    {
+        size = static_cast<size_t>(status.st_size);
+        mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, descriptor, 0);
+    }
+    close(descriptor);
+    if (mapping == MAP_FAILED)
+    {
+        throw std::runtime_error("cannot map history file " + path);
+    }
+    data = static_cast<const char *>(mapping);
+    header = reinterpret_cast<const Header *>(data);
+    if (std::memcmp(header->magic, magic, sizeof(magic)) != 0 || header->version != version ||
+        header->columnCount != static_cast<uint32_t>(HistoryColumn::Count) || header->indexOffset == 0 ||
+        header->indexOffset + header->chunkCount * sizeof(IndexEntry) > size)
+    {
+        munmap(mapping, size);
+        throw std::runtime_error("not a complete history file: " + path);
+    }
+    index = reinterpret_cast<const IndexEntry *>(data + header->indexOffset);
+}
+
+HistoryFile::~HistoryFile()
+{
+    munmap(const_cast<char *>(data), size);
+}
+
+size_t HistoryFile::StepCount() const
+{
+    return header->stepCount;
+}
+
+size_t HistoryFile::ParticleCount() const
+{
+    return header->particleCount;
+}
+
+size_t HistoryFile::ChunkCount() const
+{
+    return header->chunkCount;
+}
+
+float HistoryFile::Time(size_t step) const
+{
+    size_t stepInChunk;
+    const char *chunk = Chunk(step, stepInChunk);
+    return reinterpret_cast<const float *>(chunk)[stepInChunk];
+}
+
+const float *HistoryFile::Column(size_t step, HistoryColumn column) const
+{
+    size_t stepInChunk;
+    const char *chunk = Chunk(step, stepInChunk);
+    return reinterpret_cast<const float *>(chunk + ColumnOffset(header->stepsPerChunk, header->particleCount, column)) +
+           stepInChunk * header->particleCount;
+}
+
+const char *HistoryFile::Name(HistoryColumn column)
+{
+    static const char *const names[] = {"position.x", "position.y", "velocity.x", "velocity.y", "density", "pressure",
+                                        "pressureAcceleration.x", "pressureAcceleration.y", "viscosityAcceleration.x",
+                                        "viscosityAcceleration.y", "otherAccelerations.x", "otherAccelerations.y"};
+    return names[static_cast<size_t>(column)];
+}
+
+size_t HistoryFile::ColumnOffset(size_t stepsPerChunk, size_t particleCount, HistoryColumn column)
+{
+    const size_t timesSize = Align(stepsPerChunk * sizeof(float), 64);
+    const size_t columnSize = Align(stepsPerChunk * particleCount * sizeof(float), 64);
+    return timesSize + static_cast<size_t>(column) * columnSize;
+}
+
+size_t HistoryFile::ChunkSize(size_t stepsPerChunk, size_t particleCount)
+{
+    return Align(ColumnOffset(stepsPerChunk, particleCount, HistoryColumn::Count), pageSize);
+}
+
+size_t HistoryFile::StepSize(size_t particleCount)
+{
+    return (1 + static_cast<size_t>(HistoryColumn::Count) * particleCount) * sizeof(float);
+}
+
+const char *HistoryFile::Chunk(size_t step, size_t &stepInChunk) const
+{
+    if (step >= header->stepCount)
+    {
+        throw std::out_of_range("step out of the history file");
+    }
+    // Chunks hold stepsPerChunk steps each, except the last one
+    const IndexEntry &entry = index[step / header->stepsPerChunk];
+    stepInChunk = step - entry.firstStep;
+    return data + entry.offset;
+}
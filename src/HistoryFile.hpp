@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef> // size_t
+#include <cstdint> // uint32_t, uint64_t
+#include <string>  // std::string
+
+// Quantities of the particles recorded in a history file, one float column each.
+enum class HistoryColumn
+{
+    PositionX,
+    PositionY,
+    VelocityX,
+    VelocityY,
+    Density,
+    Pressure,
+    PressureAccelerationX,
+    PressureAccelerationY,
+    ViscosityAccelerationX,
+    ViscosityAccelerationY,
+    OtherAccelerationsX,
+    OtherAccelerationsY,
+    Count
+};
+
+// Read-only view of a history file written by HistoryRecorder, mapped in memory: the columns are read in
+// place, without copies.
+// The file, in native byte order, is a header padded to a page, the chunks, each page-aligned, then the
+// index of the chunks. A chunk of N steps (the last one may hold fewer) has the time of each step, then
+// each column with the values of all particles at each step: column c of step s starts at
+// ColumnOffset(N, particleCount, c) + s * particleCount floats. Arrays are 64-byte aligned.
+class HistoryFile
+{
+public:
+    struct Header
+    {
+        char magic[8]; // "MYSHIST"
+        uint32_t version;
+        uint32_t columnCount;
+        uint64_t particleCount;
+        uint64_t stepsPerChunk;
+        uint64_t chunkCount;
+        uint64_t stepCount;
+        uint64_t indexOffset; // 0 while the file is written
+        uint64_t reserved;
+    };
+    struct IndexEntry
+    {
+        uint64_t offset; // In the file
+        uint64_t firstStep;
+        uint64_t stepCount;
+    };
+    static const uint32_t version = 1;
+    static const size_t pageSize = 4096;
+
+    // Maps the file at `path' (throws if it cannot be read, or is not a complete history file).
+    explicit HistoryFile(const std::string &path);
+    ~HistoryFile();
+    HistoryFile(const HistoryFile &) = delete;
+    HistoryFile &operator=(const HistoryFile &) = delete;
+
+    size_t StepCount() const;
+    size_t ParticleCount() const;
+    size_t ChunkCount() const;
+    float Time(size_t step) const;
+    // Values of `column' for all particles at `step'.
+    const float *Column(size_t step, HistoryColumn column) const;
+    static const char *Name(HistoryColumn column);
+
+    // Byte offsets in a chunk of `stepsPerChunk' steps, and its size (a multiple of the page size).
+    static size_t ColumnOffset(size_t stepsPerChunk, size_t particleCount, HistoryColumn column);
+    static size_t ChunkSize(size_t stepsPerChunk, size_t particleCount);
+    // Bytes of one step in a chunk, without the alignment.
+    static size_t StepSize(size_t particleCount);
+
+private:
+    const char *Chunk(size_t step, size_t &stepInChunk) const;
+
+    const char *data; // Mapping of the whole file
+    size_t size;
+    const Header *header;
+    const IndexEntry *index;
+};
@@ -0,0 +1,202 @@
+#include "HistoryRecorder.hpp"
+
+#include "PhaseTimer.hpp" // MYSOLVER_TIME_PHASE
+#include <algorithm>      // std::max
+#include <cstring>        // std::memcpy, std::memset
+#include <stdexcept>      // std::runtime_error
+
+HistoryRecorder::HistoryRecorder()
+    : target(nullptr), stepsPerChunk(0), stepCount(0), bufferCount(0), bufferLimit(0), stallCount(0), stopping(false), failed(false)
+{
+}
+
+HistoryRecorder::~HistoryRecorder()
+{
+    Finish();
+}
+
+void HistoryRecorder::Start(const std::string &path, const ParticleSet &target, size_t chunkBytes, size_t bufferLimit)
+{
+    Stop();
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        throw std::runtime_error("cannot open history file " + path);
+    }
+    this->target = &target;
+    stepsPerChunk = StepsPerChunk(chunkBytes, target.size());
+    this->bufferLimit = std::max(bufferLimit, static_cast<size_t>(2));
+    stepCount = 0;
+    stallCount = 0;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "MYSHIST", sizeof(header.magic));
+    header.version = HistoryFile::version;
+    header.columnCount = static_cast<uint32_t>(HistoryColumn::Count);
+    header.particleCount = target.size();
+    header.stepsPerChunk = stepsPerChunk;
+    // Header, completed by Stop, padded to a page so that chunks are page-aligned
+    std::vector<char> page(HistoryFile::pageSize, 0);
+    std::memcpy(page.data(), &header, sizeof(header));
+    file.write(page.data(), page.size());
+    index.clear();
+    // Double buffering: one chunk filled by the simulation, one written
+    freeChunks.clear();
+    fullChunks.clear();
+    bufferCount = 2;
+    for (size_t k = 0; k < bufferCount; k++)
+    {
+        freeChunks.emplace_back(new Chunk{std::vector<char>(HistoryFile::ChunkSize(stepsPerChunk, target.size()), 0), 0, 0});
+    }
+    stopping = failed = false;
+    writerThread = std::thread(&HistoryRecorder::WriteLoop, this);
+}
+
+void HistoryRecorder::Stop()
+{
+    if (!Finish())
+    {
+        throw std::runtime_error("the history file could not be written");
+    }
+}
+
+bool HistoryRecorder::IsRecording() const
+{
+    return writerThread.joinable();
+}
+
+void HistoryRecorder::Record(float time)
+{
+    MYSOLVER_TIME_PHASE(Phase::History);
+    if (!IsRecording())
+    {
+        return;
+    }
+    if (!current)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (freeChunks.empty() && bufferCount < bufferLimit)
+        {
+            freeChunks.emplace_back(new Chunk{std::vector<char>(HistoryFile::ChunkSize(stepsPerChunk, target->size()), 0), 0, 0});
+            bufferCount++;
+        }
+        else if (freeChunks.empty())
+        {
+            // Every buffer is full or being written: wait for the writer rather than growing the memory
+            stallCount++;
+            chunkFreed.wait(lock, [this] { return !freeChunks.empty(); });
+        }
+        current = std::move(freeChunks.back());
+        freeChunks.pop_back();
+        current->firstStep = stepCount;
+        current->stepCount = 0;
+    }
+    // Copy the SoA arrays of the target into the columns of the step
+    const size_t particleCount = target->size();
+    const size_t step = current->stepCount;
+    char *data = current->data.data();
+    reinterpret_cast<float *>(data)[step] = time;
+    const auto copyScalars = [&](HistoryColumn column, const std::vector<float> &values) {
+        float *destination = reinterpret_cast<float *>(data + HistoryFile::ColumnOffset(stepsPerChunk, particleCount, column)) + step * particleCount;
+        std::memcpy(destination, values.data(), particleCount * sizeof(float));
+    };
+    const auto copyVectors = [&](HistoryColumn columnX, HistoryColumn columnY, const std::vector<glm::vec2> &values) {
+        float *x = reinterpret_cast<float *>(data + HistoryFile::ColumnOffset(stepsPerChunk, particleCount, columnX)) + step * particleCount;
+        float *y = reinterpret_cast<float *>(data + HistoryFile::ColumnOffset(stepsPerChunk, particleCount, columnY)) + step * particleCount;
+        for (size_t i = 0; i < particleCount; i++)
+        {
+            x[i] = values[i].x;
+            y[i] = values[i].y;
+        }
+    };
+    copyVectors(HistoryColumn::PositionX, HistoryColumn::PositionY, target->positions);
+    copyVectors(HistoryColumn::VelocityX, HistoryColumn::VelocityY, target->velocities);
+    copyScalars(HistoryColumn::Density, target->densities);
+    copyScalars(HistoryColumn::Pressure, target->pressures);
+    copyVectors(HistoryColumn::PressureAccelerationX, HistoryColumn::PressureAccelerationY, target->pressureAccelerations);
+    copyVectors(HistoryColumn::ViscosityAccelerationX, HistoryColumn::ViscosityAccelerationY, target->viscosityAccelerations);
+    copyVectors(HistoryColumn::OtherAccelerationsX, HistoryColumn::OtherAccelerationsY, target->otherAccelerations);
+    current->stepCount++;
+    stepCount++;
+    if (current->stepCount == stepsPerChunk)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            fullChunks.push_back(std::move(current));
+        }
+        wakeUp.notify_one();
+    }
+}
+
+size_t HistoryRecorder::StepCount() const
+{
+    return stepCount;
+}
+
+size_t HistoryRecorder::BufferCount() const
+{
+    return bufferCount;
+}
+
+size_t HistoryRecorder::StallCount() const
+{
+    return stallCount;
+}
+
+size_t HistoryRecorder::StepsPerChunk(size_t chunkBytes, size_t particleCount)
+{
+    return std::max(chunkBytes / HistoryFile::StepSize(particleCount), static_cast<size_t>(1));
+}
+
+void HistoryRecorder::WriteLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        wakeUp.wait(lock, [this] { return stopping || !fullChunks.empty(); });
+        if (fullChunks.empty())
+        {
+            return;
+        }
+        std::unique_ptr<Chunk> chunk = std::move(fullChunks.front());
+        fullChunks.pop_front();
+        lock.unlock();
+        const uint64_t offset = static_cast<uint64_t>(file.tellp());
+        file.write(chunk->data.data(), chunk->data.size());
+        index.push_back(HistoryFile::IndexEntry{offset, chunk->firstStep, chunk->stepCount});
+        const bool written = static_cast<bool>(file);
+        lock.lock();
+        failed = failed || !written;
+        freeChunks.push_back(std::move(chunk));
+        chunkFreed.notify_one();
+    }
+}
+
+bool HistoryRecorder::Finish()
+{
+    if (!writerThread.joinable())
+    {
+        return true;
+    }
+    {
+        // The writer writes the partial chunk before stopping
+        std::lock_guard<std::mutex> lock(mutex);
+        if (current)
+        {
+            fullChunks.push_back(std::move(current));
+        }
+        stopping = true;
+    }
+    wakeUp.notify_one();
+    writerThread.join();
+    header.chunkCount = index.size();
+    header.stepCount = stepCount;
+    header.indexOffset = static_cast<uint64_t>(file.tellp());
+    file.write(reinterpret_cast<const char *>(index.data()), index.size() * sizeof(HistoryFile::IndexEntry));
+    file.seekp(0);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.close();
+    const bool written = !failed && !file.fail();
+    freeChunks.clear();
+    target = nullptr;
+    return written;
+}
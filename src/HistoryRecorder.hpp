@@ -0,0 +1,68 @@
+#pragma once
+
+#include "HistoryFile.hpp"
+#include "ParticleSet.hpp"
+#include <condition_variable> // std::condition_variable
+#include <cstddef>            // size_t
+#include <deque>              // std::deque
+#include <fstream>            // std::ofstream
+#include <memory>             // std::unique_ptr
+#include <mutex>              // std::mutex
+#include <string>             // std::string
+#include <thread>             // std::thread
+#include <vector>             // std::vector
+
+// Streams the state of a particle set at every step into a history file (see HistoryFile).
+// Steps are copied into a chunk buffer in the layout of the file; full chunks are handed to a background
+// thread, which writes them while the simulation fills the next buffer. If the writer falls behind, more
+// buffers are allocated up to a limit, then the simulation waits for the writer to free one (a stall), so
+// that the memory stays bounded and no step is lost.
+class HistoryRecorder
+{
+public:
+    HistoryRecorder();
+    ~HistoryRecorder();
+    HistoryRecorder(const HistoryRecorder &) = delete;
+    HistoryRecorder &operator=(const HistoryRecorder &) = delete;
+
+    // Starts recording `target', whose particles must not be added or removed meanwhile, into the file at
+    // `path' in chunks of about `chunkBytes' bytes (at least 1 step), with up to `bufferLimit' chunk
+    // buffers (at least 2) (throws if the file cannot be opened).
+    void Start(const std::string &path, const ParticleSet &target, size_t chunkBytes = 8 << 20, size_t bufferLimit = 4);
+    // Writes the remaining steps and the index, and closes the file (throws if it could not be written).
+    void Stop();
+    bool IsRecording() const;
+    // Records the state of the target at `time'.
+    void Record(float time);
+    size_t StepCount() const;
+    // Number of chunk buffers allocated since Start (2 unless the writer fell behind).
+    size_t BufferCount() const;
+    // Number of steps that waited for the writer since Start, all buffers being full.
+    size_t StallCount() const;
+    // Steps of `particleCount' particles that fit in `chunkBytes' bytes, before alignment (at least 1).
+    static size_t StepsPerChunk(size_t chunkBytes, size_t particleCount);
+
+private:
+    struct Chunk
+    {
+        std::vector<char> data; // Chunk in the layout of the file
+        size_t firstStep, stepCount;
+    };
+    void WriteLoop();
+    // Ends the writer thread and completes the file; false if it could not be written.
+    bool Finish();
+
+    const ParticleSet *target;
+    size_t stepsPerChunk, stepCount;
+    std::ofstream file;
+    HistoryFile::Header header;
+    std::vector<HistoryFile::IndexEntry> index; // Written by the writer thread only
+    std::unique_ptr<Chunk> current;             // Filled by the simulation
+    size_t bufferCount, bufferLimit, stallCount;
+    std::thread writerThread;
+    std::mutex mutex; // Protects the lists of chunks and the flags below
+    std::condition_variable wakeUp, chunkFreed;
+    std::vector<std::unique_ptr<Chunk>> freeChunks;
+    std::deque<std::unique_ptr<Chunk>> fullChunks;
+    bool stopping, failed;
+};
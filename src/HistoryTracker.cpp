@@ -1,77 +1,109 @@
 #include "HistoryTracker.hpp"
 
+#include "PhaseTimer.hpp"    // MYSOLVER_TIME_PHASE
 #include <glm/geometric.hpp> // glm::length, glm::max
 
 HistoryTracker::HistoryTracker()
-    : target(nullptr)
+    : target(nullptr), capacity(0), levels(1), factor(2), lastTime(0.f)
 {
 }
 
 void HistoryTracker::SetTarget(const ParticleSet *target)
 {
     this->target = target;
-    density.resize(target->particles.size());
-    pressure.resize(target->particles.size());
-    pressureAcceleration.resize(target->particles.size());
-    viscosityAcceleration.resize(target->particles.size());
-    otherAccelerations.resize(target->particles.size());
-    velocity.resize(target->particles.size());
-    for (size_t i = 0; i < target->particles.size(); i++)
+    Allocate();
+}
+
+void HistoryTracker::SetBounds(const std::vector<size_t> &trackedParticles, size_t capacity, size_t levels, size_t factor)
+{
+    requestedParticles = trackedParticles;
+    this->capacity = capacity;
+    this->levels = levels;
+    this->factor = factor;
+    Allocate();
+}
+
+const std::vector<size_t> &HistoryTracker::TrackedParticles() const
+{
+    return trackedParticles;
+}
+
+void HistoryTracker::Allocate()
+{
+    trackedParticles.clear();
+    const size_t particleCount = target != nullptr ? target->size() : 0;
+    if (requestedParticles.empty())
     {
-        density[i] = std::vector<float>();
-        pressure[i] = std::vector<float>();
-        pressureAcceleration[i] = std::vector<float>();
-        viscosityAcceleration[i] = std::vector<float>();
-        otherAccelerations[i] = std::vector<float>();
-        velocity[i] = std::vector<float>();
+        for (size_t i = 0; i < particleCount; i++)
+        {
+            trackedParticles.push_back(i);
+        }
     }
-    maxDistance.clear();
+    for (size_t i : requestedParticles)
+    {
+        if (i < particleCount)
+        {
+            trackedParticles.push_back(i);
+        }
+    }
+    const HistoryBuffer empty(capacity, levels, factor);
+    for (auto *histories : {&density, &pressure, &pressureAcceleration, &viscosityAcceleration, &otherAccelerations, &velocity})
+    {
+        histories->assign(trackedParticles.size(), empty);
+    }
+    maxDistance = timeSteps = pressureIterations = densityError = empty;
+    lastTime = 0.f;
 }
 
-void HistoryTracker::Step(float currentTime)
+void HistoryTracker::Step(float currentTime, float timeStep)
 {
-    if (target != nullptr && target->particles.size() >= 1)
+    MYSOLVER_TIME_PHASE(Phase::History);
+    if (target != nullptr && target->size() >= 1)
     {
-        for (size_t i = 0; i < target->particles.size(); i++)
+        for (size_t k = 0; k < trackedParticles.size(); k++)
         {
-            auto particle = target->particles[i];
-            density[i].push_back(particle.density / 1000.f);
-            pressure[i].push_back(particle.pressure / 10000.f);
-            pressureAcceleration[i].push_back(glm::length(particle.pressureAcceleration) / 10.f);
-            viscosityAcceleration[i].push_back(glm::length(particle.viscosityAcceleration) / 10.f);
-            otherAccelerations[i].push_back(glm::length(particle.otherAccelerations) / 10.f);
-            velocity[i].push_back(glm::length(particle.velocity));
+            const size_t i = trackedParticles[k];
+            density[k].Push(currentTime, target->densities[i] / 1000.f);
+            pressure[k].Push(currentTime, target->pressures[i] / 10000.f);
+            pressureAcceleration[k].Push(currentTime, glm::length(target->pressureAccelerations[i]) / 10.f);
+            viscosityAcceleration[k].Push(currentTime, glm::length(target->viscosityAccelerations[i]) / 10.f);
+            otherAccelerations[k].Push(currentTime, glm::length(target->otherAccelerations[i]) / 10.f);
+            velocity[k].Push(currentTime, glm::length(target->velocities[i]));
         }
         float newMaxDistance = 0.f;
-        if (timeHistory.size() >= 1)
+        for (const glm::vec2 &v : target->velocities)
         {
-            float timeStep = currentTime - timeHistory.back();
-            for (auto &&v : velocity)
-            {
-                newMaxDistance = glm::max(newMaxDistance, timeStep * v.back());
-            }
+            newMaxDistance = glm::max(newMaxDistance, timeStep * glm::length(v));
         }
-        maxDistance.push_back(newMaxDistance);
-        timeHistory.push_back(currentTime);
+        maxDistance.Push(currentTime, newMaxDistance);
+        timeSteps.Push(currentTime, timeStep);
+        lastTime = currentTime;
     }
 }
 
-std::vector<float> &HistoryTracker::GetTimeHistory()
+void HistoryTracker::RecordPressureSolve(unsigned iterations, float densityError)
+{
+    pressureIterations.Push(lastTime, static_cast<float>(iterations));
+    this->densityError.Push(lastTime, densityError);
+}
+
+size_t HistoryTracker::StepCount() const
 {
-    return timeHistory;
+    return timeSteps.Count();
 }
 
 void HistoryTracker::Clear()
 {
-    timeHistory.clear();
-    for (size_t i = 0; i < target->particles.size(); i++)
+    for (auto *histories : {&density, &pressure, &pressureAcceleration, &viscosityAcceleration, &otherAccelerations, &velocity})
+    {
+        for (HistoryBuffer &history : *histories)
+        {
+            history.Clear();
+        }
+    }
+    for (HistoryBuffer *history : {&maxDistance, &timeSteps, &pressureIterations, &densityError})
     {
-        density[i].clear();
-        pressure[i].clear();
-        pressureAcceleration[i].clear();
-        viscosityAcceleration[i].clear();
-        otherAccelerations[i].clear();
-        velocity[i].clear();
+        history->Clear();
     }
-    maxDistance.clear();
-}
\ No newline at end of file
+    lastTime = 0.f;
+}
@@ -1,28 +1,52 @@
-
 #pragma once
 
+#include "HistoryBuffer.hpp"
 #include "ParticleSet.hpp"
 #include <vector>
 
 // Records the evolution of a patricle set over time.
+// By default, every particle is recorded and the history grows with the simulation. With SetBounds, only
+// some particles are recorded, in HistoryBuffers of constant memory.
 class HistoryTracker
 {
 public:
     HistoryTracker();
     void SetTarget(const ParticleSet *target);
-    void Step(float currentTime);
+    // Records only the particles of indices `trackedParticles' (all of them if empty), each quantity in a
+    // HistoryBuffer of `capacity' samples per level, `levels' levels and merge factor `factor'. A capacity
+    // of 0 keeps every sample. Clears the history.
+    void SetBounds(const std::vector<size_t> &trackedParticles, size_t capacity, size_t levels = 1, size_t factor = 2);
+    // Indices of the recorded particles, in the order of the per-particle histories.
+    const std::vector<size_t> &TrackedParticles() const;
+    // Records the state reached at `currentTime' by a step of `timeStep'.
+    void Step(float currentTime, float timeStep);
+    // Records the iteration count and the remaining density error of the pressure solve of the current step.
+    void RecordPressureSolve(unsigned iterations, float densityError);
     void Clear();
-    std::vector<float> &GetTimeHistory();
-    // Properties of particle at index 0 over time
-    std::vector<std::vector<float>> density;
-    std::vector<std::vector<float>> pressure;
-    std::vector<std::vector<float>> pressureAcceleration;
-    std::vector<std::vector<float>> viscosityAcceleration;
-    std::vector<std::vector<float>> otherAccelerations;
-    std::vector<std::vector<float>> velocity;
-    std::vector<float> maxDistance;
+    // Number of recorded steps, including the ones merged or dropped by bounded histories.
+    size_t StepCount() const;
+    // Properties of the tracked particles over time, one history per tracked particle
+    std::vector<HistoryBuffer> density;
+    std::vector<HistoryBuffer> pressure;
+    std::vector<HistoryBuffer> pressureAcceleration;
+    std::vector<HistoryBuffer> viscosityAcceleration;
+    std::vector<HistoryBuffer> otherAccelerations;
+    std::vector<HistoryBuffer> velocity;
+    // Largest distance traveled by a particle of the set during each step
+    HistoryBuffer maxDistance;
+    // Time step of each step
+    HistoryBuffer timeSteps;
+    // Iterations and average density error of the pressure solver at each step
+    HistoryBuffer pressureIterations;
+    HistoryBuffer densityError;
 
 private:
-    std::vector<float> timeHistory;
+    // Allocates the histories of the tracked particles of the target.
+    void Allocate();
+
     const ParticleSet *target;
+    std::vector<size_t> requestedParticles; // Empty for all particles
+    std::vector<size_t> trackedParticles;
+    size_t capacity, levels, factor;
+    float lastTime; // Of the latest step, at which the pressure solve is recorded
 };
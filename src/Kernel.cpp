@@ -1,44 +1,27 @@
 #include "Kernel.hpp"
 
-#include <glm/common.hpp>        // glm::max
-#include <glm/vec2.hpp>          // glm::vec2
-#include <glm/geometric.hpp>     // glm::length
-#include <glm/gtc/constants.hpp> // glm::pi
-#include <exception>
+#include <glm/vec2.hpp> // glm::vec2
+#include <stdexcept>    // std::invalid_argument
 
-Kernel::Kernel(const float h)
-    : h(h), alpha(0.f)
+Kernel::Kernel(const float h, KernelType type)
+    : h(h), type(type)
 {
-    if (h < 0)
-        throw std::invalid_argument("h must be >= 0");
-    // alpha = 1.f / (6.f * h);  // 1D
-    alpha = 5.f / (14.f * glm::pi<float>() * h * h); // 2D
-    // alpha = 1.f / (4.f * glm::pi<float>() * h * h * h);  // 3D
+    if (!(h > 0))
+        throw std::invalid_argument("h must be > 0");
 }
 
-float Kernel::Function(const glm::vec2 &position_i, const glm::vec2 &position_j)
+float Kernel::Function(const glm::vec2 &position_i, const glm::vec2 &position_j) const
 {
-    if (h < 0)
-        throw std::invalid_argument("h must be >= 0");
-    float q = glm::distance(position_i, position_j) / h;
-    float t1 = glm::max(1.f - q, 0.f);
-    float t2 = glm::max(2.f - q, 0.f);
-    return alpha * (t2 * t2 * t2 - 4 * t1 * t1 * t1);
+    float result = 0.f;
+    DispatchKernel<2>(type, h, [&](const auto &kernel) { result = kernel.Function(position_i, position_j); });
+    return result;
 }
 
-glm::vec2 Kernel::Derivative(const glm::vec2 &position_i, const glm::vec2 &position_j)
+glm::vec2 Kernel::Derivative(const glm::vec2 &position_i, const glm::vec2 &position_j) const
 {
-    if (h < 0)
-        throw std::invalid_argument("h must be >= 0");
-
-    float d = glm::distance(position_i, position_j) / h;
-    if (d == 0)
-    {
-        return glm::vec2(0, 0);
-    }
-    float t1 = glm::max(1.f - d, 0.f);
-    float t2 = glm::max(2.f - d, 0.f);
-    return alpha * (position_i - position_j) / (d * h * h) * (-3 * t2 * t2 + 12 * t1 * t1);
+    glm::vec2 result(0.f, 0.f);
+    DispatchKernel<2>(type, h, [&](const auto &kernel) { result = kernel.Derivative(position_i, position_j); });
+    return result;
 }
 
 const std::vector<float> &Kernel::FunctionVertexData()
@@ -83,4 +66,38 @@ const std::vector<float> &Kernel::DerivativeVertexData()
         derivativeVertexData.push_back(1);
     }
     return derivativeVertexData;
-}
\ No newline at end of file
+}
+
+const std::vector<KernelType> &Kernel::Types()
+{
+    static const std::vector<KernelType> types = {KernelType::CubicSpline, KernelType::WendlandC2, KernelType::WendlandC4, KernelType::Poly6Spiky};
+    return types;
+}
+
+const char *Kernel::Name(KernelType type)
+{
+    switch (type)
+    {
+    case KernelType::CubicSpline:
+        return "cubic-spline";
+    case KernelType::WendlandC2:
+        return "wendland-c2";
+    case KernelType::WendlandC4:
+        return "wendland-c4";
+    case KernelType::Poly6Spiky:
+        return "poly6-spiky";
+    }
+    return "unknown";
+}
+
+KernelType Kernel::FromName(const std::string &name)
+{
+    for (KernelType type : Types())
+    {
+        if (name == Name(type))
+        {
+            return type;
+        }
+    }
+    throw std::invalid_argument("unknown kernel " + name);
+}
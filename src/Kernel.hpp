@@ -1,26 +1,36 @@
 #pragma once
 
+#include "KernelFunctions.hpp"
+#include <string>
 #include <vector>
 #include <glm/vec2.hpp>
 
-// Represents the SPH kernel function (here a cubic spline).
+// Represents a 2D SPH kernel chosen at run time (by default the cubic spline).
+// Simulation loops use the compile-time kernels of KernelFunctions.hpp instead.
 class Kernel
 {
 public:
-    // h is the radius of the kernel support
-    Kernel(const float h);
+    // h is the smoothing length (the support radius is 2h), it must be > 0
+    Kernel(const float h, KernelType type = KernelType::CubicSpline);
     // Evaluates the kernel function for two positions.
-    float Function(const glm::vec2 &position_i, const glm::vec2 &position_j);
+    float Function(const glm::vec2 &position_i, const glm::vec2 &position_j) const;
     // Evaluates the kernel function derivative for two positions.
-    glm::vec2 Derivative(const glm::vec2 &position_i, const glm::vec2 &position_j);
+    glm::vec2 Derivative(const glm::vec2 &position_i, const glm::vec2 &position_j) const;
     // Returns the value of the kernel function over an interval, for plotting.
     const std::vector<float> &FunctionVertexData();
     // Returns the value of the kernel function derivative over an interval, for plotting.
     const std::vector<float> &DerivativeVertexData();
 
+    // All kernel types, in the order of KernelType.
+    static const std::vector<KernelType> &Types();
+    // Name of a kernel type, as accepted by FromName (e.g. "cubic-spline").
+    static const char *Name(KernelType type);
+    // Kernel type of a name, throws std::invalid_argument for unknown names.
+    static KernelType FromName(const std::string &name);
+
 private:
     std::vector<float> functionVertexData;
     std::vector<float> derivativeVertexData;
     const float h;
-    float alpha;
+    const KernelType type;
 };
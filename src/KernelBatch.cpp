@@ -0,0 +1,307 @@
+// No contraction of a * b + c into an FMA, which would round differently from CubicSplineKernel<2>.
+// Set before the includes: GCC does not inline functions whose optimization options differ
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+#include "KernelBatch.hpp"
+
+#include <algorithm> // std::max
+#include <cmath>     // std::sqrt
+#include <limits>    // std::numeric_limits
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define MYSOLVER_X86_SIMD
+#include <immintrin.h> // SSE2, AVX2 and AVX-512 intrinsics
+#endif
+
+namespace
+{
+    // Constants of the kernel, broadcast by each implementation
+    struct Constants
+    {
+        float invH, alpha, derivativeAlpha;
+    };
+
+    // Same operations, in the same order, as CubicSplineKernel<2>::Function and Derivative
+    inline float ScalarFunction(const Constants &c, float dx, float dy)
+    {
+        const float q = std::sqrt(dx * dx + dy * dy) * c.invH;
+        const float t1 = std::max(1.f - q, 0.f);
+        const float t2 = std::max(2.f - q, 0.f);
+        return c.alpha * (t2 * t2 * t2 - 4.f * t1 * t1 * t1);
+    }
+
+    inline float ScalarDerivativeFactor(const Constants &c, float dx, float dy)
+    {
+        const float r = std::sqrt(dx * dx + dy * dy);
+        const float q = r * c.invH;
+        const float t1 = std::max(1.f - q, 0.f);
+        const float t2 = std::max(2.f - q, 0.f);
+        return c.derivativeAlpha * (-3.f * t2 * t2 + 12.f * t1 * t1) / std::max(r, std::numeric_limits<float>::min());
+    }
+
+    void FunctionScalar(const Constants &c, float px, float py, const float *x, const float *y, size_t begin, size_t count, float *values)
+    {
+        for (size_t k = begin; k < count; k++)
+        {
+            values[k] = ScalarFunction(c, px - x[k], py - y[k]);
+        }
+    }
+
+    void DerivativeScalar(const Constants &c, float px, float py, const float *x, const float *y, size_t begin, size_t count, float *gradientX, float *gradientY)
+    {
+        for (size_t k = begin; k < count; k++)
+        {
+            const float dx = px - x[k];
+            const float dy = py - y[k];
+            const float factor = ScalarDerivativeFactor(c, dx, dy);
+            gradientX[k] = dx * factor;
+            gradientY[k] = dy * factor;
+        }
+    }
+
+#ifdef MYSOLVER_X86_SIMD
+    // SSE2: 4 neighbors at a time, the tail is computed by the scalar code
+
+    __attribute__((target("sse2"))) void FunctionSSE2(const Constants &c, float px, float py, const float *x, const float *y, size_t count, float *values)
+    {
+        const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.f), two = _mm_set1_ps(2.f), four = _mm_set1_ps(4.f);
+        const __m128 invH = _mm_set1_ps(c.invH), alpha = _mm_set1_ps(c.alpha);
+        const __m128 positionX = _mm_set1_ps(px), positionY = _mm_set1_ps(py);
+        size_t k = 0;
+        for (; k + 4 <= count; k += 4)
+        {
+            const __m128 dx = _mm_sub_ps(positionX, _mm_loadu_ps(x + k));
+            const __m128 dy = _mm_sub_ps(positionY, _mm_loadu_ps(y + k));
+            const __m128 q = _mm_mul_ps(_mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy))), invH);
+            const __m128 t1 = _mm_max_ps(_mm_sub_ps(one, q), zero);
+            const __m128 t2 = _mm_max_ps(_mm_sub_ps(two, q), zero);
+            const __m128 f = _mm_sub_ps(_mm_mul_ps(_mm_mul_ps(t2, t2), t2), _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(four, t1), t1), t1));
+            _mm_storeu_ps(values + k, _mm_mul_ps(alpha, f));
+        }
+        FunctionScalar(c, px, py, x, y, k, count, values);
+    }
+
+    __attribute__((target("sse2"))) void DerivativeSSE2(const Constants &c, float px, float py, const float *x, const float *y, size_t count, float *gradientX, float *gradientY)
+    {
+        const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.f), two = _mm_set1_ps(2.f);
+        const __m128 minusThree = _mm_set1_ps(-3.f), twelve = _mm_set1_ps(12.f);
+        const __m128 minR = _mm_set1_ps(std::numeric_limits<float>::min());
+        const __m128 invH = _mm_set1_ps(c.invH), derivativeAlpha = _mm_set1_ps(c.derivativeAlpha);
+        const __m128 positionX = _mm_set1_ps(px), positionY = _mm_set1_ps(py);
+        size_t k = 0;
+        for (; k + 4 <= count; k += 4)
+        {
+            const __m128 dx = _mm_sub_ps(positionX, _mm_loadu_ps(x + k));
+            const __m128 dy = _mm_sub_ps(positionY, _mm_loadu_ps(y + k));
+            const __m128 r = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+            const __m128 q = _mm_mul_ps(r, invH);
+            const __m128 t1 = _mm_max_ps(_mm_sub_ps(one, q), zero);
+            const __m128 t2 = _mm_max_ps(_mm_sub_ps(two, q), zero);
+            const __m128 slope = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(minusThree, t2), t2), _mm_mul_ps(_mm_mul_ps(twelve, t1), t1));
+            const __m128 factor = _mm_div_ps(_mm_mul_ps(derivativeAlpha, slope), _mm_max_ps(r, minR));
+            _mm_storeu_ps(gradientX + k, _mm_mul_ps(dx, factor));
+            _mm_storeu_ps(gradientY + k, _mm_mul_ps(dy, factor));
+        }
+        DerivativeScalar(c, px, py, x, y, k, count, gradientX, gradientY);
+    }
+
+    // AVX2: 8 neighbors at a time, the tail is loaded and stored with a mask
+
+    __attribute__((target("avx2"))) inline __m256i TailMask8(size_t remaining)
+    {
+        return _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(remaining)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    }
+
+    __attribute__((target("avx2"))) void FunctionAVX2(const Constants &c, float px, float py, const float *x, const float *y, size_t count, float *values)
+    {
+        const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.f), two = _mm256_set1_ps(2.f), four = _mm256_set1_ps(4.f);
+        const __m256 invH = _mm256_set1_ps(c.invH), alpha = _mm256_set1_ps(c.alpha);
+        const __m256 positionX = _mm256_set1_ps(px), positionY = _mm256_set1_ps(py);
+        for (size_t k = 0; k < count; k += 8)
+        {
+            const __m256i mask = TailMask8(count - k);
+            const __m256 dx = _mm256_sub_ps(positionX, _mm256_maskload_ps(x + k, mask));
+            const __m256 dy = _mm256_sub_ps(positionY, _mm256_maskload_ps(y + k, mask));
+            const __m256 q = _mm256_mul_ps(_mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy))), invH);
+            const __m256 t1 = _mm256_max_ps(_mm256_sub_ps(one, q), zero);
+            const __m256 t2 = _mm256_max_ps(_mm256_sub_ps(two, q), zero);
+            const __m256 f = _mm256_sub_ps(_mm256_mul_ps(_mm256_mul_ps(t2, t2), t2), _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(four, t1), t1), t1));
+            _mm256_maskstore_ps(values + k, mask, _mm256_mul_ps(alpha, f));
+        }
+    }
+
+    __attribute__((target("avx2"))) void DerivativeAVX2(const Constants &c, float px, float py, const float *x, const float *y, size_t count, float *gradientX, float *gradientY)
+    {
+        const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.f), two = _mm256_set1_ps(2.f);
+        const __m256 minusThree = _mm256_set1_ps(-3.f), twelve = _mm256_set1_ps(12.f);
+        const __m256 minR = _mm256_set1_ps(std::numeric_limits<float>::min());
+        const __m256 invH = _mm256_set1_ps(c.invH), derivativeAlpha = _mm256_set1_ps(c.derivativeAlpha);
+        const __m256 positionX = _mm256_set1_ps(px), positionY = _mm256_set1_ps(py);
+        for (size_t k = 0; k < count; k += 8)
+        {
+            const __m256i mask = TailMask8(count - k);
+            const __m256 dx = _mm256_sub_ps(positionX, _mm256_maskload_ps(x + k, mask));
+            const __m256 dy = _mm256_sub_ps(positionY, _mm256_maskload_ps(y + k, mask));
+            const __m256 r = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)));
+            const __m256 q = _mm256_mul_ps(r, invH);
+            const __m256 t1 = _mm256_max_ps(_mm256_sub_ps(one, q), zero);
+            const __m256 t2 = _mm256_max_ps(_mm256_sub_ps(two, q), zero);
+            const __m256 slope = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(minusThree, t2), t2), _mm256_mul_ps(_mm256_mul_ps(twelve, t1), t1));
+            const __m256 factor = _mm256_div_ps(_mm256_mul_ps(derivativeAlpha, slope), _mm256_max_ps(r, minR));
+            _mm256_maskstore_ps(gradientX + k, mask, _mm256_mul_ps(dx, factor));
+            _mm256_maskstore_ps(gradientY + k, mask, _mm256_mul_ps(dy, factor));
+        }
+    }
+
+    // AVX-512: 16 neighbors at a time, the tail is loaded and stored with a mask register
+    // (GCC warns about the deliberately undefined sources that its headers pass to the unmasked intrinsics)
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+    __attribute__((target("avx512f"))) inline __mmask16 TailMask16(size_t remaining)
+    {
+        return remaining >= 16 ? static_cast<__mmask16>(0xFFFF) : static_cast<__mmask16>((1u << remaining) - 1u);
+    }
+
+    __attribute__((target("avx512f"))) void FunctionAVX512(const Constants &c, float px, float py, const float *x, const float *y, size_t count, float *values)
+    {
+        const __m512 zero = _mm512_setzero_ps(), one = _mm512_set1_ps(1.f), two = _mm512_set1_ps(2.f), four = _mm512_set1_ps(4.f);
+        const __m512 invH = _mm512_set1_ps(c.invH), alpha = _mm512_set1_ps(c.alpha);
+        const __m512 positionX = _mm512_set1_ps(px), positionY = _mm512_set1_ps(py);
+        for (size_t k = 0; k < count; k += 16)
+        {
+            const __mmask16 mask = TailMask16(count - k);
+            const __m512 dx = _mm512_sub_ps(positionX, _mm512_maskz_loadu_ps(mask, x + k));
+            const __m512 dy = _mm512_sub_ps(positionY, _mm512_maskz_loadu_ps(mask, y + k));
+            const __m512 q = _mm512_mul_ps(_mm512_sqrt_ps(_mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy))), invH);
+            const __m512 t1 = _mm512_max_ps(_mm512_sub_ps(one, q), zero);
+            const __m512 t2 = _mm512_max_ps(_mm512_sub_ps(two, q), zero);
+            const __m512 f = _mm512_sub_ps(_mm512_mul_ps(_mm512_mul_ps(t2, t2), t2), _mm512_mul_ps(_mm512_mul_ps(_mm512_mul_ps(four, t1), t1), t1));
+            _mm512_mask_storeu_ps(values + k, mask, _mm512_mul_ps(alpha, f));
+        }
+    }
+
+    __attribute__((target("avx512f"))) void DerivativeAVX512(const Constants &c, float px, float py, const float *x, const float *y, size_t count, float *gradientX, float *gradientY)
+    {
+        const __m512 zero = _mm512_setzero_ps(), one = _mm512_set1_ps(1.f), two = _mm512_set1_ps(2.f);
+        const __m512 minusThree = _mm512_set1_ps(-3.f), twelve = _mm512_set1_ps(12.f);
+        const __m512 minR = _mm512_set1_ps(std::numeric_limits<float>::min());
+        const __m512 invH = _mm512_set1_ps(c.invH), derivativeAlpha = _mm512_set1_ps(c.derivativeAlpha);
+        const __m512 positionX = _mm512_set1_ps(px), positionY = _mm512_set1_ps(py);
+        for (size_t k = 0; k < count; k += 16)
+        {
+            const __mmask16 mask = TailMask16(count - k);
+            const __m512 dx = _mm512_sub_ps(positionX, _mm512_maskz_loadu_ps(mask, x + k));
+            const __m512 dy = _mm512_sub_ps(positionY, _mm512_maskz_loadu_ps(mask, y + k));
+            const __m512 r = _mm512_sqrt_ps(_mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy)));
+            const __m512 q = _mm512_mul_ps(r, invH);
+            const __m512 t1 = _mm512_max_ps(_mm512_sub_ps(one, q), zero);
+            const __m512 t2 = _mm512_max_ps(_mm512_sub_ps(two, q), zero);
+            const __m512 slope = _mm512_add_ps(_mm512_mul_ps(_mm512_mul_ps(minusThree, t2), t2), _mm512_mul_ps(_mm512_mul_ps(twelve, t1), t1));
+            const __m512 factor = _mm512_div_ps(_mm512_mul_ps(derivativeAlpha, slope), _mm512_max_ps(r, minR));
+            _mm512_mask_storeu_ps(gradientX + k, mask, _mm512_mul_ps(dx, factor));
+            _mm512_mask_storeu_ps(gradientY + k, mask, _mm512_mul_ps(dy, factor));
+        }
+    }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+} // namespace
+
+KernelBatch::KernelBatch(float h, SimdLevel level)
+    : invH(1.f / h),
+      alpha(CubicSplineKernel<2>::sigma / kernels::IntegerPower(h, 2)),
+      derivativeAlpha(CubicSplineKernel<2>::derivativeSigma / kernels::IntegerPower(h, 3)),
+      level(std::min(level, DetectedLevel()))
+{
+}
+
+void KernelBatch::Function(float positionX, float positionY, const float *x, const float *y, size_t count, float *values) const
+{
+    const Constants constants = {invH, alpha, derivativeAlpha};
+    switch (level)
+    {
+#ifdef MYSOLVER_X86_SIMD
+    case SimdLevel::AVX512:
+        FunctionAVX512(constants, positionX, positionY, x, y, count, values);
+        break;
+    case SimdLevel::AVX2:
+        FunctionAVX2(constants, positionX, positionY, x, y, count, values);
+        break;
+    case SimdLevel::SSE2:
+        FunctionSSE2(constants, positionX, positionY, x, y, count, values);
+        break;
+#endif
+    default:
+        FunctionScalar(constants, positionX, positionY, x, y, 0, count, values);
+    }
+}
+
+void KernelBatch::Derivative(float positionX, float positionY, const float *x, const float *y, size_t count, float *gradientX, float *gradientY) const
+{
+    const Constants constants = {invH, alpha, derivativeAlpha};
+    switch (level)
+    {
+#ifdef MYSOLVER_X86_SIMD
+    case SimdLevel::AVX512:
+        DerivativeAVX512(constants, positionX, positionY, x, y, count, gradientX, gradientY);
+        break;
+    case SimdLevel::AVX2:
+        DerivativeAVX2(constants, positionX, positionY, x, y, count, gradientX, gradientY);
+        break;
+    case SimdLevel::SSE2:
+        DerivativeSSE2(constants, positionX, positionY, x, y, count, gradientX, gradientY);
+        break;
+#endif
+    default:
+        DerivativeScalar(constants, positionX, positionY, x, y, 0, count, gradientX, gradientY);
+    }
+}
+
+SimdLevel KernelBatch::DetectedLevel()
+{
+#ifdef MYSOLVER_X86_SIMD
+    static const SimdLevel detected = __builtin_cpu_supports("avx512f")  ? SimdLevel::AVX512
+                                      : __builtin_cpu_supports("avx2") ? SimdLevel::AVX2
+                                      : __builtin_cpu_supports("sse2") ? SimdLevel::SSE2
+                                                                       : SimdLevel::Scalar;
+    return detected;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+const char *KernelBatch::Name(SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdLevel::Scalar:
+        return "scalar";
+    case SimdLevel::SSE2:
+        return "sse2";
+    case SimdLevel::AVX2:
+        return "avx2";
+    case SimdLevel::AVX512:
+        return "avx512";
+    }
+    return "unknown";
+}
+
+void KernelBatchScratch::Reserve(size_t count)
+{
+    if (x.size() < count)
+    {
+        x.resize(count);
+        y.resize(count);
+        values.resize(count);
+        gradientX.resize(count);
+        gradientY.resize(count);
+    }
+}
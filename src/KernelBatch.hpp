@@ -0,0 +1,54 @@
+#pragma once
+
+#include "KernelFunctions.hpp"
+#include <cstddef> // size_t
+#include <vector>  // std::vector
+
+// Instruction sets of the batched kernels.
+enum class SimdLevel
+{
+    Scalar,
+    SSE2,  // 4 neighbors per instruction, scalar tail
+    AVX2,  // 8 neighbors per instruction, masked tail
+    AVX512 // 16 neighbors per instruction, masked tail
+};
+
+// Evaluates the 2D cubic spline kernel (support 2h) between one particle and a batch of neighbors
+// whose coordinates are stored in separate x and y arrays.
+// Results are bit-identical to CubicSplineKernel<2> for every instruction set: the operations are the
+// same and in the same order, sqrt and division are correctly rounded in SIMD as well, and
+// KernelBatch.cpp is compiled without floating-point contraction (no FMA).
+class KernelBatch
+{
+public:
+    // h is the smoothing length. By default the best instruction set of the CPU is used.
+    explicit KernelBatch(float h, SimdLevel level = DetectedLevel());
+    // values[k] = W(position - (x[k], y[k])) for k < count.
+    void Function(float positionX, float positionY, const float *x, const float *y, size_t count, float *values) const;
+    // (gradientX[k], gradientY[k]) = grad W(position - (x[k], y[k])), with respect to position.
+    void Derivative(float positionX, float positionY, const float *x, const float *y, size_t count, float *gradientX, float *gradientY) const;
+    SimdLevel Level() const { return level; }
+
+    // Best instruction set supported by the CPU (and by the compiler), detected once with CPUID.
+    static SimdLevel DetectedLevel();
+    static const char *Name(SimdLevel level);
+
+private:
+    float invH, alpha, derivativeAlpha;
+    SimdLevel level;
+};
+
+// Scratch arrays of a thread evaluating rows of neighbors with a KernelBatch.
+struct KernelBatchScratch
+{
+    std::vector<float> x, y, values, gradientX, gradientY;
+    void Reserve(size_t count);
+};
+
+// CubicSplineKernel<2> whose rows of neighbors are evaluated in batches (see ParticleSimulation).
+class BatchedCubicSplineKernel : public CubicSplineKernel<2>
+{
+public:
+    BatchedCubicSplineKernel(float h, SimdLevel level) : CubicSplineKernel<2>(h), batch(h, level) {}
+    KernelBatch batch;
+};
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <glm/common.hpp>            // glm::max
+#include <glm/geometric.hpp>         // glm::length
+#include <glm/ext/vector_float1.hpp> // glm::vec1
+#include <glm/vec2.hpp>              // glm::vec2
+#include <glm/vec3.hpp>              // glm::vec3
+#include <limits>                    // std::numeric_limits
+
+// Compile-time SPH kernels.
+// Every kernel has a support of 2h and is a radial function W(r) = alpha * f(q) with q = r / h, where
+// alpha = sigma / h^Dim. The shape f and the normalization sigma are given by a shape policy, so that
+// simulation loops instantiated on a kernel type inline the whole evaluation. Evaluation is branch-free:
+// the compact support comes from clamping (max), and the gradient at r = 0 is zero since the
+// difference vector is.
+
+// Kernels that can be selected at run time (see DispatchKernel).
+enum class KernelType
+{
+    CubicSpline,
+    WendlandC2,
+    WendlandC4,
+    Poly6Spiky
+};
+
+namespace kernels
+{
+    constexpr float pi = 3.14159265358979f;
+
+    constexpr float IntegerPower(float x, int n)
+    {
+        float result = 1.f;
+        for (int i = 0; i < n; i++)
+        {
+            result *= x;
+        }
+        return result;
+    }
+
+    // Shape policies: Function(q) and its derivative df/dq, with the normalization of each in 1D, 2D
+    // and 3D (0 where the kernel is not defined). The derivative has its own normalization so that a
+    // kernel may use the gradient of another function (Poly6/Spiky).
+
+    // Cubic spline of Monaghan (1992): f = (2 - q)^3 - 4 (1 - q)^3 on [0, 1], (2 - q)^3 on [1, 2].
+    struct CubicSplineShape
+    {
+        static constexpr float Normalization(int dim)
+        {
+            return dim == 1 ? 1.f / 6.f : dim == 2 ? 5.f / (14.f * pi) : dim == 3 ? 1.f / (4.f * pi) : 0.f;
+        }
+        static constexpr float DerivativeNormalization(int dim) { return Normalization(dim); }
+        static float Function(float q)
+        {
+            const float t1 = glm::max(1.f - q, 0.f);
+            const float t2 = glm::max(2.f - q, 0.f);
+            return t2 * t2 * t2 - 4.f * t1 * t1 * t1;
+        }
+        static float Derivative(float q)
+        {
+            const float t1 = glm::max(1.f - q, 0.f);
+            const float t2 = glm::max(2.f - q, 0.f);
+            return -3.f * t2 * t2 + 12.f * t1 * t1;
+        }
+    };
+
+    // Wendland C2 (Dehnen & Aly 2012) in 2D and 3D: f = (1 - s)^4 (1 + 4s) with s = q / 2.
+    struct WendlandC2Shape
+    {
+        static constexpr float Normalization(int dim)
+        {
+            return dim == 2 ? 7.f / (4.f * pi) : dim == 3 ? 21.f / (16.f * pi) : 0.f;
+        }
+        static constexpr float DerivativeNormalization(int dim) { return Normalization(dim); }
+        static float Function(float q)
+        {
+            const float s = .5f * q;
+            const float t = glm::max(1.f - s, 0.f);
+            const float t2 = t * t;
+            return t2 * t2 * (1.f + 4.f * s);
+        }
+        static float Derivative(float q)
+        {
+            const float s = .5f * q;
+            const float t = glm::max(1.f - s, 0.f);
+            return -10.f * s * t * t * t;
+        }
+    };
+
+    // Wendland C4 (Dehnen & Aly 2012) in 2D and 3D: f = (1 - s)^6 (1 + 6s + 35/3 s^2) with s = q / 2.
+    struct WendlandC4Shape
+    {
+        static constexpr float Normalization(int dim)
+        {
+            return dim == 2 ? 9.f / (4.f * pi) : dim == 3 ? 495.f / (256.f * pi) : 0.f;
+        }
+        static constexpr float DerivativeNormalization(int dim) { return Normalization(dim); }
+        static float Function(float q)
+        {
+            const float s = .5f * q;
+            const float t = glm::max(1.f - s, 0.f);
+            const float t2 = t * t;
+            return t2 * t2 * t2 * (1.f + 6.f * s + 35.f / 3.f * s * s);
+        }
+        static float Derivative(float q)
+        {
+            const float s = .5f * q;
+            const float t = glm::max(1.f - s, 0.f);
+            const float t2 = t * t;
+            return -28.f / 3.f * s * (1.f + 5.f * s) * t2 * t2 * t;
+        }
+    };
+
+    // Poly6 function with the gradient of the Spiky kernel (Mueller et al. 2003), the usual pairing that
+    // avoids the vanishing Poly6 gradient near r = 0: f = (1 - s^2)^3 and grad (1 - s)^3, with s = q / 2.
+    struct Poly6SpikyShape
+    {
+        static constexpr float Normalization(int dim)
+        {
+            return dim == 1 ? 35.f / 64.f : dim == 2 ? 1.f / pi : dim == 3 ? 315.f / (512.f * pi) : 0.f;
+        }
+        static constexpr float DerivativeNormalization(int dim)
+        {
+            return dim == 1 ? 1.f : dim == 2 ? 5.f / (2.f * pi) : dim == 3 ? 15.f / (8.f * pi) : 0.f;
+        }
+        static float Function(float q)
+        {
+            const float s = .5f * q;
+            const float t = glm::max(1.f - s * s, 0.f);
+            return t * t * t;
+        }
+        static float Derivative(float q)
+        {
+            const float t = glm::max(1.f - .5f * q, 0.f);
+            return -1.5f * t * t;
+        }
+    };
+} // namespace kernels
+
+// Kernel of support 2h in `Dim' dimensions, with the shape `Shape'.
+template <int Dim, typename Shape>
+class RadialKernel
+{
+    static_assert(Shape::Normalization(Dim) > 0.f, "the kernel is not defined in this dimension");
+
+public:
+    using Vector = glm::vec<Dim, float, glm::defaultp>;
+    static constexpr int dimension = Dim;
+    // Normalization constants of the function and of the derivative for h = 1.
+    static constexpr float sigma = Shape::Normalization(Dim);
+    static constexpr float derivativeSigma = Shape::DerivativeNormalization(Dim);
+
+    // h is the smoothing length (half of the support radius), it must be > 0.
+    explicit RadialKernel(float h)
+        : h(h), invH(1.f / h),
+          alpha(sigma / kernels::IntegerPower(h, Dim)),
+          derivativeAlpha(derivativeSigma / kernels::IntegerPower(h, Dim + 1))
+    {
+    }
+    // Evaluates the kernel function for two positions.
+    float Function(const Vector &position_i, const Vector &position_j) const
+    {
+        return alpha * Shape::Function(glm::length(position_i - position_j) * invH);
+    }
+    // Evaluates the gradient of the kernel with respect to position_i.
+    Vector Derivative(const Vector &position_i, const Vector &position_j) const
+    {
+        const Vector difference = position_i - position_j;
+        const float r = glm::length(difference);
+        // r = 0 gives a zero difference vector, hence a zero gradient
+        return difference * (derivativeAlpha * Shape::Derivative(r * invH) / glm::max(r, std::numeric_limits<float>::min()));
+    }
+    float SupportRadius() const { return 2.f * h; }
+
+private:
+    float h, invH;
+    float alpha, derivativeAlpha;
+};
+
+template <int Dim, typename Shape>
+constexpr float RadialKernel<Dim, Shape>::sigma;
+template <int Dim, typename Shape>
+constexpr float RadialKernel<Dim, Shape>::derivativeSigma;
+
+template <int Dim>
+using CubicSplineKernel = RadialKernel<Dim, kernels::CubicSplineShape>;
+template <int Dim>
+using WendlandC2Kernel = RadialKernel<Dim, kernels::WendlandC2Shape>;
+template <int Dim>
+using WendlandC4Kernel = RadialKernel<Dim, kernels::WendlandC4Shape>;
+template <int Dim>
+using Poly6SpikyKernel = RadialKernel<Dim, kernels::Poly6SpikyShape>;
+
+// Calls `function(kernel)' with a kernel of type `type' and smoothing length `h', so that `function'
+// (typically a generic lambda) is instantiated once per kernel.
+template <int Dim, typename Function>
+void DispatchKernel(KernelType type, float h, Function &&function)
+{
+    switch (type)
+    {
+    case KernelType::CubicSpline:
+        function(CubicSplineKernel<Dim>(h));
+        break;
+    case KernelType::WendlandC2:
+        function(WendlandC2Kernel<Dim>(h));
+        break;
+    case KernelType::WendlandC4:
+        function(WendlandC4Kernel<Dim>(h));
+        break;
+    case KernelType::Poly6Spiky:
+        function(Poly6SpikyKernel<Dim>(h));
+        break;
+    }
+}
@@ -0,0 +1,112 @@
+#include "NeighborGrid.hpp"
+
+#include "ThreadPool.hpp" // ThreadPool
+#include <glm/common.hpp> // glm::min, glm::max
+#include <cmath>          // std::isfinite, std::sqrt
+#include <limits>         // std::numeric_limits
+
+NeighborGrid::NeighborGrid()
+    : points(nullptr), origin(0.f, 0.f), cellSize(1.f), countX(0), countY(0)
+{
+}
+
+void NeighborGrid::Build(const glm::vec2 *points, size_t count, float cellSize, ThreadPool *threadPool)
+{
+    this->points = points;
+    this->cellSize = cellSize;
+    ThreadPool serial(1);
+    ThreadPool &pool = threadPool != nullptr ? *threadPool : serial;
+
+    // Bounding box of the (finite) points
+    threadLower.assign(pool.ThreadCount(), glm::vec2(std::numeric_limits<float>::max()));
+    threadUpper.assign(pool.ThreadCount(), glm::vec2(std::numeric_limits<float>::lowest()));
+    pool.ParallelFor(count, [&](size_t begin, size_t end, unsigned t) {
+        glm::vec2 lower = threadLower[t];
+        glm::vec2 upper = threadUpper[t];
+        for (size_t i = begin; i < end; i++)
+        {
+            if (std::isfinite(points[i].x) && std::isfinite(points[i].y))
+            {
+                lower = glm::min(lower, points[i]);
+                upper = glm::max(upper, points[i]);
+            }
+        }
+        threadLower[t] = lower;
+        threadUpper[t] = upper;
+    });
+    glm::vec2 lower = threadLower[0];
+    glm::vec2 upper = threadUpper[0];
+    for (unsigned t = 1; t < pool.ThreadCount(); t++)
+    {
+        lower = glm::min(lower, threadLower[t]);
+        upper = glm::max(upper, threadUpper[t]);
+    }
+    if (lower.x > upper.x)
+    {
+        // No finite point: empty grid
+        countX = countY = 0;
+        cellStart.assign(1, 0);
+        sortedIndices.clear();
+        return;
+    }
+    origin = lower;
+
+    // Keep the number of cells proportional to the number of points, even when a few particles
+    // fly far away. Larger cells remain correct since the 3x3 block still covers the radius.
+    const double maxCells = 4.0 * count + 64.0;
+    double cellsX = std::floor((upper.x - lower.x) / this->cellSize) + 1.0;
+    double cellsY = std::floor((upper.y - lower.y) / this->cellSize) + 1.0;
+    while (cellsX * cellsY > maxCells)
+    {
+        this->cellSize *= static_cast<float>(std::sqrt(cellsX * cellsY / maxCells)) * 1.01f;
+        cellsX = std::floor((upper.x - lower.x) / this->cellSize) + 1.0;
+        cellsY = std::floor((upper.y - lower.y) / this->cellSize) + 1.0;
+    }
+    countX = static_cast<int>(cellsX);
+    countY = static_cast<int>(cellsY);
+    const unsigned cellCount = countX * countY;
+
+    // Counting sort of the points by cell. Non-finite points are put in no cell.
+    const unsigned noCell = cellCount;
+    pointCell.resize(count);
+    pool.ParallelFor(count, [&](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i < end; i++)
+        {
+            if (std::isfinite(points[i].x) && std::isfinite(points[i].y))
+            {
+                const int cx = glm::min(CellCoordinate(points[i].x, origin.x), countX - 1);
+                const int cy = glm::min(CellCoordinate(points[i].y, origin.y), countY - 1);
+                pointCell[i] = cy * countX + cx;
+            }
+            else
+            {
+                pointCell[i] = noCell;
+            }
+        }
+    });
+    cellStart.assign(cellCount + 2, 0);
+    for (size_t i = 0; i < count; i++)
+    {
+        cellStart[pointCell[i] + 1]++;
+    }
+    for (unsigned c = 0; c < cellCount + 1; c++)
+    {
+        cellStart[c + 1] += cellStart[c];
+    }
+    sortedIndices.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        sortedIndices[cellStart[pointCell[i]]++] = static_cast<unsigned>(i);
+    }
+    // Filling shifted each start to the start of the next cell: shift back
+    for (unsigned c = cellCount + 1; c > 0; c--)
+    {
+        cellStart[c] = cellStart[c - 1];
+    }
+    cellStart[0] = 0;
+}
+
+size_t NeighborGrid::CellCount() const
+{
+    return static_cast<size_t>(countX) * countY;
+}
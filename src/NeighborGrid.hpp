@@ -0,0 +1,82 @@
+#pragma once
+
+#include <glm/vec2.hpp> // glm::vec2
+#include <cmath>        // std::floor
+#include <vector>       // std::vector
+
+class ThreadPool;
+
+// Uniform grid of square cells used to find the neighbors of a point in linear time.
+// Points are bucketed into cells with a counting sort (cell-linked list stored as
+// one contiguous array), so that every point closer than the cell size to a query
+// lies in the 3x3 block of cells around it.
+class NeighborGrid
+{
+public:
+    NeighborGrid();
+    // Sorts `count' points into cells whose size is at least `cellSize'.
+    // The bounding box and the cell of each point are computed in parallel when a thread pool is given.
+    void Build(const glm::vec2 *points, size_t count, float cellSize, ThreadPool *threadPool = nullptr);
+    // Calls `callback(index)' for each point strictly closer than `radius' to `position'.
+    // `radius' must not be larger than the cell size given to Build.
+    template <typename Callback>
+    void ForEachNeighbor(const glm::vec2 &position, float radius, Callback callback) const;
+    // Number of cells of the grid (for diagnostics).
+    size_t CellCount() const;
+
+private:
+    // Index of the cell containing `position' along one axis (may be out of range).
+    int CellCoordinate(float position, float origin) const;
+
+private:
+    const glm::vec2 *points;
+    glm::vec2 origin;
+    float cellSize;
+    int countX, countY;
+    std::vector<unsigned> cellStart;     // Offset of the first point of each cell in `sortedIndices'.
+    std::vector<unsigned> sortedIndices; // Point indices, sorted by cell.
+    std::vector<unsigned> pointCell;     // Cell of each point (scratch buffer reused across builds).
+    std::vector<glm::vec2> threadLower, threadUpper; // Partial bounding boxes of each thread.
+};
+
+inline int NeighborGrid::CellCoordinate(float position, float origin) const
+{
+    return static_cast<int>(std::floor((position - origin) / cellSize));
+}
+
+template <typename Callback>
+void NeighborGrid::ForEachNeighbor(const glm::vec2 &position, float radius, Callback callback) const
+{
+    // Non-finite positions have no neighbors (the comparison below would fail for all points anyway).
+    if (countX == 0 || !std::isfinite(position.x) || !std::isfinite(position.y))
+    {
+        return;
+    }
+    const float radius2 = radius * radius;
+    const float x = (position.x - origin.x) / cellSize;
+    const float y = (position.y - origin.y) / cellSize;
+    // Queries further than one cell away from the grid have no neighbors
+    if (x < -1.f || y < -1.f || x >= countX + 1.f || y >= countY + 1.f)
+    {
+        return;
+    }
+    const int minX = static_cast<int>(std::floor(std::fmax(x - 1.f, 0.f)));
+    const int maxX = static_cast<int>(std::floor(std::fmin(x + 1.f, countX - 1.f)));
+    const int minY = static_cast<int>(std::floor(std::fmax(y - 1.f, 0.f)));
+    const int maxY = static_cast<int>(std::floor(std::fmin(y + 1.f, countY - 1.f)));
+    for (int cy = minY; cy <= maxY; cy++)
+    {
+        // Cells of a row are contiguous, so a whole row of the 3x3 block is a single range
+        const unsigned begin = cellStart[cy * countX + minX];
+        const unsigned end = cellStart[cy * countX + maxX + 1];
+        for (unsigned k = begin; k < end; k++)
+        {
+            const unsigned index = sortedIndices[k];
+            const glm::vec2 diff = points[index] - position;
+            if (diff.x * diff.x + diff.y * diff.y < radius2)
+            {
+                callback(index);
+            }
+        }
+    }
+}
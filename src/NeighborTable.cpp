@@ -0,0 +1,50 @@
+#include "NeighborTable.hpp"
+
+#include <algorithm> // std::copy
+
+NeighborTable::NeighborTable()
+    : setCount(0), offsets(1, 0), indices()
+{
+}
+
+void NeighborTable::Reset(size_t setCount)
+{
+    this->setCount = setCount;
+    offsets.resize(1);
+    offsets[0] = 0;
+    indices.clear();
+}
+
+size_t NeighborTable::Size() const
+{
+    return indices.size();
+}
+
+size_t NeighborTable::RowCount() const
+{
+    return offsets.size() - 1;
+}
+
+void NeighborTable::Resize(size_t setCount, size_t rowCount, size_t indexCount)
+{
+    this->setCount = setCount;
+    offsets.resize(rowCount + 1);
+    offsets[0] = 0;
+    indices.resize(indexCount);
+}
+
+void NeighborTable::Assign(size_t setCount, const unsigned *offsets, size_t rowCount, const unsigned *indices, size_t indexCount)
+{
+    this->setCount = setCount;
+    this->offsets.assign(offsets, offsets + rowCount + 1);
+    this->indices.assign(indices, indices + indexCount);
+}
+
+void NeighborTable::CopyRows(const NeighborTable &part, size_t firstRow, size_t firstIndex)
+{
+    for (size_t row = 0; row < part.RowCount(); row++)
+    {
+        offsets[firstRow + row + 1] = static_cast<unsigned>(firstIndex + part.offsets[row + 1]);
+    }
+    std::copy(part.indices.begin(), part.indices.end(), indices.begin() + firstIndex);
+}
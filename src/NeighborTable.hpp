@@ -0,0 +1,62 @@
+#pragma once
+
+#include <algorithm> // std::sort
+#include <cstddef>   // size_t
+#include <vector>    // std::vector
+
+// Neighbor indices of all particles of one set, in compressed sparse row format.
+// Each row holds the neighbors of one particle that belong to one particle set, and rows are
+// ordered by particle then by neighbor set. The arrays keep their capacity across updates,
+// so rebuilding the table every step does not allocate memory once it has reached its final size.
+class NeighborTable
+{
+public:
+    // Contiguous range of neighbor indices.
+    struct Range
+    {
+        const unsigned *first, *last;
+        const unsigned *begin() const { return first; }
+        const unsigned *end() const { return last; }
+        size_t size() const { return last - first; }
+    };
+
+    NeighborTable();
+    // Forgets all rows, keeping the allocated memory. `setCount' is the number of rows per particle.
+    void Reset(size_t setCount);
+    // Appends a neighbor index to the row being filled.
+    void Add(unsigned neighborIndex) { indices.push_back(neighborIndex); }
+    // Closes the row being filled, sorting its indices. Rows must be closed for each particle and each set in order.
+    // Sorted rows do not depend on how the neighbors were found, and make accesses to the neighbor data monotonic.
+    void EndRow()
+    {
+        std::sort(indices.begin() + offsets.back(), indices.end());
+        offsets.push_back(static_cast<unsigned>(indices.size()));
+    }
+    // Neighbors of particle `particleIndex' that belong to set `setIndex'.
+    Range Neighbors(size_t particleIndex, size_t setIndex) const
+    {
+        const size_t row = particleIndex * setCount + setIndex;
+        return Range{indices.data() + offsets[row], indices.data() + offsets[row + 1]};
+    }
+    // Position of the first neighbor of a row among all stored indices, to address per-neighbor data.
+    size_t Offset(size_t particleIndex, size_t setIndex) const { return offsets[particleIndex * setCount + setIndex]; }
+    // Total number of stored neighbor indices.
+    size_t Size() const;
+    // Number of closed rows.
+    size_t RowCount() const;
+    // Sizes the table to hold `rowCount' rows and `indexCount' indices, to be filled by CopyRows.
+    void Resize(size_t setCount, size_t rowCount, size_t indexCount);
+    // Rows per particle, and the arrays of the table, to save and restore it (see Checkpoint).
+    size_t SetCount() const { return setCount; }
+    const std::vector<unsigned> &Offsets() const { return offsets; }
+    const std::vector<unsigned> &Indices() const { return indices; }
+    void Assign(size_t setCount, const unsigned *offsets, size_t rowCount, const unsigned *indices, size_t indexCount);
+    // Copies all the rows of `part' so that they start at row `firstRow' and at index `firstIndex'.
+    // Parts copied to disjoint rows may be copied concurrently.
+    void CopyRows(const NeighborTable &part, size_t firstRow, size_t firstIndex);
+
+private:
+    size_t setCount;
+    std::vector<unsigned> offsets; // Start of each row in `indices', followed by the total size.
+    std::vector<unsigned> indices;
+};
@@ -1,22 +1,110 @@
-
 #pragma once
 
 #include <glm/vec2.hpp> // glm::vec2
+#include <cstddef>      // size_t
+#include <stdexcept>    // std::out_of_range
+#include <type_traits>  // std::conditional, std::is_const
 
 class ParticleSet; // Forward declaration for mutual dependency
 
-// Represents one single particle and its physical properties.
-class Particle
+// Lightweight view of one single particle and its physical properties.
+// The properties are stored in the arrays of the particle set; the view only references them,
+// so copying a view does not copy the particle.
+// `Set' is either ParticleSet or const ParticleSet.
+template <typename Set>
+class BasicParticle
 {
+    template <typename T>
+    using Field = typename std::conditional<std::is_const<Set>::value, const T, T>::type;
+
 public:
-    Particle(const ParticleSet *set, const glm::vec2 &position, const float &density, const float &volume);
-    ~Particle();
+    BasicParticle(Set &set, size_t index);
     float mass() const;
     float volume() const;
-    const ParticleSet *set; // Set that contains this particle.
-    glm::vec2 position, velocity, acceleration, pressureAcceleration, viscosityAcceleration, otherAccelerations;
-    float density, pressure;
+    Field<glm::vec2> &position, &velocity, &acceleration, &pressureAcceleration, &viscosityAcceleration, &otherAccelerations;
+    Field<float> &density, &pressure;
+
+private:
+    Set *set; // Set that contains this particle.
+};
+
+using Particle = BasicParticle<ParticleSet>;
+using ConstParticle = BasicParticle<const ParticleSet>;
+
+// Iterates over the particles of a set, yielding particle views.
+template <typename Set>
+class ParticleIterator
+{
+public:
+    ParticleIterator(Set &set, size_t index) : set(&set), index(index) {}
+    BasicParticle<Set> operator*() const { return BasicParticle<Set>(*set, index); }
+    ParticleIterator &operator++()
+    {
+        ++index;
+        return *this;
+    }
+    bool operator==(const ParticleIterator &other) const { return index == other.index; }
+    bool operator!=(const ParticleIterator &other) const { return index != other.index; }
 
 private:
-    float volume_, mass_; // Immutable
-};
\ No newline at end of file
+    Set *set;
+    size_t index;
+};
+
+// Container-like access to the particles of a set, one view at a time.
+template <typename Set>
+class ParticleRange
+{
+public:
+    explicit ParticleRange(Set &set) : set(&set) {}
+    // Views are bound to their set: copying the range is handled by the set itself.
+    ParticleRange(const ParticleRange &) = delete;
+    ParticleRange &operator=(const ParticleRange &) = delete;
+    size_t size() const { return set->size(); }
+    bool empty() const { return set->size() == 0; }
+    BasicParticle<Set> operator[](size_t index) { return BasicParticle<Set>(*set, index); }
+    BasicParticle<const Set> operator[](size_t index) const { return BasicParticle<const Set>(*set, index); }
+    BasicParticle<Set> at(size_t index)
+    {
+        CheckIndex(index);
+        return (*this)[index];
+    }
+    BasicParticle<const Set> at(size_t index) const
+    {
+        CheckIndex(index);
+        return (*this)[index];
+    }
+    ParticleIterator<Set> begin() { return ParticleIterator<Set>(*set, 0); }
+    ParticleIterator<Set> end() { return ParticleIterator<Set>(*set, set->size()); }
+    ParticleIterator<const Set> begin() const { return ParticleIterator<const Set>(*set, 0); }
+    ParticleIterator<const Set> end() const { return ParticleIterator<const Set>(*set, set->size()); }
+
+private:
+    void CheckIndex(size_t index) const
+    {
+        if (index >= set->size())
+            throw std::out_of_range("particle index out of range");
+    }
+    Set *set;
+};
+
+template <typename Set>
+BasicParticle<Set>::BasicParticle(Set &set, size_t index)
+    : position(set.positions[index]), velocity(set.velocities[index]), acceleration(set.accelerations[index]),
+      pressureAcceleration(set.pressureAccelerations[index]), viscosityAcceleration(set.viscosityAccelerations[index]),
+      otherAccelerations(set.otherAccelerations[index]),
+      density(set.densities[index]), pressure(set.pressures[index]), set(&set)
+{
+}
+
+template <typename Set>
+float BasicParticle<Set>::mass() const
+{
+    return set->particleMass();
+}
+
+template <typename Set>
+float BasicParticle<Set>::volume() const
+{
+    return set->particleVolume();
+}
@@ -1,53 +1,138 @@
-
 #include "ParticleSet.hpp"
 
+#include <algorithm>    // std::min, std::max
+#include <cmath>        // std::lround
 #include <glm/vec2.hpp> // glm::vec2
 #include <iostream>     // std::cout
+#include <utility>      // std::move
+#include <vector>       // std::vector
 
 ParticleSet::ParticleSet(int xCount, int yCount, float spacing, float restDensity, float stiffness, float viscosity)
-    : particles(), spacing(spacing),
-      restDensity(restDensity), stiffness(stiffness), viscosity(viscosity),
-      isBoundary(false)
+    : ParticleSetData(), particles(*this)
 {
+    this->spacing = spacing;
+    this->restDensity = restDensity;
+    this->stiffness = stiffness;
+    this->viscosity = viscosity;
+    isBoundary = false;
     InitGrid(xCount, yCount, spacing);
 }
 
+// The particle views must stay bound to their own set, so only the data is copied or moved
+
+ParticleSet::ParticleSet(const ParticleSet &other)
+    : ParticleSetData(other), particles(*this)
+{
+}
+
+ParticleSet::ParticleSet(ParticleSet &&other)
+    : ParticleSetData(std::move(other)), particles(*this)
+{
+}
+
+ParticleSet &ParticleSet::operator=(const ParticleSet &other)
+{
+    ParticleSetData::operator=(other);
+    return *this;
+}
+
+ParticleSet &ParticleSet::operator=(ParticleSet &&other)
+{
+    ParticleSetData::operator=(std::move(other));
+    return *this;
+}
+
 ParticleSet::~ParticleSet()
 {
 }
 
+size_t ParticleSet::size() const
+{
+    return positions.size();
+}
+
+float ParticleSet::particleMass() const
+{
+    return mass_;
+}
+
+float ParticleSet::particleVolume() const
+{
+    return volume_;
+}
+
+void ParticleSet::InitHydrostatic(float gravity, bool compressible)
+{
+    if (positions.empty())
+    {
+        return;
+    }
+    float bottom = positions.front().y, top = bottom;
+    for (auto &&position : positions)
+    {
+        bottom = std::min(bottom, position.y);
+        top = std::max(top, position.y);
+    }
+    const size_t rowCount = std::lround((top - bottom) / spacing) + 1;
+    // Pressure and density of each row, from the top one (free surface, p = 0) down
+    std::vector<float> rowPressures(rowCount), rowDensities(rowCount), rowHeights(rowCount);
+    for (size_t r = 0; r < rowCount; r++)
+    {
+        rowPressures[r] = restDensity * gravity * spacing * (rowCount - 1 - r);
+        rowDensities[r] = compressible ? restDensity * (1.f + rowPressures[r] / stiffness) : restDensity;
+    }
+    // The spacing between two rows shrinks as their density grows, the horizontal spacing being fixed; the
+    // bottom row gets closer to the floor, one spacing below it
+    rowHeights[0] = bottom - spacing + spacing * restDensity / rowDensities[0];
+    for (size_t r = 1; r < rowCount; r++)
+    {
+        rowHeights[r] = rowHeights[r - 1] + spacing * 2.f * restDensity / (rowDensities[r - 1] + rowDensities[r]);
+    }
+    for (size_t i = 0; i < positions.size(); i++)
+    {
+        const size_t r = std::lround((positions[i].y - bottom) / spacing);
+        positions[i].y = rowHeights[r];
+        densities[i] = rowDensities[r];
+        pressures[i] = rowPressures[r];
+    }
+}
+
 void ParticleSet::TranslateAll(float offsetX, float offsetY)
 {
-    for (auto &&particle : particles)
+    for (auto &&position : positions)
     {
-        particle.position.x += offsetX;
-        particle.position.y += offsetY;
+        position.x += offsetX;
+        position.y += offsetY;
     }
 }
 
 void ParticleSet::PrintAllPositions()
 {
-    for (auto &&particle : this->particles)
+    for (auto &&position : positions)
     {
-        std::cout << particle.position.x << " " << particle.position.y << std::endl;
+        std::cout << position.x << " " << position.y << std::endl;
     }
 }
 
 void ParticleSet::InitGrid(int xCount, int yCount, float spacing)
 {
-    const float volume = spacing * spacing;
-    particles.clear();
-    particles.reserve(xCount * yCount);
+    volume_ = spacing * spacing;
+    mass_ = restDensity * volume_;
+    const size_t count = xCount * yCount;
+    positions.clear();
+    positions.reserve(count);
     for (size_t i = 0; i < xCount; i++)
     {
         for (size_t j = 0; j < yCount; j++)
         {
-            Particle part(
-                this,
-                glm::vec2(i * spacing, j * spacing),
-                restDensity,
-                volume);
-            particles.push_back(part);
+            positions.push_back(glm::vec2(i * spacing, j * spacing));
         }
     }
-}
\ No newline at end of file
+    velocities.assign(count, glm::vec2(0.f, 0.f));
+    accelerations.assign(count, glm::vec2(0.f, 0.f));
+    pressureAccelerations.assign(count, glm::vec2(0.f, 0.f));
+    viscosityAccelerations.assign(count, glm::vec2(0.f, 0.f));
+    otherAccelerations.assign(count, glm::vec2(0.f, 0.f));
+    densities.assign(count, restDensity);
+    pressures.assign(count, 0.f);
+}
@@ -1,24 +1,50 @@
-
 #pragma once
 
-#include "Particle.hpp" // Particle
+#include "Particle.hpp" // Particle, ParticleRange
+#include <glm/vec2.hpp> // glm::vec2
 #include <vector>       // std::vector
 
+// Data of a particle set, which can be copied member-wise.
+struct ParticleSetData
+{
+    // Per-particle quantities, one contiguous array per quantity (structure of arrays).
+    std::vector<glm::vec2> positions, velocities, accelerations, pressureAccelerations, viscosityAccelerations, otherAccelerations;
+    std::vector<float> densities, pressures;
+    // Properties that are uniform accross particles of the same body.
+    float spacing, restDensity, stiffness, viscosity;
+    bool isBoundary;
+
+protected:
+    float volume_, mass_; // Immutable
+};
+
 // Represents a set of particles.
 // For example, a fluid body or a boundary.
-class ParticleSet
+class ParticleSet : public ParticleSetData
 {
 public:
     ParticleSet(int xCount, int yCount, float spacing, float restDensity, float stiffness, float viscosity);
+    ParticleSet(const ParticleSet &other);
+    ParticleSet(ParticleSet &&other);
+    ParticleSet &operator=(const ParticleSet &other);
+    ParticleSet &operator=(ParticleSet &&other);
     ~ParticleSet();
+    // Number of particles in the set.
+    size_t size() const;
+    // Mass and volume, which are the same for all particles of the set.
+    float particleMass() const;
+    float particleVolume() const;
+    // Puts the grid of the constructor (possibly translated) at rest under a gravity of magnitude `gravity'
+    // along -y: each row gets the pressure of the weight of the rows above it, rho_0 g spacing per row, and,
+    // if `compressible', the rows move closer to each other and to the floor, one spacing below the bottom row,
+    // until their density rho_0 (1 + p / stiffness), from the state equation, gives that pressure.
+    void InitHydrostatic(float gravity, bool compressible);
     // Shift all particle positions by a horizontal and a vertical offset.
     void TranslateAll(float offsetX, float offsetY);
     // Print out all particle positions.
     void PrintAllPositions();
-    std::vector<Particle> particles;
-    // Properties that are uniform accross particles of the same body.
-    float spacing, restDensity, stiffness, viscosity;
-    bool isBoundary;
+    // Views of the particles, for code that handles one particle at a time.
+    ParticleRange<ParticleSet> particles;
 
 private:
     // Fill the set with particles whose positions form a regular grid.
@@ -1,5 +1,6 @@
 #include "ParticleSetModel.hpp"
 
+#include "PhaseTimer.hpp"     // MYSOLVER_TIME_PHASE
 #include "helpers/RootDir.h" // ROOT_DIR
 
 ParticleSetModel::ParticleSetModel(const ParticleSet &particleSet)
@@ -13,9 +14,13 @@ ParticleSetModel::ParticleSetModel(const ParticleSet &particleSet)
 
 void ParticleSetModel::Update()
 {
-    // Get vertex data
-    UpdateVertexData();
+    {
+        MYSOLVER_TIME_PHASE(Phase::VertexData);
+        // Get vertex data
+        UpdateVertexData();
+    }
     // Copy vertex data to GPU
+    MYSOLVER_TIME_PHASE(Phase::Upload);
     SetVertexData(vertexData);
 }
 
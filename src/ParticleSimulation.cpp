@@ -1,169 +1,876 @@
 #include "ParticleSimulation.hpp"
 
 #include <glm/geometric.hpp>
-#include "Kernel.hpp"
+#include "KernelFunctions.hpp"
+#include "PhaseTimer.hpp"
+#include "ThreadPool.hpp"
 
-#include <iostream> // DEBUG
+#include <algorithm> // std::fill, std::lower_bound, std::upper_bound
+#include <limits>    // std::numeric_limits
+#include <iostream>  // DEBUG
+
+ParticleSimulation::ParticleSimulation()
+    : verletSkin(0.f), neighborRadius(0.f), neighborsValid(false),
+      neighborUpdateCount(0), neighborRebuildCount(0),
+      threadPool(new ThreadPool(1)),
+      pairwiseForces(false), kernelType(KernelType::CubicSpline),
+      kernelTableResolution(0), kernelInterpolation(KernelInterpolation::Linear),
+      simdLevel(SimdLevel::Scalar),
+      pressureSolver(PressureSolver::StateEquation), pressureTolerance(1e-3f), maxPressureIterations(100),
+      pressureRelaxation(.5f), pressureIterations(0), densityIterations(0), densityError(0.f)
+{
+}
+
+ParticleSimulation::~ParticleSimulation()
+{
+}
+
+void ParticleSimulation::SetThreadCount(unsigned threadCount)
+{
+    threadCount = threadCount > 0 ? threadCount : 1;
+    if (threadCount != threadPool->ThreadCount())
+    {
+        threadPool.reset(new ThreadPool(threadCount));
+    }
+}
+
+unsigned ParticleSimulation::GetThreadCount() const
+{
+    return threadPool->ThreadCount();
+}
+
+void ParticleSimulation::SetVerletSkin(float skin)
+{
+    verletSkin = glm::max(skin, 0.f);
+    neighborsValid = false;
+}
+
+float ParticleSimulation::GetVerletSkin() const
+{
+    return verletSkin;
+}
+
+void ParticleSimulation::SetPairwiseForces(bool pairwise)
+{
+    pairwiseForces = pairwise;
+}
+
+bool ParticleSimulation::GetPairwiseForces() const
+{
+    return pairwiseForces;
+}
+
+void ParticleSimulation::SetKernel(KernelType type)
+{
+    kernelType = type;
+}
+
+KernelType ParticleSimulation::GetKernel() const
+{
+    return kernelType;
+}
+
+void ParticleSimulation::SetKernelTable(unsigned resolution, KernelInterpolation interpolation)
+{
+    kernelTableResolution = resolution;
+    kernelInterpolation = interpolation;
+}
+
+unsigned ParticleSimulation::GetKernelTableResolution() const
+{
+    return kernelTableResolution;
+}
+
+KernelInterpolation ParticleSimulation::GetKernelInterpolation() const
+{
+    return kernelInterpolation;
+}
+
+void ParticleSimulation::SetSimdLevel(SimdLevel level)
+{
+    simdLevel = std::min(level, KernelBatch::DetectedLevel());
+}
+
+SimdLevel ParticleSimulation::GetSimdLevel() const
+{
+    return simdLevel;
+}
+
+unsigned long ParticleSimulation::GetNeighborUpdateCount() const
+{
+    return neighborUpdateCount;
+}
+
+unsigned long ParticleSimulation::GetNeighborRebuildCount() const
+{
+    return neighborRebuildCount;
+}
 
 void ParticleSimulation::AddParticleSet(ParticleSet &particleSet)
 {
     particleSets.push_back(&particleSet);
+    neighborsValid = false;
+    staticBoundary.Clear();
+}
+
+void ParticleSimulation::FreezeBoundaries(float radius)
+{
+    staticBoundary.Build(particleSets, radius, threadPool.get());
+    neighborsValid = false;
+}
+
+const StaticBoundary &ParticleSimulation::GetStaticBoundary() const
+{
+    return staticBoundary;
+}
+
+void ParticleSimulation::SetBoundaryField(const BoundaryField &field)
+{
+    boundaryField = field;
+}
+
+const BoundaryField &ParticleSimulation::GetBoundaryField() const
+{
+    return boundaryField;
 }
 
 void ParticleSimulation::Clear()
 {
     particleSets.clear();
-    neighbors.clear();
-    boundaryNeighbors.clear();
+    grids.clear();
+    neighborTables.clear();
+    referencePositions.clear();
+    staticBoundary.Clear();
+    boundaryField.Clear();
+    neighborsValid = false;
+    neighborUpdateCount = 0;
+    neighborRebuildCount = 0;
 }
 
 void ParticleSimulation::UpdateNeighbors(const float kernelSupport)
 {
-    for (auto &&particleSet : particleSets)
+    MYSOLVER_TIME_PHASE(Phase::NeighborSearch);
+    neighborUpdateCount++;
+    // Verlet lists: the neighbors found within `kernelSupport + verletSkin' remain a superset of the
+    // actual neighbors as long as no particle has moved by more than half the skin since the last rebuild.
+    const float radius = kernelSupport + verletSkin;
+    if (verletSkin > 0.f && neighborsValid && radius == neighborRadius && MaxDisplacement() <= .5f * verletSkin)
+    {
+        return;
+    }
+    neighborRebuildCount++;
+    neighborRadius = radius;
+    neighborsValid = true;
+    if (!staticBoundary.Covers(radius))
+    {
+        staticBoundary.Build(particleSets, radius, threadPool.get());
+    }
+    // Boundaries do not move
+    if (verletSkin > 0.f)
     {
-        for (auto &&particle : particleSet->particles)
+        referencePositions.resize(particleSets.size());
+        for (size_t s = 0; s < particleSets.size(); s++)
         {
-            neighbors[&particle] = std::vector<const Particle *>();
-            boundaryNeighbors[&particle] = std::vector<const Particle *>();
-            for (auto &&otherParticleSet : particleSets)
+            if (!particleSets[s]->isBoundary)
             {
-                auto neighborMap = &neighbors;
-                if (particleSet->isBoundary)
-                {
-                    neighborMap = &boundaryNeighbors;
-                }
-                for (auto &&otherParticle : otherParticleSet->particles)
-                {
-                    if (glm::distance(particle.position, otherParticle.position) < kernelSupport)
-                    {
-                        neighborMap->at(&particle).push_back(&otherParticle);
-                    }
-                }
+                referencePositions[s] = particleSets[s]->positions;
+            }
+        }
+    }
+
+    // Sort the particles of each fluid set into a grid whose cells are as large as the search radius
+    grids.resize(particleSets.size());
+    for (size_t s = 0; s < particleSets.size(); s++)
+    {
+        if (!particleSets[s]->isBoundary)
+        {
+            const auto &positions = particleSets[s]->positions;
+            grids[s].Build(positions.data(), positions.size(), radius, threadPool.get());
+        }
+    }
+    // Only look for neighbors in the cells around each fluid particle
+    neighborTables.resize(particleSets.size());
+    const unsigned threadCount = threadPool->ThreadCount();
+    for (size_t q = 0; q < particleSets.size(); q++)
+    {
+        NeighborTable &table = neighborTables[q];
+        if (particleSets[q]->isBoundary)
+        {
+            table.Reset(particleSets.size());
+            continue;
+        }
+        if (threadCount == 1)
+        {
+            table.Reset(particleSets.size());
+            FindNeighbors(q, 0, particleSets[q]->size(), radius, table);
+            continue;
+        }
+        // Each thread fills a partial table for its chunk of particles, then the parts are concatenated
+        partialTables.resize(threadCount);
+        for (auto &&part : partialTables)
+        {
+            part.Reset(particleSets.size());
+        }
+        threadPool->ParallelFor(particleSets[q]->size(), [&](size_t begin, size_t end, unsigned t) {
+            FindNeighbors(q, begin, end, radius, partialTables[t]);
+        });
+        std::vector<size_t> firstRows(threadCount + 1, 0), firstIndices(threadCount + 1, 0);
+        for (unsigned t = 0; t < threadCount; t++)
+        {
+            firstRows[t + 1] = firstRows[t] + partialTables[t].RowCount();
+            firstIndices[t + 1] = firstIndices[t] + partialTables[t].Size();
+        }
+        table.Resize(particleSets.size(), firstRows[threadCount], firstIndices[threadCount]);
+        threadPool->ParallelFor(threadCount, [&](size_t begin, size_t end, unsigned) {
+            for (size_t t = begin; t < end; t++)
+            {
+                table.CopyRows(partialTables[t], firstRows[t], firstIndices[t]);
+            }
+        });
+    }
+}
+
+void ParticleSimulation::FindNeighbors(size_t setIndex, size_t begin, size_t end, float radius, NeighborTable &table) const
+{
+    const auto &positions = particleSets[setIndex]->positions;
+    for (size_t i = begin; i < end; i++)
+    {
+        for (size_t s = 0; s < particleSets.size(); s++)
+        {
+            const NeighborGrid &grid = particleSets[s]->isBoundary ? staticBoundary.Grid(s) : grids[s];
+            grid.ForEachNeighbor(positions[i], radius, [&table](unsigned j) {
+                table.Add(j);
+            });
+            table.EndRow();
+        }
+    }
+}
+
+float ParticleSimulation::MaxDisplacement() const
+{
+    float maxDisplacement2 = 0.f;
+    threadMaxima.resize(threadPool->ThreadCount());
+    for (size_t s = 0; s < particleSets.size(); s++)
+    {
+        if (particleSets[s]->isBoundary)
+        {
+            continue;
+        }
+        const std::vector<glm::vec2> &positions = particleSets[s]->positions;
+        const std::vector<glm::vec2> &reference = referencePositions[s];
+        std::fill(threadMaxima.begin(), threadMaxima.end(), 0.f);
+        threadPool->ParallelFor(positions.size(), [&](size_t begin, size_t end, unsigned t) {
+            float threadMax = 0.f;
+            for (size_t i = begin; i < end; i++)
+            {
+                const glm::vec2 displacement = positions[i] - reference[i];
+                threadMax = glm::max(threadMax, glm::dot(displacement, displacement));
             }
+            threadMaxima[t] = threadMax;
+        });
+        for (auto &&threadMax : threadMaxima)
+        {
+            maxDisplacement2 = glm::max(maxDisplacement2, threadMax);
         }
     }
+    return glm::sqrt(maxDisplacement2);
 }
 
-const std::vector<const Particle *> &ParticleSimulation::GetNeighbors(const Particle &particle) const
+const NeighborTable &ParticleSimulation::GetNeighborTable(size_t setIndex) const
 {
-    return neighbors.at(&particle);
+    return neighborTables.at(setIndex);
+}
+
+ParticleSimulation::NeighborState ParticleSimulation::GetNeighborState() const
+{
+    NeighborState state;
+    if (neighborsValid)
+    {
+        state.radius = neighborRadius;
+        state.tables = neighborTables;
+        state.referencePositions = referencePositions;
+    }
+    return state;
 }
 
-const std::vector<const Particle *> &ParticleSimulation::GetBoundaryNeighbors(const Particle &particle) const
+void ParticleSimulation::SetNeighborState(const NeighborState &state)
 {
-    return boundaryNeighbors.at(&particle);
+    bool matches = state.radius > 0.f && state.tables.size() == particleSets.size() &&
+                   (state.referencePositions.empty() || state.referencePositions.size() == particleSets.size());
+    for (size_t s = 0; matches && s < particleSets.size(); s++)
+    {
+        const size_t rowCount = particleSets[s]->isBoundary ? 0 : particleSets[s]->size() * particleSets.size();
+        matches = state.tables[s].RowCount() == rowCount &&
+                  (state.referencePositions.empty() || particleSets[s]->isBoundary ||
+                   state.referencePositions[s].size() == particleSets[s]->size());
+    }
+    if (!matches)
+    {
+        // Not the tables of these sets: UpdateNeighbors searches again
+        neighborsValid = false;
+        return;
+    }
+    neighborRadius = state.radius;
+    neighborTables = state.tables;
+    referencePositions = state.referencePositions;
+    neighborsValid = true;
+    if (!staticBoundary.Covers(neighborRadius))
+    {
+        staticBoundary.Build(particleSets, neighborRadius, threadPool.get());
+    }
 }
 
 void ParticleSimulation::UpdateParticleQuantities(const glm::vec2 gravity) const
 {
-    for (auto &&particleSet : particleSets)
+    staticBoundary.UpdateVolumes(kernelType, threadPool.get());
+    for (size_t q = 0; q < particleSets.size(); q++)
     {
-        if (!particleSet->isBoundary)
+        if (!particleSets[q]->isBoundary)
         {
-            Kernel kernel(particleSet->spacing);
-            // Compute density and pressure for each particle
-            for (auto &&particle : particleSet->particles)
+            boundaryField.Update(kernelType, particleSets[q]->spacing, threadPool.get());
+        }
+        if (!particleSets[q]->isBoundary && pressureSolver != PressureSolver::StateEquation)
+        {
+            UpdateNonPressureQuantities(q, gravity);
+        }
+        else if (!particleSets[q]->isBoundary)
+        {
+            // Instantiates the loops for each kernel, so that kernel evaluations are inlined
+            const auto update = [&](const auto &kernel) {
+                if (pairwiseForces)
+                {
+                    UpdateQuantitiesPairwise(q, gravity, kernel);
+                }
+                else
+                {
+                    UpdateQuantitiesPerParticle(q, gravity, kernel);
+                }
+            };
+            const float h = particleSets[q]->spacing;
+            if (kernelTableResolution > 0)
             {
-                particle.density = 0.f;
-                for (auto &&neighbor : GetNeighbors(particle))
+                kernelTables.resize(particleSets.size());
+                KernelTable &table = kernelTables[q];
+                if (table.Type() != kernelType || table.SmoothingLength() != h || table.Resolution() != kernelTableResolution)
                 {
-                    particle.density += kernel.Function(particle.position, neighbor->position);
+                    table.Build<2>(kernelType, h, kernelTableResolution);
                 }
-                for (auto &&neighbor : GetBoundaryNeighbors(particle))
+                if (kernelInterpolation == KernelInterpolation::Linear)
                 {
-                    particle.density += kernel.Function(particle.position, neighbor->position);
+                    update(TabulatedKernel<2, KernelInterpolation::Linear>(table));
                 }
-                particle.density *= particle.mass();
-                particle.pressure = glm::max(particleSet->stiffness * (particle.density / particleSet->restDensity - 1.f), 0.f);
+                else
+                {
+                    update(TabulatedKernel<2, KernelInterpolation::Cubic>(table));
+                }
+            }
+            else if (simdLevel != SimdLevel::Scalar && kernelType == KernelType::CubicSpline)
+            {
+                update(BatchedCubicSplineKernel(h, simdLevel));
+            }
+            else
+            {
+                DispatchKernel<2>(kernelType, h, update);
             }
+        }
+    }
+}
 
-            // Compute accelerations for each particle
-            for (auto &&particle : particleSet->particles)
+namespace
+{
+    // Adds W(position - x_j) to `sum' for each neighbor j of a row, in the order of the row.
+    template <typename KernelFunction>
+    void AccumulateKernel(const KernelFunction &kernel, const glm::vec2 &position, const std::vector<glm::vec2> &positions,
+                          const NeighborTable::Range &neighbors, KernelBatchScratch &, float &sum)
+    {
+        for (unsigned j : neighbors)
+        {
+            sum += kernel.Function(position, positions[j]);
+        }
+    }
+
+    // Adds volumes[j] * W(position - x_j) to `sum' for each neighbor j of a row of boundary particles.
+    template <typename KernelFunction>
+    void AccumulateVolumes(const KernelFunction &kernel, const glm::vec2 &position, const std::vector<glm::vec2> &positions,
+                           const std::vector<float> &volumes, const NeighborTable::Range &neighbors, KernelBatchScratch &, float &sum)
+    {
+        for (unsigned j : neighbors)
+        {
+            sum += volumes[j] * kernel.Function(position, positions[j]);
+        }
+    }
+
+    // Copies the positions of the neighbors of a row into the x and y arrays of `scratch'.
+    void GatherPositions(const std::vector<glm::vec2> &positions, const NeighborTable::Range &neighbors, KernelBatchScratch &scratch)
+    {
+        scratch.Reserve(neighbors.size());
+        size_t k = 0;
+        for (unsigned j : neighbors)
+        {
+            scratch.x[k] = positions[j].x;
+            scratch.y[k] = positions[j].y;
+            k++;
+        }
+    }
+
+    void AccumulateKernel(const BatchedCubicSplineKernel &kernel, const glm::vec2 &position, const std::vector<glm::vec2> &positions,
+                          const NeighborTable::Range &neighbors, KernelBatchScratch &scratch, float &sum)
+    {
+        GatherPositions(positions, neighbors, scratch);
+        kernel.batch.Function(position.x, position.y, scratch.x.data(), scratch.y.data(), neighbors.size(), scratch.values.data());
+        for (size_t k = 0; k < neighbors.size(); k++)
+        {
+            sum += scratch.values[k];
+        }
+    }
+
+    void AccumulateVolumes(const BatchedCubicSplineKernel &kernel, const glm::vec2 &position, const std::vector<glm::vec2> &positions,
+                           const std::vector<float> &volumes, const NeighborTable::Range &neighbors, KernelBatchScratch &scratch, float &sum)
+    {
+        GatherPositions(positions, neighbors, scratch);
+        kernel.batch.Function(position.x, position.y, scratch.x.data(), scratch.y.data(), neighbors.size(), scratch.values.data());
+        size_t k = 0;
+        for (unsigned j : neighbors)
+        {
+            sum += volumes[j] * scratch.values[k++];
+        }
+    }
+
+    // Stores grad W(position - x_j) of the k-th neighbor j of a row in scratch.gradientX[k] and scratch.gradientY[k].
+    template <typename KernelFunction>
+    void KernelGradients(const KernelFunction &kernel, const glm::vec2 &position, const std::vector<glm::vec2> &positions,
+                         const NeighborTable::Range &neighbors, KernelBatchScratch &scratch)
+    {
+        scratch.Reserve(neighbors.size());
+        size_t k = 0;
+        for (unsigned j : neighbors)
+        {
+            const glm::vec2 gradient = kernel.Derivative(position, positions[j]);
+            scratch.gradientX[k] = gradient.x;
+            scratch.gradientY[k] = gradient.y;
+            k++;
+        }
+    }
+
+    void KernelGradients(const BatchedCubicSplineKernel &kernel, const glm::vec2 &position, const std::vector<glm::vec2> &positions,
+                         const NeighborTable::Range &neighbors, KernelBatchScratch &scratch)
+    {
+        GatherPositions(positions, neighbors, scratch);
+        kernel.batch.Derivative(position.x, position.y, scratch.x.data(), scratch.y.data(), neighbors.size(),
+                                scratch.gradientX.data(), scratch.gradientY.data());
+    }
+} // namespace
+
+template <typename KernelFunction>
+void ParticleSimulation::UpdateQuantitiesPerParticle(size_t q, const glm::vec2 gravity, const KernelFunction &kernel) const
+{
+    ParticleSet *particleSet = particleSets[q];
+    const NeighborTable &table = neighborTables[q];
+    const std::vector<glm::vec2> &positions = particleSet->positions;
+    const std::vector<glm::vec2> &velocities = particleSet->velocities;
+    std::vector<float> &densities = particleSet->densities;
+    std::vector<float> &pressures = particleSet->pressures;
+    const float mass = particleSet->particleMass();
+    const bool hasField = !boundaryField.Empty();
+    {
+        MYSOLVER_TIME_PHASE(Phase::DensityPressure);
+        // Compute density and pressure for each particle
+        threadScratch.resize(threadPool->ThreadCount());
+        threadPool->ParallelFor(particleSet->size(), [&](size_t begin, size_t end, unsigned t) {
+            for (size_t i = begin; i < end; i++)
             {
-                // Viscosity acceleration
-                glm::vec2 fluidViscosityAcceleration(0.f, 0.f);
-                for (auto &&neighbor : GetNeighbors(particle))
+                float density = 0.f;
+                // Boundary particles contribute as fluid of their own volume
+                float boundaryVolume = 0.f;
+                for (size_t s = 0; s < particleSets.size(); s++)
                 {
-                    glm::vec2 positionDiff = particle.position - neighbor->position;
-                    glm::vec2 velocityDiff = particle.velocity - neighbor->velocity;
-                    glm::vec2 kernelDer = kernel.Derivative(particle.position, neighbor->position);
-                    fluidViscosityAcceleration +=
-                        kernelDer *
-                        neighbor->volume() *
-                        (glm::dot(velocityDiff, positionDiff)) /
-                        (glm::dot(positionDiff, positionDiff) + 0.01f * particleSet->spacing * particleSet->spacing);
+                    const std::vector<glm::vec2> &otherPositions = particleSets[s]->positions;
+                    if (!particleSets[s]->isBoundary)
+                    {
+                        AccumulateKernel(kernel, positions[i], otherPositions, table.Neighbors(i, s), threadScratch[t], density);
+                    }
+                    else
+                    {
+                        AccumulateVolumes(kernel, positions[i], otherPositions, staticBoundary.Volumes(s), table.Neighbors(i, s), threadScratch[t], boundaryVolume);
+                    }
                 }
-                fluidViscosityAcceleration *= 2.f;
-                fluidViscosityAcceleration *= particleSet->viscosity;
-                glm::vec2 staticViscosityAcceleration(0.f, 0.f);
-                for (auto &&neighbor : GetBoundaryNeighbors(particle))
+                if (hasField)
                 {
-                    glm::vec2 positionDiff = particle.position - neighbor->position;
-                    glm::vec2 velocityDiff = particle.velocity - neighbor->velocity;
-                    glm::vec2 kernelDer = kernel.Derivative(particle.position, neighbor->position);
-                    staticViscosityAcceleration +=
-                        neighbor->set->viscosity *
-                        kernelDer *
-                        neighbor->volume() *
-                        (glm::dot(velocityDiff, positionDiff)) /
-                        (glm::dot(positionDiff, positionDiff) + 0.01f * particleSet->spacing * particleSet->spacing);
+                    boundaryVolume += boundaryField.Volume(positions[i]);
                 }
-                staticViscosityAcceleration *= 2.f;
-                glm::vec2 viscosityAcceleration = fluidViscosityAcceleration + staticViscosityAcceleration;
-                // Pressure acceleration from fluid particles
-                glm::vec2 fluidPressureAcceleration(0.f, 0.f);
-                for (auto &&neighbor : GetNeighbors(particle))
+                densities[i] = density * mass + boundaryVolume * particleSet->restDensity;
+                pressures[i] = glm::max(particleSet->stiffness * (densities[i] / particleSet->restDensity - 1.f), 0.f);
+            }
+        });
+    }
+
+    // Compute accelerations for each particle
+    MYSOLVER_TIME_PHASE(Phase::Forces);
+    const float viscosityEpsilon = 0.01f * particleSet->spacing * particleSet->spacing;
+    threadPool->ParallelFor(particleSet->size(), [&](size_t begin, size_t end, unsigned t) {
+        const std::vector<float> &gradientX = threadScratch[t].gradientX;
+        const std::vector<float> &gradientY = threadScratch[t].gradientY;
+        for (size_t i = begin; i < end; i++)
+        {
+            const float pressureOverDensity2 = pressures[i] / (densities[i] * densities[i]);
+            glm::vec2 fluidViscosityAcceleration(0.f, 0.f);
+            glm::vec2 staticViscosityAcceleration(0.f, 0.f);
+            glm::vec2 fluidPressureAcceleration(0.f, 0.f);
+            glm::vec2 boundaryPressureAcceleration(0.f, 0.f);
+            for (size_t s = 0; s < particleSets.size(); s++)
+            {
+                const ParticleSet *otherSet = particleSets[s];
+                const std::vector<glm::vec2> &otherPositions = otherSet->positions;
+                const std::vector<glm::vec2> &otherVelocities = otherSet->velocities;
+                const NeighborTable::Range neighbors = table.Neighbors(i, s);
+                // The kernel gradient of each neighbor, shared by viscosity and pressure
+                KernelGradients(kernel, positions[i], otherPositions, neighbors, threadScratch[t]);
+                size_t k = 0;
+                if (!otherSet->isBoundary)
                 {
-                    fluidPressureAcceleration += (particle.pressure / (particle.density * particle.density) + neighbor->pressure / (neighbor->density * neighbor->density)) * kernel.Derivative(particle.position, neighbor->position);
+                    // Viscosity acceleration from fluid particles
+                    for (unsigned j : neighbors)
+                    {
+                        glm::vec2 positionDiff = positions[i] - otherPositions[j];
+                        glm::vec2 velocityDiff = velocities[i] - otherVelocities[j];
+                        glm::vec2 kernelDer(gradientX[k], gradientY[k]);
+                        k++;
+                        fluidViscosityAcceleration +=
+                            kernelDer *
+                            otherSet->particleVolume() *
+                            (glm::dot(velocityDiff, positionDiff)) /
+                            (glm::dot(positionDiff, positionDiff) + viscosityEpsilon);
+                    }
+                    // Pressure acceleration from fluid particles
+                    const std::vector<float> &otherDensities = otherSet->densities;
+                    const std::vector<float> &otherPressures = otherSet->pressures;
+                    k = 0;
+                    for (unsigned j : neighbors)
+                    {
+                        fluidPressureAcceleration += (pressureOverDensity2 + otherPressures[j] / (otherDensities[j] * otherDensities[j])) * glm::vec2(gradientX[k], gradientY[k]);
+                        k++;
+                    }
                 }
-                // fluidPressureAcceleration *= -particle.mass;
-                // Pressure acceleration from (static) boundary particles
-                glm::vec2 boundaryPressureAcceleration(0.f, 0.f);
-                for (auto &&boundaryNeighbor : GetBoundaryNeighbors(particle))
+                else
                 {
-                    boundaryPressureAcceleration += kernel.Derivative(particle.position, boundaryNeighbor->position);
+                    // Viscosity acceleration from (static) boundary particles
+                    const std::vector<float> &volumes = staticBoundary.Volumes(s);
+                    for (unsigned j : neighbors)
+                    {
+                        glm::vec2 positionDiff = positions[i] - otherPositions[j];
+                        glm::vec2 velocityDiff = velocities[i] - otherVelocities[j];
+                        glm::vec2 kernelDer(gradientX[k], gradientY[k]);
+                        k++;
+                        staticViscosityAcceleration +=
+                            otherSet->viscosity *
+                            kernelDer *
+                            volumes[j] *
+                            (glm::dot(velocityDiff, positionDiff)) /
+                            (glm::dot(positionDiff, positionDiff) + viscosityEpsilon);
+                    }
+                    // Pressure acceleration from (static) boundary particles
+                    k = 0;
+                    for (unsigned j : neighbors)
+                    {
+                        boundaryPressureAcceleration += volumes[j] * glm::vec2(gradientX[k], gradientY[k]);
+                        k++;
+                    }
                 }
-                boundaryPressureAcceleration *= particle.pressure *
-                                                (1.f / (particle.density * particle.density) +
-                                                 1.f / (particleSet->restDensity * particleSet->restDensity));
-                // Total pressure acceleration
-                glm::vec2 pressureAcceleration = -particle.mass() * (fluidPressureAcceleration + boundaryPressureAcceleration);
-                // Other accelerations
-                glm::vec2 otherAccelerations = gravity;
-                // Total acceleration
-                particle.pressureAcceleration = pressureAcceleration;
-                particle.viscosityAcceleration = viscosityAcceleration;
-                particle.otherAccelerations = otherAccelerations;
-                particle.acceleration = viscosityAcceleration + pressureAcceleration + otherAccelerations;
             }
+            if (hasField)
+            {
+                // Viscosity and pressure accelerations from the boundary field
+                const BoundaryField::Sample sample = boundaryField.Lookup(positions[i]);
+                staticViscosityAcceleration += boundaryField.viscosity * (sample.viscosity * velocities[i]);
+                boundaryPressureAcceleration += sample.gradient;
+            }
+            fluidViscosityAcceleration *= 2.f;
+            fluidViscosityAcceleration *= particleSet->viscosity;
+            staticViscosityAcceleration *= 2.f;
+            glm::vec2 viscosityAcceleration = fluidViscosityAcceleration + staticViscosityAcceleration;
+            boundaryPressureAcceleration *= pressures[i] *
+                                            (1.f / (densities[i] * densities[i]) +
+                                             1.f / (particleSet->restDensity * particleSet->restDensity));
+            // Total pressure acceleration, the boundary particles having the mass of the fluid they replace
+            glm::vec2 pressureAcceleration = -(mass * fluidPressureAcceleration + particleSet->restDensity * boundaryPressureAcceleration);
+            // Other accelerations
+            glm::vec2 otherAccelerations = gravity;
+            // Total acceleration
+            particleSet->pressureAccelerations[i] = pressureAcceleration;
+            particleSet->viscosityAccelerations[i] = viscosityAcceleration;
+            particleSet->otherAccelerations[i] = otherAccelerations;
+            particleSet->accelerations[i] = viscosityAcceleration + pressureAcceleration + otherAccelerations;
         }
+    });
+}
+
+template <typename KernelFunction>
+void ParticleSimulation::UpdateQuantitiesPairwise(size_t q, const glm::vec2 gravity, const KernelFunction &kernel) const
+{
+    ParticleSet *particleSet = particleSets[q];
+    const NeighborTable &table = neighborTables[q];
+    const std::vector<glm::vec2> &positions = particleSet->positions;
+    const std::vector<glm::vec2> &velocities = particleSet->velocities;
+    std::vector<float> &densities = particleSet->densities;
+    std::vector<float> &pressures = particleSet->pressures;
+    const size_t count = particleSet->size();
+    const float mass = particleSet->particleMass();
+    const float volume = particleSet->particleVolume();
+    const bool hasField = !boundaryField.Empty();
+    const unsigned threadCount = threadPool->ThreadCount();
+    threadDensities.resize(threadCount);
+    threadViscosities.resize(threadCount);
+    threadPressures.resize(threadCount);
+    // Threads without a chunk (fewer particles than threads) keep an empty range
+    threadRanges.assign(threadCount, std::make_pair(size_t(0), size_t(0)));
+
+    // Pairs (i, j) of the set with j > i are visited once, and their contribution is added to both
+    // particles. Since j may belong to the chunk of another thread, each thread accumulates into its
+    // own buffer and the buffers are summed afterwards (in a fixed order, so that results only depend
+    // on the number of threads). A buffer only covers the chunk of its thread and the particles after
+    // it that are paired with the chunk: the rows are sorted, so that is up to the largest last
+    // neighbor of the chunk. Neighbors have close indices in sets created as grids, so the buffers
+    // overlap by a few rows of particles instead of each spanning the whole set.
+    const auto reserveRange = [&](size_t begin, size_t end, unsigned t) {
+        size_t rangeEnd = end;
+        for (size_t i = begin; i < end; i++)
+        {
+            const NeighborTable::Range neighbors = table.Neighbors(i, q);
+            if (neighbors.size() > 0)
+            {
+                rangeEnd = std::max(rangeEnd, static_cast<size_t>(neighbors.end()[-1]) + 1);
+            }
+        }
+        threadRanges[t] = std::make_pair(begin, rangeEnd);
+        return rangeEnd - begin;
+    };
+    {
+        MYSOLVER_TIME_PHASE(Phase::DensityPressure);
+        threadPool->ParallelFor(count, [&](size_t begin, size_t end, unsigned t) {
+            std::vector<float> &buffer = threadDensities[t];
+            buffer.assign(reserveRange(begin, end, t), 0.f);
+            for (size_t i = begin; i < end; i++)
+            {
+                const NeighborTable::Range neighbors = table.Neighbors(i, q);
+                // Rows are sorted: the particle itself comes right before its pairs
+                for (const unsigned *j = std::lower_bound(neighbors.begin(), neighbors.end(), i); j != neighbors.end(); ++j)
+                {
+                    const float w = kernel.Function(positions[i], positions[*j]);
+                    buffer[i - begin] += w;
+                    if (*j != i)
+                    {
+                        buffer[*j - begin] += w;
+                    }
+                }
+            }
+        });
+        threadPool->ParallelFor(count, [&](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; i++)
+            {
+                float density = 0.f;
+                for (unsigned t = 0; t < threadCount; t++)
+                {
+                    if (i >= threadRanges[t].first && i < threadRanges[t].second)
+                    {
+                        density += threadDensities[t][i - threadRanges[t].first];
+                    }
+                }
+                // Other sets (boundaries) contribute to this particle only
+                float boundaryVolume = 0.f;
+                for (size_t s = 0; s < particleSets.size(); s++)
+                {
+                    if (s == q)
+                    {
+                        continue;
+                    }
+                    const std::vector<glm::vec2> &otherPositions = particleSets[s]->positions;
+                    if (!particleSets[s]->isBoundary)
+                    {
+                        for (unsigned j : table.Neighbors(i, s))
+                        {
+                            density += kernel.Function(positions[i], otherPositions[j]);
+                        }
+                    }
+                    else
+                    {
+                        const std::vector<float> &volumes = staticBoundary.Volumes(s);
+                        for (unsigned j : table.Neighbors(i, s))
+                        {
+                            boundaryVolume += volumes[j] * kernel.Function(positions[i], otherPositions[j]);
+                        }
+                    }
+                }
+                if (hasField)
+                {
+                    boundaryVolume += boundaryField.Volume(positions[i]);
+                }
+                densities[i] = density * mass + boundaryVolume * particleSet->restDensity;
+                pressures[i] = glm::max(particleSet->stiffness * (densities[i] / particleSet->restDensity - 1.f), 0.f);
+            }
+        });
     }
+
+    // Viscosity and pressure terms of the pairs of the set, both antisymmetric in (i, j)
+    const float viscosityEpsilon = 0.01f * particleSet->spacing * particleSet->spacing;
+    {
+        MYSOLVER_TIME_PHASE(Phase::PairwiseForces);
+        threadPool->ParallelFor(count, [&](size_t begin, size_t end, unsigned t) {
+            std::vector<glm::vec2> &viscosityBuffer = threadViscosities[t];
+            std::vector<glm::vec2> &pressureBuffer = threadPressures[t];
+            const size_t rangeSize = reserveRange(begin, end, t);
+            viscosityBuffer.assign(rangeSize, glm::vec2(0.f, 0.f));
+            pressureBuffer.assign(rangeSize, glm::vec2(0.f, 0.f));
+            for (size_t i = begin; i < end; i++)
+            {
+                const float pressureOverDensity2 = pressures[i] / (densities[i] * densities[i]);
+                const NeighborTable::Range neighbors = table.Neighbors(i, q);
+                for (const unsigned *j = std::upper_bound(neighbors.begin(), neighbors.end(), i); j != neighbors.end(); ++j)
+                {
+                    const glm::vec2 positionDiff = positions[i] - positions[*j];
+                    const glm::vec2 velocityDiff = velocities[i] - velocities[*j];
+                    const glm::vec2 kernelDer = kernel.Derivative(positions[i], positions[*j]);
+                    const glm::vec2 viscosityTerm = kernelDer * volume *
+                                                    (glm::dot(velocityDiff, positionDiff)) /
+                                                    (glm::dot(positionDiff, positionDiff) + viscosityEpsilon);
+                    const glm::vec2 pressureTerm = (pressureOverDensity2 + pressures[*j] / (densities[*j] * densities[*j])) * kernelDer;
+                    viscosityBuffer[i - begin] += viscosityTerm;
+                    viscosityBuffer[*j - begin] -= viscosityTerm;
+                    pressureBuffer[i - begin] += pressureTerm;
+                    pressureBuffer[*j - begin] -= pressureTerm;
+                }
+            }
+        });
+    }
+
+    // Sum the buffers, add the contributions of the other sets and compute the accelerations
+    MYSOLVER_TIME_PHASE(Phase::Forces);
+    threadPool->ParallelFor(count, [&](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i < end; i++)
+        {
+            const float pressureOverDensity2 = pressures[i] / (densities[i] * densities[i]);
+            glm::vec2 fluidViscosityAcceleration(0.f, 0.f);
+            glm::vec2 staticViscosityAcceleration(0.f, 0.f);
+            glm::vec2 fluidPressureAcceleration(0.f, 0.f);
+            glm::vec2 boundaryPressureAcceleration(0.f, 0.f);
+            for (unsigned t = 0; t < threadCount; t++)
+            {
+                if (i >= threadRanges[t].first && i < threadRanges[t].second)
+                {
+                    fluidViscosityAcceleration += threadViscosities[t][i - threadRanges[t].first];
+                    fluidPressureAcceleration += threadPressures[t][i - threadRanges[t].first];
+                }
+            }
+            for (size_t s = 0; s < particleSets.size(); s++)
+            {
+                if (s == q)
+                {
+                    continue;
+                }
+                const ParticleSet *otherSet = particleSets[s];
+                const std::vector<glm::vec2> &otherPositions = otherSet->positions;
+                const std::vector<glm::vec2> &otherVelocities = otherSet->velocities;
+                const std::vector<float> &otherDensities = otherSet->densities;
+                const std::vector<float> &otherPressures = otherSet->pressures;
+                const std::vector<float> *volumes = otherSet->isBoundary ? &staticBoundary.Volumes(s) : nullptr;
+                for (unsigned j : table.Neighbors(i, s))
+                {
+                    // A single kernel gradient per neighbor for both viscosity and pressure
+                    const glm::vec2 positionDiff = positions[i] - otherPositions[j];
+                    const glm::vec2 velocityDiff = velocities[i] - otherVelocities[j];
+                    const glm::vec2 kernelDer = kernel.Derivative(positions[i], otherPositions[j]);
+                    const float otherVolume = volumes != nullptr ? (*volumes)[j] : otherSet->particleVolume();
+                    const glm::vec2 viscosityTerm = kernelDer * otherVolume *
+                                                    (glm::dot(velocityDiff, positionDiff)) /
+                                                    (glm::dot(positionDiff, positionDiff) + viscosityEpsilon);
+                    if (!otherSet->isBoundary)
+                    {
+                        fluidViscosityAcceleration += viscosityTerm;
+                        fluidPressureAcceleration += (pressureOverDensity2 + otherPressures[j] / (otherDensities[j] * otherDensities[j])) * kernelDer;
+                    }
+                    else
+                    {
+                        staticViscosityAcceleration += otherSet->viscosity * viscosityTerm;
+                        boundaryPressureAcceleration += otherVolume * kernelDer;
+                    }
+                }
+            }
+            if (hasField)
+            {
+                const BoundaryField::Sample sample = boundaryField.Lookup(positions[i]);
+                staticViscosityAcceleration += boundaryField.viscosity * (sample.viscosity * velocities[i]);
+                boundaryPressureAcceleration += sample.gradient;
+            }
+            fluidViscosityAcceleration *= 2.f;
+            fluidViscosityAcceleration *= particleSet->viscosity;
+            staticViscosityAcceleration *= 2.f;
+            glm::vec2 viscosityAcceleration = fluidViscosityAcceleration + staticViscosityAcceleration;
+            boundaryPressureAcceleration *= pressures[i] *
+                                            (1.f / (densities[i] * densities[i]) +
+                                             1.f / (particleSet->restDensity * particleSet->restDensity));
+            glm::vec2 pressureAcceleration = -(mass * fluidPressureAcceleration + particleSet->restDensity * boundaryPressureAcceleration);
+            glm::vec2 otherAccelerations = gravity;
+            particleSet->pressureAccelerations[i] = pressureAcceleration;
+            particleSet->viscosityAccelerations[i] = viscosityAcceleration;
+            particleSet->otherAccelerations[i] = otherAccelerations;
+            particleSet->accelerations[i] = viscosityAcceleration + pressureAcceleration + otherAccelerations;
+        }
+    });
 }
 
-float ParticleSimulation::ComputeTimeStep(float CFLNumber) const
+float ParticleSimulation::ComputeTimeStep(float CFLNumber, float forceNumber, float viscousNumber) const
 {
-    float timeStep = 0.01f; // max time step
+    float maxViscosity = 0.f;
+    for (auto &&particleSet : particleSets)
+    {
+        maxViscosity = glm::max(maxViscosity, particleSet->viscosity);
+    }
+    float timeStep = std::numeric_limits<float>::infinity();
     for (auto &&particleSet : particleSets)
     {
         if (!particleSet->isBoundary)
         {
-            float maxVelocity = 0.f;
-            for (auto &&particle : particleSet->particles)
+            const float spacing = particleSet->spacing;
+            const float maxVelocity = MaxNorm(particleSet->velocities);
+            const float maxAcceleration = MaxNorm(particleSet->accelerations);
+            if (maxVelocity > 0.f)
             {
-                float velocityMagnitude = glm::length(particle.velocity);
-                if (velocityMagnitude > maxVelocity)
-                {
-                    maxVelocity = velocityMagnitude;
-                }
+                timeStep = glm::min(timeStep, CFLNumber * spacing / maxVelocity);
+            }
+            if (maxAcceleration > 0.f)
+            {
+                timeStep = glm::min(timeStep, forceNumber * glm::sqrt(spacing / maxAcceleration));
+            }
+            if (maxViscosity > 0.f)
+            {
+                timeStep = glm::min(timeStep, viscousNumber * spacing * spacing / maxViscosity);
             }
-            timeStep = glm::clamp(CFLNumber * particleSet->spacing / maxVelocity, 0.000001f, timeStep);
         }
     }
     return timeStep;
 }
 
+float ParticleSimulation::MaxNorm(const std::vector<glm::vec2> &vectors) const
+{
+    threadMaxima.assign(threadPool->ThreadCount(), 0.f);
+    threadPool->ParallelFor(vectors.size(), [&](size_t begin, size_t end, unsigned t) {
+        float threadMax = 0.f;
+        for (size_t i = begin; i < end; i++)
+        {
+            threadMax = glm::max(threadMax, glm::dot(vectors[i], vectors[i]));
+        }
+        threadMaxima[t] = threadMax;
+    });
+    float max2 = 0.f;
+    for (auto &&threadMax : threadMaxima)
+    {
+        max2 = glm::max(max2, threadMax);
+    }
+    return glm::sqrt(max2);
+}
+
 void ParticleSimulation::UpdateParticlePositions(float timeStep) const
 {
+    MYSOLVER_TIME_PHASE(Phase::Integration);
     for (auto &&particleSet : particleSets)
     {
         if (!particleSet->isBoundary)
@@ -171,11 +878,40 @@ void ParticleSimulation::UpdateParticlePositions(float timeStep) const
             // Update position based on acceleration for each particle
 
             // using the semi-implicit Euler method
-            for (auto &&particle : particleSet->particles)
+            std::vector<glm::vec2> &positions = particleSet->positions;
+            std::vector<glm::vec2> &velocities = particleSet->velocities;
+            const std::vector<glm::vec2> &accelerations = particleSet->accelerations;
+            threadPool->ParallelFor(particleSet->size(), [&](size_t begin, size_t end, unsigned) {
+                for (size_t i = begin; i < end; i++)
+                {
+                    velocities[i] += timeStep * accelerations[i];
+                    positions[i] += timeStep * velocities[i];
+                }
+            });
+        }
+    }
+}
+
+void ParticleSimulation::Relax(float radius, const glm::vec2 gravity, float timeStep, unsigned steps, float damping)
+{
+    for (unsigned step = 0; step < steps; step++)
+    {
+        UpdateNeighbors(radius);
+        UpdateParticleQuantities(gravity);
+        SolvePressure(timeStep);
+        UpdateParticlePositions(timeStep);
+        for (auto &&particleSet : particleSets)
+        {
+            if (!particleSet->isBoundary)
             {
-                particle.velocity += timeStep * particle.acceleration;
-                particle.position += timeStep * particle.velocity;
+                std::vector<glm::vec2> &velocities = particleSet->velocities;
+                threadPool->ParallelFor(particleSet->size(), [&](size_t begin, size_t end, unsigned) {
+                    for (size_t i = begin; i < end; i++)
+                    {
+                        velocities[i] *= step + 1 < steps ? damping : 0.f;
+                    }
+                });
             }
         }
     }
-}
\ No newline at end of file
+}
@@ -2,33 +2,227 @@
 
 #include "Particle.hpp"
 #include "ParticleSet.hpp"
+#include "NeighborGrid.hpp"
+#include "NeighborTable.hpp"
+#include "KernelFunctions.hpp"
+#include "KernelTable.hpp"
+#include "KernelBatch.hpp"
+#include "StaticBoundary.hpp"
+#include "BoundaryField.hpp"
 #include <glm/vec2.hpp> // glm::vec2
+#include <memory>       // std::unique_ptr
+#include <string>       // std::string
+#include <utility>      // std::pair
 #include <vector>
-#include <map>
+
+class ThreadPool;
+
+// Models of the pressure, selectable at run time.
+enum class PressureSolver
+{
+    StateEquation, // Pressure from the density with the stiffness of each set (weakly compressible)
+    IISPH,         // Implicit incompressible SPH (Ihmsen et al. 2014), solved with relaxed Jacobi iterations
+    DFSPH,         // Divergence-free SPH (Bender and Koschier 2015): divergence-free and constant-density solvers
+    PCISPH         // Predictive-corrective incompressible SPH (Solenthaler and Pajarola 2009)
+};
 
 // Simulates fluid dynamics for a scene composed of particle sets.
 class ParticleSimulation
 {
 
 public:
+    ParticleSimulation();
+    ~ParticleSimulation();
+    // Number of threads used by each phase of a simulation step (1 for sequential execution).
+    void SetThreadCount(unsigned threadCount);
+    unsigned GetThreadCount() const;
     // Adds a particle set to the scene
     void AddParticleSet(ParticleSet &particleSet);
-    // Deletes all particle sets from scene and forgets all neighbor mappings.
+    // Deletes all particle sets and the boundary field from scene and forgets all neighbor mappings.
     void Clear();
-    // Map each particle to its nearest neighbors within a radius of `kernelSupport'.
+    // Freezes the boundary sets added so far for neighbor searches within `radius' (see StaticBoundary):
+    // their grids and volumes are computed once, and only fluid particles look for neighbors. Boundary
+    // particles must not move afterwards. UpdateNeighbors freezes them itself when needed.
+    void FreezeBoundaries(float radius);
+    const StaticBoundary &GetStaticBoundary() const;
+    // Boundaries given by shapes instead of particles (see BoundaryField), in addition to the boundary
+    // particle sets. Its maps are integrated by UpdateParticleQuantities for the kernel and the spacing of the fluid.
+    void SetBoundaryField(const BoundaryField &field);
+    const BoundaryField &GetBoundaryField() const;
+    // Map each fluid particle to its nearest neighbors within a radius of `kernelSupport'.
+    // With a Verlet skin, the neighbors are searched within `kernelSupport + skin' and the lists are only
+    // rebuilt once a particle has moved by more than half the skin; they may then contain particles
+    // beyond the kernel support, whose contributions are zero.
     void UpdateNeighbors(float kernelSupport);
-    // Getters for neighbors
-    const std::vector<const Particle *> &GetNeighbors(const Particle &particle) const;
-    const std::vector<const Particle *> &GetBoundaryNeighbors(const Particle &particle) const;
-    // Update all quantities except position and velocity
+    // Sets the Verlet skin (0 rebuilds the neighbor lists on each update).
+    void SetVerletSkin(float skin);
+    float GetVerletSkin() const;
+    // Number of calls to UpdateNeighbors and number of actual rebuilds since the last Clear.
+    unsigned long GetNeighborUpdateCount() const;
+    unsigned long GetNeighborRebuildCount() const;
+    // Neighbors of the particles of the set of index `setIndex' (in the order the sets were added), empty for boundary sets.
+    const NeighborTable &GetNeighborTable(size_t setIndex) const;
+    // Neighbor tables and Verlet state, to save them with the particle sets (see Checkpoint).
+    struct NeighborState
+    {
+        NeighborState() : radius(0.f) {}
+        float radius; // Search radius of the tables, 0 if there are none
+        std::vector<NeighborTable> tables;
+        std::vector<std::vector<glm::vec2>> referencePositions; // Positions at the last rebuild, empty without skin
+    };
+    NeighborState GetNeighborState() const;
+    // Restores the neighbor tables of the same particle sets, added in the same order: UpdateNeighbors reuses
+    // them as long as the Verlet skin allows, instead of searching again.
+    void SetNeighborState(const NeighborState &state);
+    // Evaluates the kernel and the pair forces once per pair of fluid particles of a set and applies
+    // them to both particles (Newton's third law), instead of once from each side.
+    // Results differ from the per-particle evaluation by rounding only.
+    void SetPairwiseForces(bool pairwise);
+    bool GetPairwiseForces() const;
+    // SPH kernel used by UpdateParticleQuantities (cubic spline by default), with a support of twice the particle spacing.
+    void SetKernel(KernelType type);
+    KernelType GetKernel() const;
+    // Evaluates the kernel from a table of `resolution' samples over the squared distance (see KernelTable),
+    // or analytically when `resolution' is 0 (default).
+    void SetKernelTable(unsigned resolution, KernelInterpolation interpolation = KernelInterpolation::Linear);
+    unsigned GetKernelTableResolution() const;
+    KernelInterpolation GetKernelInterpolation() const;
+    // Evaluates the analytic cubic spline for whole rows of neighbors with SIMD instructions (see KernelBatch)
+    // in the per-particle evaluation. Levels above KernelBatch::DetectedLevel() are lowered to it; Scalar (default)
+    // disables batches. Results are identical to the scalar evaluation.
+    void SetSimdLevel(SimdLevel level);
+    SimdLevel GetSimdLevel() const;
+    // Pressure model (state equation by default). The iterative solvers use the analytic kernel, without
+    // kernel tables, SIMD batches nor pairwise evaluation.
+    void SetPressureSolver(PressureSolver solver);
+    PressureSolver GetPressureSolver() const;
+    // The iterative solvers stop once the average density error (relative to the rest density) is below
+    // `tolerance' (default 1e-3), or after `maxIterations' iterations (default 100).
+    void SetPressureTolerance(float tolerance);
+    float GetPressureTolerance() const;
+    void SetMaxPressureIterations(unsigned maxIterations);
+    unsigned GetMaxPressureIterations() const;
+    // Relaxation factor of the iterations of IISPH and DFSPH (default 0.5, PCISPH uses its own scaling factor).
+    void SetPressureRelaxation(float relaxation);
+    float GetPressureRelaxation() const;
+    // All pressure solvers, and their names.
+    static const std::vector<PressureSolver> &PressureSolvers();
+    static const char *Name(PressureSolver solver);
+    // Solver of a name (e.g. "iisph"), throws std::invalid_argument for unknown names.
+    static PressureSolver PressureSolverFromName(const std::string &name);
+    // Update all quantities except position and velocity. With an iterative pressure solver, the pressure
+    // accelerations are left to SolvePressure.
     void UpdateParticleQuantities(const glm::vec2 gravity) const;
-    // Estimate best time step (not used at the moment)
-    float ComputeTimeStep(float CFLNumber) const;
+    // Computes the pressures and pressure accelerations of the iterative solvers for a step of `timeStep'
+    // and adds them to the accelerations; to be called between UpdateParticleQuantities and
+    // UpdateParticlePositions. Only measures the density error with the state equation.
+    void SolvePressure(float timeStep) const;
+    // Iterations of the last SolvePressure (0 for the state equation, those of both solvers for DFSPH).
+    unsigned GetPressureIterations() const;
+    // Iterations of the solver of the density error below (of the constant-density solver for DFSPH).
+    unsigned GetDensityIterations() const;
+    // Average compression (density - rest density) / rest density of the fluid particles after the last
+    // SolvePressure, where expanded particles count as 0: of the current densities for the state equation,
+    // and of the densities predicted by the last iteration for the iterative solvers (of the constant-density
+    // solver for DFSPH).
+    float GetDensityError() const;
+    // Largest stable time step for the current velocities and accelerations (see AdaptiveTimeStep):
+    // the minimum over the fluid sets of the velocity (CFL) constraint CFLNumber * spacing / max |v|, the force
+    // constraint forceNumber * sqrt(spacing / max |a|) and the viscous constraint viscousNumber * spacing^2 / viscosity,
+    // where viscosity is the largest one of the set and of the boundaries. Infinite when nothing constrains it.
+    float ComputeTimeStep(float CFLNumber, float forceNumber = .25f, float viscousNumber = .125f) const;
     // Update particles positions and velocities
     void UpdateParticlePositions(float timeStep) const;
+    // Lets the fluid settle before the simulation starts: runs `steps' full steps of `timeStep' under `gravity',
+    // with neighbors within `radius', and multiplies the fluid velocities by `damping' after each step; they
+    // are zero afterwards. Heavily damped, the steps can be longer than those of the simulation.
+    void Relax(float radius, const glm::vec2 gravity, float timeStep, unsigned steps, float damping = .5f);
+
+private:
+    // Fills the rows of particles [begin, end) of set `setIndex'.
+    void FindNeighbors(size_t setIndex, size_t begin, size_t end, float radius, NeighborTable &table) const;
+    // Density, pressure and accelerations of the fluid set `q', gathered from the neighbors of each particle.
+    template <typename KernelFunction>
+    void UpdateQuantitiesPerParticle(size_t q, const glm::vec2 gravity, const KernelFunction &kernel) const;
+    // Same quantities, scattered once per pair of particles of the set into per-thread buffers.
+    template <typename KernelFunction>
+    void UpdateQuantitiesPairwise(size_t q, const glm::vec2 gravity, const KernelFunction &kernel) const;
+    // Largest distance traveled by a particle since the neighbor lists were built.
+    float MaxDisplacement() const;
+    // Largest norm of the vectors.
+    float MaxNorm(const std::vector<glm::vec2> &vectors) const;
+    // Density, viscosity and other accelerations of the fluid set `q' for the iterative pressure solvers,
+    // keeping the kernel gradients of its neighbors (see PressureSolvers.cpp).
+    void UpdateNonPressureQuantities(size_t q, const glm::vec2 gravity) const;
+    // Pressure accelerations of all fluid sets from their current pressures.
+    void UpdatePressureAccelerations() const;
+    // Same, then added to the accelerations.
+    void AddPressureAccelerations() const;
+    // Factors alpha of the fluid particles (see PressureSolvers.cpp).
+    void UpdateSolverFactors() const;
+    // Velocities after a step of the pressure accelerations, and of the other accelerations if `withNonPressureAccelerations'.
+    void PredictVelocities(float timeStep, bool withNonPressureAccelerations) const;
+    // Rate of change of the density of particle i of set q from the predicted velocities.
+    float PredictedDensityRate(size_t q, size_t i) const;
+    size_t FluidParticleCount() const;
+    void SolveIISPH(float timeStep) const;
+    void SolveDFSPH(float timeStep) const;
+    // Iterations of the divergence-free or of the constant-density solver of DFSPH, returns their count.
+    unsigned IterateDFSPH(float timeStep, bool divergenceFree) const;
+    void SolvePCISPH(float timeStep) const;
+    // |sum grad W|^2 + sum |grad W|^2 over the neighbors of a particle surrounded by fluid at rest, for the scaling factor of PCISPH.
+    static float PrototypeGradientSum(KernelType type, float spacing);
 
 private:
     std::vector<ParticleSet *> particleSets;
-    std::map<const Particle *, std::vector<const Particle *>> neighbors;
-    std::map<const Particle *, std::vector<const Particle *>> boundaryNeighbors;
+    // One spatial grid per fluid set, rebuilt by UpdateNeighbors
+    std::vector<NeighborGrid> grids;
+    // Volumes are computed lazily by UpdateParticleQuantities, for the current kernel
+    mutable StaticBoundary staticBoundary;
+    mutable BoundaryField boundaryField;
+    // One neighbor table per particle set, rows of a particle are split by neighbor set
+    std::vector<NeighborTable> neighborTables;
+    // Verlet list state
+    float verletSkin;
+    float neighborRadius; // Search radius of the current neighbor tables.
+    bool neighborsValid;
+    std::vector<std::vector<glm::vec2>> referencePositions; // Positions at the last rebuild.
+    unsigned long neighborUpdateCount, neighborRebuildCount;
+    // Workers shared by all phases, and the partial neighbor tables they fill
+    std::unique_ptr<ThreadPool> threadPool;
+    std::vector<NeighborTable> partialTables;
+    mutable std::vector<float> threadMaxima;
+    // Pairwise force evaluation and its per-thread accumulation buffers
+    bool pairwiseForces;
+    KernelType kernelType;
+    unsigned kernelTableResolution;
+    KernelInterpolation kernelInterpolation;
+    mutable std::vector<KernelTable> kernelTables; // One per particle set, rebuilt when the kernel changes.
+    SimdLevel simdLevel;
+    mutable std::vector<KernelBatchScratch> threadScratch; // Rows of neighbors gathered by each thread.
+    mutable std::vector<std::vector<float>> threadDensities; // Over the particles of threadRanges
+    mutable std::vector<std::vector<glm::vec2>> threadViscosities, threadPressures;
+    mutable std::vector<std::pair<size_t, size_t>> threadRanges; // Chunk of each thread and its pairs
+    // Iterative pressure solvers
+    PressureSolver pressureSolver;
+    float pressureTolerance;
+    unsigned maxPressureIterations;
+    float pressureRelaxation;
+    mutable unsigned pressureIterations, densityIterations;
+    mutable float densityError;
+    // Per-particle data of the iterative solvers, for one fluid set.
+    struct SolverData
+    {
+        SolverData() : prototypeKernel(KernelType::CubicSpline), prototypeSpacing(0.f), prototypeGradientSum(0.f) {}
+        std::vector<glm::vec2> gradients; // Kernel gradient of each neighbor, at the neighbor's position in the table.
+        std::vector<glm::vec2> fieldGradients; // Gradient of the boundary field volume over V_i, of each particle.
+        std::vector<glm::vec2> predictedVelocities, predictedPositions; // After a step of the current accelerations.
+        std::vector<float> factors, source;
+        std::vector<float> divergencePressures; // Pressures of the divergence-free solver of DFSPH, or those of the density while it runs.
+        std::vector<float> errors; // Compression of each particle, summed in order so that results do not depend on threads.
+        // Prototype particle of PCISPH, computed again when the kernel or the spacing change
+        KernelType prototypeKernel;
+        float prototypeSpacing, prototypeGradientSum;
+    };
+    mutable std::vector<SolverData> solverData; // One per particle set.
 };
\ No newline at end of file
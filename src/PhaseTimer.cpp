@@ -0,0 +1,115 @@
+#include "PhaseTimer.hpp"
+
+#include <algorithm> // std::min, std::nth_element
+#include <cmath>     // std::ceil
+
+PhaseTimings::PhaseTimings(size_t frameCount)
+    : capacity(frameCount > 0 ? frameCount : 1)
+{
+    Clear();
+}
+
+PhaseTimings &PhaseTimings::Global()
+{
+    static PhaseTimings timings;
+    return timings;
+}
+
+const char *PhaseTimings::Name(Phase phase)
+{
+    switch (phase)
+    {
+    case Phase::NeighborSearch:
+        return "Neighbor search";
+    case Phase::DensityPressure:
+        return "Density and pressure";
+    case Phase::Forces:
+        return "Viscosity and pressure acceleration";
+    case Phase::PairwiseForces:
+        return "Pairwise forces";
+    case Phase::PressureSolve:
+        return "Pressure solve";
+    case Phase::Integration:
+        return "Integration";
+    case Phase::History:
+        return "History";
+    case Phase::Snapshot:
+        return "Snapshot";
+    case Phase::VertexData:
+        return "Vertex data";
+    case Phase::Upload:
+        return "GL upload";
+    default:
+        return "";
+    }
+}
+
+void PhaseTimings::Add(Phase phase, double seconds)
+{
+    current[static_cast<size_t>(phase)] += seconds;
+}
+
+void PhaseTimings::EndFrame()
+{
+    for (size_t p = 0; p < phaseCount; p++)
+    {
+        history[p][next] = static_cast<float>(current[p] * 1000.0);
+        current[p] = 0.0;
+    }
+    next = (next + 1) % capacity;
+    frameCount = std::min(frameCount + 1, capacity);
+}
+
+void PhaseTimings::Clear()
+{
+    frameCount = 0;
+    next = 0;
+    for (size_t p = 0; p < phaseCount; p++)
+    {
+        current[p] = 0.0;
+        history[p].assign(capacity, 0.f);
+    }
+}
+
+size_t PhaseTimings::FrameCount() const
+{
+    return frameCount;
+}
+
+PhaseTimings::Statistics PhaseTimings::GetStatistics(Phase phase) const
+{
+    Statistics statistics = {0.f, 0.f, 0.f};
+    if (frameCount == 0)
+    {
+        return statistics;
+    }
+    // The kept frames are the first `frameCount' ones until the buffer is full, so order does not matter
+    std::vector<float> samples(history[static_cast<size_t>(phase)].begin(), history[static_cast<size_t>(phase)].begin() + frameCount);
+    double sum = 0.0;
+    for (float sample : samples)
+    {
+        sum += sample;
+    }
+    statistics.mean = static_cast<float>(sum / frameCount);
+    // Nearest-rank percentiles
+    const auto percentile = [&](double fraction) {
+        const size_t rank = static_cast<size_t>(std::ceil(fraction * frameCount));
+        auto nth = samples.begin() + (rank > 0 ? rank - 1 : 0);
+        std::nth_element(samples.begin(), nth, samples.end());
+        return *nth;
+    };
+    statistics.p50 = percentile(.5);
+    statistics.p99 = percentile(.99);
+    return statistics;
+}
+
+void PhaseTimings::GetHistory(Phase phase, std::vector<float> &milliseconds) const
+{
+    const std::vector<float> &samples = history[static_cast<size_t>(phase)];
+    milliseconds.resize(frameCount);
+    const size_t oldest = frameCount < capacity ? 0 : next;
+    for (size_t k = 0; k < frameCount; k++)
+    {
+        milliseconds[k] = samples[(oldest + k) % capacity];
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "TraceRecorder.hpp" // TraceRecorder
+#include <chrono>            // std::chrono::steady_clock
+#include <cstddef>           // size_t
+#include <vector>            // std::vector
+
+// Phases of a simulation step and of its visualization, timed separately.
+enum class Phase
+{
+    NeighborSearch,
+    DensityPressure,
+    Forces,         // Viscosity and pressure accelerations (per particle, or the remaining terms when pairwise)
+    PairwiseForces, // Viscosity and pressure terms of the pairs of fluid particles
+    PressureSolve,  // Iterations of the implicit pressure solvers
+    Integration,
+    History,
+    Snapshot, // Pause of the simulation to take a checkpoint
+    VertexData,
+    Upload,
+    Count
+};
+
+// Rolling per-phase timings of the last frames, where a frame is typically one call to Experiment::OnUpdate.
+// Timers add to the current frame, which EndFrame closes. Phases are timed from the thread calling the
+// simulation (not from the worker threads), so that no synchronization is needed.
+class PhaseTimings
+{
+public:
+    // Statistics of the time spent in a phase per frame, in milliseconds.
+    struct Statistics
+    {
+        float mean, p50, p99;
+    };
+    static const size_t phaseCount = static_cast<size_t>(Phase::Count);
+
+    // Keeps the timings of the last `frameCount' frames.
+    explicit PhaseTimings(size_t frameCount = 300);
+    // Timings of the whole program, filled by MYSOLVER_TIME_PHASE.
+    static PhaseTimings &Global();
+    static const char *Name(Phase phase);
+
+    void Add(Phase phase, double seconds);
+    void EndFrame();
+    void Clear();
+    // Number of frames kept (at most the capacity given to the constructor).
+    size_t FrameCount() const;
+    Statistics GetStatistics(Phase phase) const;
+    // Milliseconds spent in the phase during the kept frames, from the oldest to the newest.
+    void GetHistory(Phase phase, std::vector<float> &milliseconds) const;
+
+private:
+    size_t capacity;
+    size_t frameCount;
+    size_t next; // Index of the next frame in the ring buffers.
+    double current[phaseCount];
+    std::vector<float> history[phaseCount];
+};
+
+// Adds the time spent in its scope to a phase of PhaseTimings::Global(), and records it into
+// TraceRecorder::Global() when it is recording.
+class PhaseTimer
+{
+public:
+    explicit PhaseTimer(Phase phase) : phase(phase), start(std::chrono::steady_clock::now()) {}
+    ~PhaseTimer()
+    {
+        const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        const std::chrono::duration<double> elapsed = end - start;
+        PhaseTimings::Global().Add(phase, elapsed.count());
+        if (TraceRecorder::Global().IsRecording())
+        {
+            TraceRecorder::Global().Record(PhaseTimings::Name(phase), start, end);
+        }
+    }
+    PhaseTimer(const PhaseTimer &) = delete;
+    PhaseTimer &operator=(const PhaseTimer &) = delete;
+
+private:
+    Phase phase;
+    std::chrono::steady_clock::time_point start;
+};
+
+// Times the rest of the enclosing scope as `phase'. Expands to nothing unless MYSOLVER_PHASE_TIMERS is
+// defined (CMake option of the same name).
+#ifdef MYSOLVER_PHASE_TIMERS
+#define MYSOLVER_TIME_PHASE(phase) MYSOLVER_TIME_PHASE_AT(phase, __LINE__)
+#define MYSOLVER_TIME_PHASE_AT(phase, line) MYSOLVER_TIME_PHASE_NAMED(phase, line)
+#define MYSOLVER_TIME_PHASE_NAMED(phase, line) PhaseTimer phaseTimer##line(phase)
+#else
+#define MYSOLVER_TIME_PHASE(phase)
+#endif
@@ -0,0 +1,745 @@
+#include "ParticleSimulation.hpp"
+
+#include "PhaseTimer.hpp"    // MYSOLVER_TIME_PHASE
+#include "ThreadPool.hpp"    // ThreadPool
+#include <glm/common.hpp>    // glm::max
+#include <glm/geometric.hpp> // glm::dot
+#include <stdexcept>         // std::invalid_argument
+#include <utility>           // std::swap
+
+// Iterative pressure solvers. The pressure acceleration of a fluid particle i is discretized as in
+// UpdateQuantitiesPerParticle:
+//   a_i = -m [ sum_f (p_i / rho_i^2 + p_j / rho_j^2) grad W_ij + p_i (1 / rho_i^2 + 1 / rho_0^2) sum_b grad W_ib ]
+// where f are the fluid neighbors, b the boundary neighbors and m the mass of the particles of the set.
+// Boundary particles have the mass rho_0 V_b of the fluid they replace (see StaticBoundary): the cached
+// gradients of boundary neighbors are scaled by V_b / V_i, so that the solvers use the mass m for all
+// neighbors. The boundary field adds the gradient of its volume, over V_i, to sum_b grad W_ib.
+
+void ParticleSimulation::SetPressureSolver(PressureSolver solver)
+{
+    pressureSolver = solver;
+}
+
+PressureSolver ParticleSimulation::GetPressureSolver() const
+{
+    return pressureSolver;
+}
+
+void ParticleSimulation::SetPressureTolerance(float tolerance)
+{
+    pressureTolerance = glm::max(tolerance, 0.f);
+}
+
+float ParticleSimulation::GetPressureTolerance() const
+{
+    return pressureTolerance;
+}
+
+void ParticleSimulation::SetMaxPressureIterations(unsigned maxIterations)
+{
+    maxPressureIterations = maxIterations > 0 ? maxIterations : 1;
+}
+
+unsigned ParticleSimulation::GetMaxPressureIterations() const
+{
+    return maxPressureIterations;
+}
+
+void ParticleSimulation::SetPressureRelaxation(float relaxation)
+{
+    pressureRelaxation = relaxation;
+}
+
+float ParticleSimulation::GetPressureRelaxation() const
+{
+    return pressureRelaxation;
+}
+
+unsigned ParticleSimulation::GetPressureIterations() const
+{
+    return pressureIterations;
+}
+
+unsigned ParticleSimulation::GetDensityIterations() const
+{
+    return densityIterations;
+}
+
+float ParticleSimulation::GetDensityError() const
+{
+    return densityError;
+}
+
+const std::vector<PressureSolver> &ParticleSimulation::PressureSolvers()
+{
+    static const std::vector<PressureSolver> solvers = {PressureSolver::StateEquation, PressureSolver::IISPH, PressureSolver::DFSPH, PressureSolver::PCISPH};
+    return solvers;
+}
+
+const char *ParticleSimulation::Name(PressureSolver solver)
+{
+    switch (solver)
+    {
+    case PressureSolver::StateEquation:
+        return "state-equation";
+    case PressureSolver::IISPH:
+        return "iisph";
+    case PressureSolver::DFSPH:
+        return "dfsph";
+    case PressureSolver::PCISPH:
+        return "pcisph";
+    }
+    return "";
+}
+
+PressureSolver ParticleSimulation::PressureSolverFromName(const std::string &name)
+{
+    for (PressureSolver solver : PressureSolvers())
+    {
+        if (name == Name(solver))
+        {
+            return solver;
+        }
+    }
+    throw std::invalid_argument("unknown pressure solver: " + name);
+}
+
+void ParticleSimulation::UpdateNonPressureQuantities(size_t q, const glm::vec2 gravity) const
+{
+    ParticleSet *particleSet = particleSets[q];
+    const NeighborTable &table = neighborTables[q];
+    const std::vector<glm::vec2> &positions = particleSet->positions;
+    const std::vector<glm::vec2> &velocities = particleSet->velocities;
+    std::vector<float> &densities = particleSet->densities;
+    const float mass = particleSet->particleMass();
+    const float volume = particleSet->particleVolume();
+    solverData.resize(particleSets.size());
+    std::vector<glm::vec2> &gradients = solverData[q].gradients;
+    gradients.resize(table.Size());
+    std::vector<glm::vec2> &fieldGradients = solverData[q].fieldGradients;
+    fieldGradients.assign(particleSet->size(), glm::vec2(0.f, 0.f));
+    const bool hasField = !boundaryField.Empty();
+    const float viscosityEpsilon = 0.01f * particleSet->spacing * particleSet->spacing;
+    DispatchKernel<2>(kernelType, particleSet->spacing, [&](const auto &kernel) {
+        {
+            // Densities, and the kernel gradients that every iteration reuses
+            MYSOLVER_TIME_PHASE(Phase::DensityPressure);
+            threadPool->ParallelFor(particleSet->size(), [&](size_t begin, size_t end, unsigned) {
+                for (size_t i = begin; i < end; i++)
+                {
+                    float density = 0.f;
+                    for (size_t s = 0; s < particleSets.size(); s++)
+                    {
+                        const std::vector<glm::vec2> &otherPositions = particleSets[s]->positions;
+                        size_t k = table.Offset(i, s);
+                        if (!particleSets[s]->isBoundary)
+                        {
+                            for (unsigned j : table.Neighbors(i, s))
+                            {
+                                density += kernel.Function(positions[i], otherPositions[j]);
+                                gradients[k++] = kernel.Derivative(positions[i], otherPositions[j]);
+                            }
+                        }
+                        else
+                        {
+                            const std::vector<float> &volumes = staticBoundary.Volumes(s);
+                            for (unsigned j : table.Neighbors(i, s))
+                            {
+                                const float relativeVolume = volumes[j] / volume;
+                                density += relativeVolume * kernel.Function(positions[i], otherPositions[j]);
+                                gradients[k++] = relativeVolume * kernel.Derivative(positions[i], otherPositions[j]);
+                            }
+                        }
+                    }
+                    if (hasField)
+                    {
+                        const BoundaryField::Sample sample = boundaryField.Lookup(positions[i]);
+                        density += sample.volume / volume;
+                        fieldGradients[i] = sample.gradient / volume;
+                    }
+                    densities[i] = density * mass;
+                }
+            });
+        }
+        // Viscosity as in UpdateQuantitiesPerParticle. The pressures are kept to warm start the solver.
+        MYSOLVER_TIME_PHASE(Phase::Forces);
+        threadPool->ParallelFor(particleSet->size(), [&](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; i++)
+            {
+                glm::vec2 fluidViscosityAcceleration(0.f, 0.f);
+                glm::vec2 staticViscosityAcceleration(0.f, 0.f);
+                for (size_t s = 0; s < particleSets.size(); s++)
+                {
+                    const ParticleSet *otherSet = particleSets[s];
+                    const std::vector<glm::vec2> &otherPositions = otherSet->positions;
+                    const std::vector<glm::vec2> &otherVelocities = otherSet->velocities;
+                    const glm::vec2 *kernelDer = gradients.data() + table.Offset(i, s);
+                    // Scaled boundary gradients times the own volume give V_b grad W
+                    const float otherVolume = otherSet->isBoundary ? volume : otherSet->particleVolume();
+                    glm::vec2 viscosity(0.f, 0.f);
+                    for (unsigned j : table.Neighbors(i, s))
+                    {
+                        const glm::vec2 positionDiff = positions[i] - otherPositions[j];
+                        const glm::vec2 velocityDiff = velocities[i] - otherVelocities[j];
+                        viscosity += *kernelDer++ * otherVolume *
+                                     (glm::dot(velocityDiff, positionDiff)) /
+                                     (glm::dot(positionDiff, positionDiff) + viscosityEpsilon);
+                    }
+                    if (!otherSet->isBoundary)
+                    {
+                        fluidViscosityAcceleration += viscosity;
+                    }
+                    else
+                    {
+                        staticViscosityAcceleration += otherSet->viscosity * viscosity;
+                    }
+                }
+                if (hasField)
+                {
+                    staticViscosityAcceleration += boundaryField.viscosity * (boundaryField.Lookup(positions[i]).viscosity * velocities[i]);
+                }
+                const glm::vec2 viscosityAcceleration = 2.f * particleSet->viscosity * fluidViscosityAcceleration +
+                                                        2.f * staticViscosityAcceleration;
+                particleSet->pressureAccelerations[i] = glm::vec2(0.f, 0.f);
+                particleSet->viscosityAccelerations[i] = viscosityAcceleration;
+                particleSet->otherAccelerations[i] = gravity;
+                particleSet->accelerations[i] = viscosityAcceleration + gravity;
+            }
+        });
+    });
+}
+
+void ParticleSimulation::UpdatePressureAccelerations() const
+{
+    for (size_t q = 0; q < particleSets.size(); q++)
+    {
+        ParticleSet *particleSet = particleSets[q];
+        if (particleSet->isBoundary)
+        {
+            continue;
+        }
+        const NeighborTable &table = neighborTables[q];
+        const std::vector<glm::vec2> &gradients = solverData[q].gradients;
+        const std::vector<glm::vec2> &fieldGradients = solverData[q].fieldGradients;
+        const std::vector<float> &densities = particleSet->densities;
+        const std::vector<float> &pressures = particleSet->pressures;
+        const float mass = particleSet->particleMass();
+        const float restDensity2 = particleSet->restDensity * particleSet->restDensity;
+        threadPool->ParallelFor(particleSet->size(), [&](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; i++)
+            {
+                const float pressureOverDensity2 = pressures[i] / (densities[i] * densities[i]);
+                glm::vec2 fluidPressureAcceleration(0.f, 0.f);
+                glm::vec2 boundaryGradient = fieldGradients[i];
+                for (size_t s = 0; s < particleSets.size(); s++)
+                {
+                    const ParticleSet *otherSet = particleSets[s];
+                    const glm::vec2 *kernelDer = gradients.data() + table.Offset(i, s);
+                    const NeighborTable::Range neighbors = table.Neighbors(i, s);
+                    if (!otherSet->isBoundary)
+                    {
+                        const std::vector<float> &otherDensities = otherSet->densities;
+                        const std::vector<float> &otherPressures = otherSet->pressures;
+                        for (unsigned j : neighbors)
+                        {
+                            fluidPressureAcceleration += (pressureOverDensity2 + otherPressures[j] / (otherDensities[j] * otherDensities[j])) * *kernelDer++;
+                        }
+                    }
+                    else
+                    {
+                        for (size_t k = 0; k < neighbors.size(); k++)
+                        {
+                            boundaryGradient += kernelDer[k];
+                        }
+                    }
+                }
+                const glm::vec2 boundaryPressureAcceleration = pressures[i] * (1.f / (densities[i] * densities[i]) + 1.f / restDensity2) * boundaryGradient;
+                particleSet->pressureAccelerations[i] = -mass * (fluidPressureAcceleration + boundaryPressureAcceleration);
+            }
+        });
+    }
+}
+
+void ParticleSimulation::SolvePressure(float timeStep) const
+{
+    MYSOLVER_TIME_PHASE(Phase::PressureSolve);
+    if (pressureSolver == PressureSolver::IISPH)
+    {
+        SolveIISPH(timeStep);
+        densityIterations = pressureIterations;
+        return;
+    }
+    if (pressureSolver == PressureSolver::DFSPH)
+    {
+        SolveDFSPH(timeStep);
+        return;
+    }
+    if (pressureSolver == PressureSolver::PCISPH)
+    {
+        SolvePCISPH(timeStep);
+        densityIterations = pressureIterations;
+        return;
+    }
+    // State equation: pressures are already applied, only measure the compression
+    pressureIterations = densityIterations = 0;
+    double error = 0.0;
+    size_t count = 0;
+    for (auto &&particleSet : particleSets)
+    {
+        if (!particleSet->isBoundary)
+        {
+            for (float density : particleSet->densities)
+            {
+                error += glm::max(density / particleSet->restDensity - 1.f, 0.f);
+            }
+            count += particleSet->size();
+        }
+    }
+    densityError = count > 0 ? static_cast<float>(error / count) : 0.f;
+}
+
+// With the pressure p_i of a single particle, the density of i changes in a step by
+//   dt^2 m [ sum_f (a_i - a_j) . grad W_ij + sum_b a_i . grad W_ib ] = -dt^2 p_i / alpha_i
+// (a_i = -m p_i c_i with c_i = sum_f grad W_ij / rho_i^2 + (1 / rho_i^2 + 1 / rho_0^2) sum_b grad W_ib, and
+// a_j = m p_i grad W_ij / rho_i^2). alpha_i is the factor of DFSPH, and -dt^2 / alpha_i the diagonal of IISPH.
+void ParticleSimulation::UpdateSolverFactors() const
+{
+    for (size_t q = 0; q < particleSets.size(); q++)
+    {
+        ParticleSet *particleSet = particleSets[q];
+        if (particleSet->isBoundary)
+        {
+            continue;
+        }
+        const NeighborTable &table = neighborTables[q];
+        SolverData &data = solverData[q];
+        const std::vector<float> &densities = particleSet->densities;
+        const float mass = particleSet->particleMass();
+        const float restDensity2 = particleSet->restDensity * particleSet->restDensity;
+        data.factors.resize(particleSet->size());
+        data.errors.resize(particleSet->size());
+        particleSet->pressures.resize(particleSet->size(), 0.f);
+        threadPool->ParallelFor(particleSet->size(), [&](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; i++)
+            {
+                const float invDensity2 = 1.f / (densities[i] * densities[i]);
+                glm::vec2 fluidGradient(0.f, 0.f), boundaryGradient = data.fieldGradients[i];
+                float fluidGradient2 = 0.f;
+                for (size_t s = 0; s < particleSets.size(); s++)
+                {
+                    const glm::vec2 *kernelDer = data.gradients.data() + table.Offset(i, s);
+                    const NeighborTable::Range neighbors = table.Neighbors(i, s);
+                    for (size_t k = 0; k < neighbors.size(); k++)
+                    {
+                        if (!particleSets[s]->isBoundary)
+                        {
+                            fluidGradient += kernelDer[k];
+                            fluidGradient2 += glm::dot(kernelDer[k], kernelDer[k]);
+                        }
+                        else
+                        {
+                            boundaryGradient += kernelDer[k];
+                        }
+                    }
+                }
+                const glm::vec2 selfCoefficient = invDensity2 * fluidGradient + (invDensity2 + 1.f / restDensity2) * boundaryGradient;
+                const float denominator = mass * mass * (glm::dot(selfCoefficient, fluidGradient + boundaryGradient) + invDensity2 * fluidGradient2);
+                // Isolated particles get no pressure
+                data.factors[i] = denominator > 0.f ? 1.f / denominator : 0.f;
+            }
+        });
+    }
+}
+
+void ParticleSimulation::PredictVelocities(float timeStep, bool withNonPressureAccelerations) const
+{
+    for (size_t q = 0; q < particleSets.size(); q++)
+    {
+        const ParticleSet *particleSet = particleSets[q];
+        if (particleSet->isBoundary)
+        {
+            continue;
+        }
+        std::vector<glm::vec2> &predictedVelocities = solverData[q].predictedVelocities;
+        predictedVelocities.resize(particleSet->size());
+        threadPool->ParallelFor(particleSet->size(), [&](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; i++)
+            {
+                const glm::vec2 acceleration = withNonPressureAccelerations ? particleSet->accelerations[i] + particleSet->pressureAccelerations[i]
+                                                                            : particleSet->pressureAccelerations[i];
+                predictedVelocities[i] = particleSet->velocities[i] + timeStep * acceleration;
+            }
+        });
+    }
+}
+
+float ParticleSimulation::PredictedDensityRate(size_t q, size_t i) const
+{
+    const NeighborTable &table = neighborTables[q];
+    const SolverData &data = solverData[q];
+    // The boundary field does not move
+    float divergence = glm::dot(data.predictedVelocities[i], data.fieldGradients[i]);
+    for (size_t s = 0; s < particleSets.size(); s++)
+    {
+        const ParticleSet *otherSet = particleSets[s];
+        const glm::vec2 *kernelDer = data.gradients.data() + table.Offset(i, s);
+        for (unsigned j : table.Neighbors(i, s))
+        {
+            // Boundaries keep their velocity
+            const glm::vec2 otherVelocity = otherSet->isBoundary ? otherSet->velocities[j] : solverData[s].predictedVelocities[j];
+            divergence += glm::dot(data.predictedVelocities[i] - otherVelocity, *kernelDer++);
+        }
+    }
+    return particleSets[q]->particleMass() * divergence;
+}
+
+size_t ParticleSimulation::FluidParticleCount() const
+{
+    size_t count = 0;
+    for (auto &&particleSet : particleSets)
+    {
+        if (!particleSet->isBoundary)
+        {
+            count += particleSet->size();
+        }
+    }
+    return count;
+}
+
+void ParticleSimulation::AddPressureAccelerations() const
+{
+    UpdatePressureAccelerations();
+    for (auto &&particleSet : particleSets)
+    {
+        if (!particleSet->isBoundary)
+        {
+            threadPool->ParallelFor(particleSet->size(), [&](size_t begin, size_t end, unsigned) {
+                for (size_t i = begin; i < end; i++)
+                {
+                    particleSet->accelerations[i] += particleSet->pressureAccelerations[i];
+                }
+            });
+        }
+    }
+}
+
+// Implicit incompressible SPH (Ihmsen et al. 2014): the pressures are such that the density predicted
+// after the step, from the velocities of the non-pressure accelerations and from the pressure
+// accelerations, is the rest density. The linear system A p = s, with
+//   (A p)_i = dt^2 m [ sum_f (a_i - a_j) . grad W_ij + sum_b a_i . grad W_ib ]   (a: pressure accelerations)
+//   s_i = rho_0 - rho_i - dt m sum (v*_i - v*_j) . grad W_ij                     (v*: predicted velocities)
+// is solved with relaxed Jacobi iterations, computing A p in two passes over the neighbors.
+void ParticleSimulation::SolveIISPH(float timeStep) const
+{
+    const float dt2 = timeStep * timeStep;
+    const size_t particleCount = FluidParticleCount();
+    UpdateSolverFactors();
+    // Sources from the velocities of the non-pressure accelerations, and warm start from half of the previous pressures
+    PredictVelocities(timeStep, true);
+    for (size_t q = 0; q < particleSets.size(); q++)
+    {
+        ParticleSet *particleSet = particleSets[q];
+        if (particleSet->isBoundary)
+        {
+            continue;
+        }
+        SolverData &data = solverData[q];
+        data.source.resize(particleSet->size());
+        threadPool->ParallelFor(particleSet->size(), [&](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; i++)
+            {
+                data.source[i] = particleSet->restDensity - particleSet->densities[i] - timeStep * PredictedDensityRate(q, i);
+                particleSet->pressures[i] *= .5f;
+            }
+        });
+    }
+
+    pressureIterations = 0;
+    densityError = 0.f;
+    while (pressureIterations < maxPressureIterations)
+    {
+        UpdatePressureAccelerations();
+        // Predicted compression and Jacobi update of the pressures. All pressure accelerations were
+        // computed before, so updating the pressures in place keeps the iteration a Jacobi one.
+        double error = 0.0;
+        for (size_t q = 0; q < particleSets.size(); q++)
+        {
+            ParticleSet *particleSet = particleSets[q];
+            if (particleSet->isBoundary)
+            {
+                continue;
+            }
+            const NeighborTable &table = neighborTables[q];
+            SolverData &data = solverData[q];
+            const std::vector<glm::vec2> &pressureAccelerations = particleSet->pressureAccelerations;
+            std::vector<float> &pressures = particleSet->pressures;
+            const float mass = particleSet->particleMass();
+            const float restDensity = particleSet->restDensity;
+            threadPool->ParallelFor(particleSet->size(), [&](size_t begin, size_t end, unsigned) {
+                for (size_t i = begin; i < end; i++)
+                {
+                    float product = glm::dot(pressureAccelerations[i], data.fieldGradients[i]);
+                    for (size_t s = 0; s < particleSets.size(); s++)
+                    {
+                        const ParticleSet *otherSet = particleSets[s];
+                        const glm::vec2 *kernelDer = data.gradients.data() + table.Offset(i, s);
+                        for (unsigned j : table.Neighbors(i, s))
+                        {
+                            const glm::vec2 otherAcceleration = otherSet->isBoundary ? glm::vec2(0.f, 0.f) : otherSet->pressureAccelerations[j];
+                            product += glm::dot(pressureAccelerations[i] - otherAcceleration, *kernelDer++);
+                        }
+                    }
+                    product *= dt2 * mass;
+                    data.errors[i] = glm::max(product - data.source[i], 0.f) / restDensity;
+                    // Diagonal -dt^2 / alpha_i
+                    pressures[i] = glm::max(pressures[i] - pressureRelaxation * (data.source[i] - product) * data.factors[i] / dt2, 0.f);
+                }
+            });
+            for (float particleError : data.errors)
+            {
+                error += particleError;
+            }
+        }
+        pressureIterations++;
+        densityError = particleCount > 0 ? static_cast<float>(error / particleCount) : 0.f;
+        // At least two iterations, as in the original method, since the first one starts from the warm start
+        if (pressureIterations >= 2 && densityError <= pressureTolerance)
+        {
+            break;
+        }
+    }
+    AddPressureAccelerations();
+}
+
+// Divergence-free SPH (Bender and Koschier 2015). The divergence-free solver first removes the
+// compression rate of the current velocities, then the constant-density solver removes the compression
+// predicted at the end of the step. Each iteration computes the density (rate) predicted from the
+// velocities of the accumulated pressures, and adds the pressure that would remove it if particle i were
+// alone, alpha_i / dt^2 per unit of density with the precomputed factors alpha_i. As for IISPH, these
+// increments are relaxed (the unrelaxed iterations of the original method diverge with this 2D discretization).
+void ParticleSimulation::SolveDFSPH(float timeStep) const
+{
+    UpdateSolverFactors();
+    // The divergence-free solver starts from zero pressures (warm starting it made the simulation unstable),
+    // while the pressures of the previous step are kept aside to warm start the constant-density solver
+    for (size_t q = 0; q < particleSets.size(); q++)
+    {
+        ParticleSet *particleSet = particleSets[q];
+        if (!particleSet->isBoundary)
+        {
+            std::swap(particleSet->pressures, solverData[q].divergencePressures);
+            particleSet->pressures.assign(particleSet->size(), 0.f);
+        }
+    }
+    const unsigned divergenceIterations = IterateDFSPH(timeStep, true);
+    AddPressureAccelerations();
+    for (size_t q = 0; q < particleSets.size(); q++)
+    {
+        if (!particleSets[q]->isBoundary)
+        {
+            std::swap(particleSets[q]->pressures, solverData[q].divergencePressures);
+        }
+    }
+    densityIterations = IterateDFSPH(timeStep, false);
+    AddPressureAccelerations();
+    pressureIterations += divergenceIterations;
+}
+
+unsigned ParticleSimulation::IterateDFSPH(float timeStep, bool divergenceFree) const
+{
+    const float dt2 = timeStep * timeStep;
+    const size_t particleCount = FluidParticleCount();
+    if (!divergenceFree)
+    {
+        for (auto &&particleSet : particleSets)
+        {
+            if (!particleSet->isBoundary)
+            {
+                for (float &pressure : particleSet->pressures)
+                {
+                    pressure *= .5f;
+                }
+            }
+        }
+    }
+    pressureIterations = 0;
+    densityError = 0.f;
+    while (pressureIterations < maxPressureIterations)
+    {
+        UpdatePressureAccelerations();
+        // The divergence-free solver corrects the velocities at the beginning of the step, before the
+        // non-pressure accelerations
+        PredictVelocities(timeStep, !divergenceFree);
+        double error = 0.0;
+        for (size_t q = 0; q < particleSets.size(); q++)
+        {
+            ParticleSet *particleSet = particleSets[q];
+            if (particleSet->isBoundary)
+            {
+                continue;
+            }
+            SolverData &data = solverData[q];
+            std::vector<float> &pressures = particleSet->pressures;
+            const float restDensity = particleSet->restDensity;
+            threadPool->ParallelFor(particleSet->size(), [&](size_t begin, size_t end, unsigned) {
+                for (size_t i = begin; i < end; i++)
+                {
+                    const float densityRate = PredictedDensityRate(q, i);
+                    // Compression over the step, of the density rate or of the density
+                    const float compression = divergenceFree ? timeStep * densityRate
+                                                             : particleSet->densities[i] + timeStep * densityRate - restDensity;
+                    data.errors[i] = glm::max(compression, 0.f) / restDensity;
+                    pressures[i] = glm::max(pressures[i] + pressureRelaxation * compression * data.factors[i] / dt2, 0.f);
+                }
+            });
+            for (float particleError : data.errors)
+            {
+                error += particleError;
+            }
+        }
+        pressureIterations++;
+        densityError = particleCount > 0 ? static_cast<float>(error / particleCount) : 0.f;
+        if (pressureIterations >= (divergenceFree ? 1u : 2u) && densityError <= pressureTolerance)
+        {
+            break;
+        }
+    }
+    return pressureIterations;
+}
+
+float ParticleSimulation::PrototypeGradientSum(KernelType type, float spacing)
+{
+    // Center of a 5x5 block, whose neighbors fill the support of 2 spacings
+    const ParticleSet prototype(5, 5, spacing, 1.f, 0.f, 0.f);
+    const glm::vec2 center = prototype.positions[2 * 5 + 2];
+    float sum = 0.f;
+    DispatchKernel<2>(type, spacing, [&](const auto &kernel) {
+        glm::vec2 gradientSum(0.f, 0.f);
+        float gradient2Sum = 0.f;
+        for (const glm::vec2 &position : prototype.positions)
+        {
+            const glm::vec2 gradient = kernel.Derivative(center, position);
+            gradientSum += gradient;
+            gradient2Sum += glm::dot(gradient, gradient);
+        }
+        sum = glm::dot(gradientSum, gradientSum) + gradient2Sum;
+    });
+    return sum;
+}
+
+// Predictive-corrective incompressible SPH (Solenthaler and Pajarola 2009): each iteration predicts the
+// positions after the step from the pressure accelerations of the current pressures, evaluates the
+// density there (with the neighbors of the current positions), and raises the pressure of each particle
+// by delta (rho* - rho_0). A uniform pressure p in a full neighborhood changes the density in a step by
+// -dt^2 m^2 2 p / rho_0^2 (|sum grad W|^2 + sum |grad W|^2), so delta is precomputed from a prototype
+// particle in the middle of a block of fluid at rest. Next to walls, whose particles do not push back, the
+// gradients of one side add up and a particle reacts to its own pressure more than the prototype: delta then
+// overshoots, and the iterations diverge near corners. The increment of each particle is therefore at most
+// half of the one that would remove its compression if it were alone, alpha_i / (2 dt^2) (see
+// UpdateSolverFactors), which is about delta in the bulk.
+void ParticleSimulation::SolvePCISPH(float timeStep) const
+{
+    const size_t particleCount = FluidParticleCount();
+    const bool hasField = !boundaryField.Empty();
+    const float dt2 = timeStep * timeStep;
+    UpdateSolverFactors();
+    for (size_t q = 0; q < particleSets.size(); q++)
+    {
+        ParticleSet *particleSet = particleSets[q];
+        if (particleSet->isBoundary)
+        {
+            continue;
+        }
+        SolverData &data = solverData[q];
+        if (data.prototypeKernel != kernelType || data.prototypeSpacing != particleSet->spacing)
+        {
+            data.prototypeKernel = kernelType;
+            data.prototypeSpacing = particleSet->spacing;
+            data.prototypeGradientSum = PrototypeGradientSum(kernelType, particleSet->spacing);
+        }
+        data.predictedPositions.resize(particleSet->size());
+        data.errors.resize(particleSet->size());
+        particleSet->pressures.assign(particleSet->size(), 0.f);
+    }
+
+    pressureIterations = 0;
+    densityError = 0.f;
+    while (pressureIterations < maxPressureIterations)
+    {
+        UpdatePressureAccelerations();
+        PredictVelocities(timeStep, true);
+        for (size_t q = 0; q < particleSets.size(); q++)
+        {
+            const ParticleSet *particleSet = particleSets[q];
+            if (!particleSet->isBoundary)
+            {
+                SolverData &data = solverData[q];
+                threadPool->ParallelFor(particleSet->size(), [&](size_t begin, size_t end, unsigned) {
+                    for (size_t i = begin; i < end; i++)
+                    {
+                        data.predictedPositions[i] = particleSet->positions[i] + timeStep * data.predictedVelocities[i];
+                    }
+                });
+            }
+        }
+        double error = 0.0;
+        for (size_t q = 0; q < particleSets.size(); q++)
+        {
+            ParticleSet *particleSet = particleSets[q];
+            if (particleSet->isBoundary)
+            {
+                continue;
+            }
+            const NeighborTable &table = neighborTables[q];
+            SolverData &data = solverData[q];
+            std::vector<float> &pressures = particleSet->pressures;
+            const float mass = particleSet->particleMass();
+            const float restDensity = particleSet->restDensity;
+            const float delta = data.prototypeGradientSum > 0.f ? restDensity * restDensity / (2.f * timeStep * timeStep * mass * mass * data.prototypeGradientSum) : 0.f;
+            DispatchKernel<2>(kernelType, particleSet->spacing, [&](const auto &kernel) {
+                threadPool->ParallelFor(particleSet->size(), [&](size_t begin, size_t end, unsigned) {
+                    for (size_t i = begin; i < end; i++)
+                    {
+                        float density = hasField ? boundaryField.Volume(data.predictedPositions[i]) / particleSet->particleVolume() : 0.f;
+                        for (size_t s = 0; s < particleSets.size(); s++)
+                        {
+                            if (!particleSets[s]->isBoundary)
+                            {
+                                const std::vector<glm::vec2> &otherPositions = solverData[s].predictedPositions;
+                                for (unsigned j : table.Neighbors(i, s))
+                                {
+                                    density += kernel.Function(data.predictedPositions[i], otherPositions[j]);
+                                }
+                            }
+                            else
+                            {
+                                // Boundaries do not move
+                                const std::vector<glm::vec2> &otherPositions = particleSets[s]->positions;
+                                const std::vector<float> &volumes = staticBoundary.Volumes(s);
+                                for (unsigned j : table.Neighbors(i, s))
+                                {
+                                    density += volumes[j] / particleSet->particleVolume() * kernel.Function(data.predictedPositions[i], otherPositions[j]);
+                                }
+                            }
+                        }
+                        const float compression = density * mass - restDensity;
+                        data.errors[i] = glm::max(compression, 0.f) / restDensity;
+                        pressures[i] = glm::max(pressures[i] + glm::min(delta, .5f * data.factors[i] / dt2) * compression, 0.f);
+                    }
+                });
+            });
+            for (float particleError : data.errors)
+            {
+                error += particleError;
+            }
+        }
+        pressureIterations++;
+        densityError = particleCount > 0 ? static_cast<float>(error / particleCount) : 0.f;
+        // At least three iterations, as in the original method
+        if (pressureIterations >= 3 && densityError <= pressureTolerance)
+        {
+            break;
+        }
+    }
+    AddPressureAccelerations();
+}
@@ -0,0 +1,99 @@
+#include "StaticBoundary.hpp"
+
+#include "ThreadPool.hpp" // ThreadPool
+#include <glm/common.hpp> // glm::max
+
+StaticBoundary::StaticBoundary()
+    : radius(0.f), volumesValid(false), volumeKernel(KernelType::CubicSpline)
+{
+}
+
+void StaticBoundary::Build(const std::vector<ParticleSet *> &particleSets, float radius, ThreadPool *threadPool)
+{
+    boundaries.assign(particleSets.size(), nullptr);
+    grids.resize(particleSets.size());
+    volumes.resize(particleSets.size());
+    // The cells also cover the kernel support of each boundary, searched when computing the volumes
+    float cellSize = radius;
+    for (auto &&particleSet : particleSets)
+    {
+        if (particleSet->isBoundary)
+        {
+            cellSize = glm::max(cellSize, 2.f * particleSet->spacing);
+        }
+    }
+    for (size_t s = 0; s < particleSets.size(); s++)
+    {
+        if (particleSets[s]->isBoundary)
+        {
+            boundaries[s] = particleSets[s];
+            const std::vector<glm::vec2> &positions = particleSets[s]->positions;
+            grids[s].Build(positions.data(), positions.size(), cellSize, threadPool);
+        }
+        else
+        {
+            grids[s] = NeighborGrid();
+            volumes[s].clear();
+        }
+    }
+    this->radius = radius;
+    volumesValid = false;
+}
+
+void StaticBoundary::Clear()
+{
+    boundaries.clear();
+    grids.clear();
+    volumes.clear();
+    radius = 0.f;
+    volumesValid = false;
+}
+
+bool StaticBoundary::Covers(float radius) const
+{
+    return this->radius > 0.f && radius <= this->radius;
+}
+
+void StaticBoundary::UpdateVolumes(KernelType type, ThreadPool *threadPool)
+{
+    if (volumesValid && volumeKernel == type)
+    {
+        return;
+    }
+    ThreadPool serial(1);
+    ThreadPool &pool = threadPool != nullptr ? *threadPool : serial;
+    for (size_t s = 0; s < boundaries.size(); s++)
+    {
+        const ParticleSet *boundary = boundaries[s];
+        if (boundary == nullptr)
+        {
+            continue;
+        }
+        const std::vector<glm::vec2> &positions = boundary->positions;
+        std::vector<float> &setVolumes = volumes[s];
+        setVolumes.resize(positions.size());
+        const float regularVolume = boundary->spacing * boundary->spacing;
+        DispatchKernel<2>(type, boundary->spacing, [&](const auto &kernel) {
+            pool.ParallelFor(positions.size(), [&](size_t begin, size_t end, unsigned) {
+                for (size_t b = begin; b < end; b++)
+                {
+                    // The particle itself is among its neighbors, so the sum is positive
+                    float sum = 0.f;
+                    for (size_t t = 0; t < boundaries.size(); t++)
+                    {
+                        if (boundaries[t] != nullptr)
+                        {
+                            const std::vector<glm::vec2> &otherPositions = boundaries[t]->positions;
+                            grids[t].ForEachNeighbor(positions[b], kernel.SupportRadius(), [&](unsigned k) {
+                                sum += kernel.Function(positions[b], otherPositions[k]);
+                            });
+                        }
+                    }
+                    setVolumes[b] = glm::min(1.f / sum, regularVolume);
+                }
+            });
+        });
+    }
+    volumeKernel = type;
+    volumesValid = true;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "KernelFunctions.hpp" // KernelType
+#include "NeighborGrid.hpp"
+#include "ParticleSet.hpp"
+#include <cstddef> // size_t
+#include <vector>  // std::vector
+
+class ThreadPool;
+
+// Boundary particle sets frozen in place. Since boundaries never move, their grids are built once, and
+// only fluid particles look for boundary neighbors. Each boundary particle gets the volume
+// V_b = 1 / sum_k W_bk over the particles of all boundaries (Akinci et al. 2012), so that overlapping
+// or densely sampled boundaries contribute to the density as much as the fluid they replace.
+// The volume is capped by spacing^2: walls are several layers thick, and the neighbors missing at
+// their surface are fluid particles, which would otherwise be counted twice.
+class StaticBoundary
+{
+public:
+    StaticBoundary();
+    // Freezes the boundary sets among `particleSets' (indexed like them) for searches within `radius'.
+    // The boundary particles must not move afterwards.
+    void Build(const std::vector<ParticleSet *> &particleSets, float radius, ThreadPool *threadPool = nullptr);
+    // Forgets all boundaries.
+    void Clear();
+    // Whether the boundaries are frozen for searches within `radius'.
+    bool Covers(float radius) const;
+    // Computes the volumes for the kernel `type', if not done yet.
+    void UpdateVolumes(KernelType type, ThreadPool *threadPool = nullptr);
+    // Grid of the boundary set `setIndex' (empty for fluid sets).
+    const NeighborGrid &Grid(size_t setIndex) const { return grids[setIndex]; }
+    // Volume of each particle of the boundary set `setIndex' (empty for fluid sets).
+    const std::vector<float> &Volumes(size_t setIndex) const { return volumes[setIndex]; }
+
+private:
+    std::vector<const ParticleSet *> boundaries; // Null for fluid sets.
+    std::vector<NeighborGrid> grids;
+    std::vector<std::vector<float>> volumes;
+    float radius; // Search radius of the grids, 0 if not built.
+    bool volumesValid;
+    KernelType volumeKernel;
+};
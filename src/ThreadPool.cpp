@@ -0,0 +1,91 @@
+#include "ThreadPool.hpp"
+
+#include "TraceRecorder.hpp" // MYSOLVER_TRACE_SCOPE
+
+ThreadPool::ThreadPool(unsigned threadCount)
+    : generation(0), busyWorkers(0), stopping(false), task(nullptr), taskBody(nullptr), taskCount(0)
+{
+    for (unsigned t = 1; t < threadCount; t++)
+    {
+        workers.emplace_back(&ThreadPool::WorkerLoop, this, t);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    for (auto &&worker : workers)
+    {
+        worker.join();
+    }
+}
+
+unsigned ThreadPool::ThreadCount() const
+{
+    return static_cast<unsigned>(workers.size()) + 1;
+}
+
+unsigned ThreadPool::HardwareThreadCount()
+{
+    const unsigned count = std::thread::hardware_concurrency();
+    return count > 0 ? count : 1;
+}
+
+void ThreadPool::Dispatch(size_t count, Task task, const void *body)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->task = task;
+        taskBody = body;
+        taskCount = count;
+        busyWorkers = static_cast<unsigned>(workers.size());
+        generation++;
+    }
+    wakeUp.notify_all();
+    // The calling thread takes the first chunk
+    RunChunk(0);
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this] { return busyWorkers == 0; });
+}
+
+void ThreadPool::RunChunk(unsigned threadIndex)
+{
+    const size_t threadCount = ThreadCount();
+    const size_t begin = taskCount * threadIndex / threadCount;
+    const size_t end = taskCount * (threadIndex + 1) / threadCount;
+    if (begin < end)
+    {
+        MYSOLVER_TRACE_SCOPE("Parallel chunk");
+        task(taskBody, begin, end, threadIndex);
+    }
+}
+
+void ThreadPool::WorkerLoop(unsigned threadIndex)
+{
+    unsigned long lastGeneration = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeUp.wait(lock, [&] { return stopping || generation != lastGeneration; });
+            if (stopping)
+            {
+                return;
+            }
+            lastGeneration = generation;
+        }
+        RunChunk(threadIndex);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            busyWorkers--;
+            if (busyWorkers == 0)
+            {
+                finished.notify_one();
+            }
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <condition_variable> // std::condition_variable
+#include <cstddef>            // size_t
+#include <mutex>              // std::mutex
+#include <thread>             // std::thread
+#include <vector>             // std::vector
+
+// Persistent pool of worker threads that share the iterations of a loop.
+// Threads are started once by the constructor and sleep between loops; synchronization only happens
+// when a loop starts and ends, never inside the loop body.
+class ThreadPool
+{
+public:
+    // Starts `threadCount - 1' worker threads: the thread calling ParallelFor is the remaining one.
+    explicit ThreadPool(unsigned threadCount);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    unsigned ThreadCount() const;
+    // Splits [0, count) into one contiguous chunk per thread and calls `body(begin, end, threadIndex)'
+    // for each chunk, in parallel. Returns when all chunks are done.
+    // Chunks only depend on `count' and on the number of threads, so results are reproducible.
+    template <typename Body>
+    void ParallelFor(size_t count, const Body &body);
+    // Number of hardware threads (at least 1).
+    static unsigned HardwareThreadCount();
+
+private:
+    using Task = void (*)(const void *body, size_t begin, size_t end, unsigned threadIndex);
+    // Runs `task' on all threads and waits for its completion.
+    void Dispatch(size_t count, Task task, const void *body);
+    // Runs the chunk of the current task that belongs to a thread.
+    void RunChunk(unsigned threadIndex);
+    void WorkerLoop(unsigned threadIndex);
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wakeUp;   // Signals workers that a task is available (or that the pool stops).
+    std::condition_variable finished; // Signals the calling thread that all workers are done.
+    unsigned long generation;         // Incremented for each task.
+    unsigned busyWorkers;
+    bool stopping;
+    // Current task
+    Task task;
+    const void *taskBody;
+    size_t taskCount;
+};
+
+template <typename Body>
+void ThreadPool::ParallelFor(size_t count, const Body &body)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    if (workers.empty())
+    {
+        body(size_t(0), count, 0u);
+        return;
+    }
+    Dispatch(
+        count, [](const void *body, size_t begin, size_t end, unsigned threadIndex) {
+            (*static_cast<const Body *>(body))(begin, end, threadIndex);
+        },
+        &body);
+}
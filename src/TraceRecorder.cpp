@@ -0,0 +1,205 @@
+#include "TraceRecorder.hpp"
+
+#include <cstdio>    // std::snprintf
+#include <iostream>  // std::cerr
+#include <stdexcept> // std::runtime_error
+
+namespace
+{
+    double Microseconds(TraceRecorder::Clock::duration duration)
+    {
+        return std::chrono::duration<double, std::micro>(duration).count();
+    }
+} // namespace
+
+TraceRecorder::ThreadBuffer::ThreadBuffer(unsigned threadId)
+    : events(bufferSize), head(0), tail(0), dropped(0), owned(true), threadId(threadId), hasEvents(false)
+{
+}
+
+TraceRecorder::TraceRecorder()
+    : recording(false), firstEvent(true), stopping(false)
+{
+}
+
+TraceRecorder::~TraceRecorder()
+{
+    Stop();
+}
+
+TraceRecorder &TraceRecorder::Global()
+{
+    static TraceRecorder recorder;
+    return recorder;
+}
+
+void TraceRecorder::Start(const std::string &path)
+{
+    Stop();
+    file.open(path);
+    if (!file)
+    {
+        throw std::runtime_error("cannot open trace file " + path);
+    }
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    firstEvent = true;
+    origin = Clock::now();
+    {
+        // Discard what was recorded after the previous Stop
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        for (auto &&buffer : buffers)
+        {
+            buffer->tail.store(buffer->head.load(std::memory_order_acquire), std::memory_order_release);
+            buffer->dropped.store(0, std::memory_order_relaxed);
+            buffer->hasEvents = false;
+        }
+    }
+    stopping = false;
+    flushThread = std::thread(&TraceRecorder::FlushLoop, this);
+    recording.store(true, std::memory_order_release);
+}
+
+void TraceRecorder::Stop()
+{
+    if (!flushThread.joinable())
+    {
+        return;
+    }
+    recording.store(false, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(flushMutex);
+        stopping = true;
+    }
+    flushWakeUp.notify_one();
+    flushThread.join();
+    Flush();
+    const unsigned long dropped = DroppedEventCount();
+    if (dropped > 0)
+    {
+        std::cerr << "Trace: " << dropped << " events dropped, the buffers of their threads were full" << std::endl;
+    }
+    // Name the threads that recorded after their order of appearance
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    for (auto &&buffer : buffers)
+    {
+        if (!buffer->hasEvents)
+        {
+            continue;
+        }
+        file << (firstEvent ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId
+             << ",\"args\":{\"name\":\"Thread " << buffer->threadId << "\"}}";
+        firstEvent = false;
+    }
+    file << "\n]}\n";
+    file.close();
+}
+
+void TraceRecorder::Record(const char *name, Clock::time_point begin, Clock::time_point end)
+{
+    ThreadBuffer &buffer = LocalBuffer();
+    const size_t head = buffer.head.load(std::memory_order_relaxed);
+    if (head - buffer.tail.load(std::memory_order_acquire) == bufferSize)
+    {
+        buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    buffer.events[head & (bufferSize - 1)] = Event{name, begin, end};
+    buffer.head.store(head + 1, std::memory_order_release);
+}
+
+unsigned long TraceRecorder::DroppedEventCount() const
+{
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    unsigned long count = 0;
+    for (auto &&buffer : buffers)
+    {
+        count += buffer->dropped.load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
+size_t TraceRecorder::BufferCount() const
+{
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    return buffers.size();
+}
+
+TraceRecorder::ThreadBuffer &TraceRecorder::LocalBuffer()
+{
+    // Gives the buffer back when the thread exits. The next thread appends to it after the events of the
+    // exited one that are not written yet: there is still a single producer at a time.
+    struct Owner
+    {
+        ThreadBuffer *buffer = nullptr;
+        ~Owner()
+        {
+            if (buffer != nullptr)
+            {
+                buffer->owned.store(false, std::memory_order_release);
+            }
+        }
+    };
+    thread_local Owner owner;
+    if (owner.buffer == nullptr)
+    {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        for (auto &&buffer : buffers)
+        {
+            if (!buffer->owned.load(std::memory_order_acquire))
+            {
+                buffer->owned.store(true, std::memory_order_relaxed);
+                owner.buffer = buffer.get();
+                break;
+            }
+        }
+        if (owner.buffer == nullptr)
+        {
+            buffers.emplace_back(new ThreadBuffer(static_cast<unsigned>(buffers.size())));
+            owner.buffer = buffers.back().get();
+        }
+    }
+    return *owner.buffer;
+}
+
+void TraceRecorder::FlushLoop()
+{
+    std::unique_lock<std::mutex> lock(flushMutex);
+    while (!stopping)
+    {
+        flushWakeUp.wait_for(lock, std::chrono::milliseconds(100));
+        lock.unlock();
+        Flush();
+        lock.lock();
+    }
+}
+
+void TraceRecorder::Flush()
+{
+    // Buffers are only appended to the list, so the ones present now stay valid while writing
+    std::vector<ThreadBuffer *> currentBuffers;
+    {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        for (auto &&buffer : buffers)
+        {
+            currentBuffers.push_back(buffer.get());
+        }
+    }
+    char line[256];
+    for (ThreadBuffer *buffer : currentBuffers)
+    {
+        const size_t tail = buffer->tail.load(std::memory_order_relaxed);
+        const size_t head = buffer->head.load(std::memory_order_acquire);
+        for (size_t k = tail; k != head; k++)
+        {
+            const Event &event = buffer->events[k & (bufferSize - 1)];
+            std::snprintf(line, sizeof(line), "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                          firstEvent ? "" : ",", event.name, buffer->threadId,
+                          Microseconds(event.begin - origin), Microseconds(event.end - event.begin));
+            file << line;
+            firstEvent = false;
+            buffer->hasEvents = true;
+        }
+        buffer->tail.store(head, std::memory_order_release);
+    }
+    file.flush();
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>             // std::atomic
+#include <chrono>             // std::chrono::steady_clock
+#include <condition_variable> // std::condition_variable
+#include <cstddef>            // size_t
+#include <fstream>            // std::ofstream
+#include <memory>             // std::unique_ptr
+#include <mutex>              // std::mutex
+#include <string>             // std::string
+#include <thread>             // std::thread
+#include <vector>             // std::vector
+
+// Records timed scopes of all threads into a Chrome trace-event JSON file, which chrome://tracing and
+// Perfetto can open. Recording is off until Start.
+// Each thread writes its events into its own ring buffer without locks (a single producer, the thread,
+// and a single consumer, the flush thread), and a background thread periodically writes the buffers to
+// the file. When a buffer is full, new events of its thread are dropped and counted. The buffer of a thread
+// that exits goes to the next new thread, so that recreating thread pools does not add buffers.
+// Scopes are written as complete events (begin and duration), so that a dropped event cannot leave a
+// begin without its end.
+class TraceRecorder
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // The recorder of the program.
+    static TraceRecorder &Global();
+    ~TraceRecorder();
+    TraceRecorder(const TraceRecorder &) = delete;
+    TraceRecorder &operator=(const TraceRecorder &) = delete;
+
+    // Starts recording into the file at `path' (throws if it cannot be opened).
+    void Start(const std::string &path);
+    // Stops recording, writes the remaining events and closes the file (and reports dropped events).
+    void Stop();
+    bool IsRecording() const { return recording.load(std::memory_order_relaxed); }
+    // Records a scope of the calling thread. `name' must outlive the recorder (typically a literal).
+    void Record(const char *name, Clock::time_point begin, Clock::time_point end);
+    // Number of events dropped because a buffer was full, since Start.
+    unsigned long DroppedEventCount() const;
+    // Number of thread buffers: at most the number of threads that recorded at the same time.
+    size_t BufferCount() const;
+
+private:
+    struct Event
+    {
+        const char *name;
+        Clock::time_point begin, end;
+    };
+    // Single-producer single-consumer ring buffer of the events of a thread.
+    struct ThreadBuffer
+    {
+        explicit ThreadBuffer(unsigned threadId);
+        std::vector<Event> events; // Power-of-two size.
+        std::atomic<size_t> head;  // Next event to write, only modified by the thread.
+        std::atomic<size_t> tail;  // Next event to read, only modified by the flush thread.
+        std::atomic<unsigned long> dropped;
+        std::atomic<bool> owned; // Whether a running thread records into the buffer.
+        unsigned threadId;
+        bool hasEvents; // Since Start, only accessed by the flush thread and by Stop.
+    };
+    static const size_t bufferSize = 1 << 16;
+
+    TraceRecorder();
+    // Buffer of the calling thread, taken at its first event from the ones of exited threads, or created.
+    ThreadBuffer &LocalBuffer();
+    void FlushLoop();
+    // Writes the events of all buffers to the file.
+    void Flush();
+
+private:
+    std::atomic<bool> recording;
+    Clock::time_point origin;
+    std::ofstream file;
+    bool firstEvent;
+    mutable std::mutex buffersMutex; // Protects the list of buffers (not their content).
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    std::thread flushThread;
+    std::mutex flushMutex;
+    std::condition_variable flushWakeUp;
+    bool stopping;
+};
+
+// Records its scope into TraceRecorder::Global() when it is recording.
+class TraceScope
+{
+public:
+    explicit TraceScope(const char *name)
+        : name(TraceRecorder::Global().IsRecording() ? name : nullptr)
+    {
+        if (this->name != nullptr)
+        {
+            begin = TraceRecorder::Clock::now();
+        }
+    }
+    ~TraceScope()
+    {
+        if (name != nullptr)
+        {
+            TraceRecorder::Global().Record(name, begin, TraceRecorder::Clock::now());
+        }
+    }
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    const char *name;
+    TraceRecorder::Clock::time_point begin;
+};
+
+// Traces the rest of the enclosing scope under `name'. Compiled out with the phase timers.
+#ifdef MYSOLVER_PHASE_TIMERS
+#define MYSOLVER_TRACE_SCOPE(name) MYSOLVER_TRACE_SCOPE_AT(name, __LINE__)
+#define MYSOLVER_TRACE_SCOPE_AT(name, line) MYSOLVER_TRACE_SCOPE_NAMED(name, line)
+#define MYSOLVER_TRACE_SCOPE_NAMED(name, line) TraceScope traceScope##line(name)
+#else
+#define MYSOLVER_TRACE_SCOPE(name)
+#endif
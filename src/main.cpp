@@ -2,18 +2,327 @@
  * main
  * 
  * Entry point to the program.
- * Starts an Experiment and catches all exceptions.
+ * Parses the command line, starts an Experiment and catches all exceptions.
  */
 
 #include "BoundaryExperiment.hpp"
-#include <iostream> // std::cerr
+#include "Kernel.hpp"             // Kernel::FromName
+#include "KernelBatch.hpp"        // KernelBatch::DetectedLevel
+#include "ParticleSimulation.hpp" // ParticleSimulation::PressureSolverFromName
+#include "ThreadPool.hpp"         // ThreadPool::HardwareThreadCount
+#include "TraceRecorder.hpp"      // TraceRecorder
+#include <iostream>               // std::cerr, std::cout
+#include <stdexcept>              // std::invalid_argument
+#include <string>                 // std::string, std::stoul, std::stol, std::stof, std::to_string
+#include <vector>                 // std::vector
+
+static void PrintUsage(const char *program)
+{
+    std::cout << "Usage: " << program << " [options]" << std::endl
+              << "Options:" << std::endl
+              << "  --threads N        Number of threads used by the simulation (default: 1, at most 4 per hardware thread)" << std::endl
+              << "  --verlet-skin F    Reuse neighbor lists with a skin of F times the particle spacing (default: 0)" << std::endl
+              << "  --pairwise         Evaluate the forces once per pair of fluid particles" << std::endl
+              << "  --kernel NAME      SPH kernel: cubic-spline (default), wendland-c2, wendland-c4 or poly6-spiky" << std::endl
+              << "  --kernel-table N   Evaluate the kernel from a table of N samples (default: 0, analytic)" << std::endl
+              << "  --kernel-interpolation linear|cubic" << std::endl
+              << "                     Interpolation between the samples of the kernel table (default: linear)" << std::endl
+              << "  --simd LEVEL       Evaluate the cubic spline in batches: scalar (default), sse2, avx2, avx512 or native" << std::endl
+              << "  --time-step F      Time step, or largest adaptive time step (default: 0.01)" << std::endl
+              << "  --adaptive-time-step" << std::endl
+              << "                     Choose each time step from the CFL, force and viscous constraints" << std::endl
+              << "  --pressure-solver NAME" << std::endl
+              << "                     Pressure model: state-equation (default), iisph, dfsph or pcisph" << std::endl
+              << "  --pressure-tolerance F" << std::endl
+              << "                     Average density error at which the iterative pressure solvers stop (default: 0.001)" << std::endl
+              << "  --max-pressure-iterations N" << std::endl
+              << "                     Iteration limit of the iterative pressure solvers (default: 100)" << std::endl
+              << "  --sdf-boundaries   Model the walls by signed distance field boxes instead of boundary particles" << std::endl
+              << "  --hydrostatic      Start the fluid at hydrostatic pressure (compressed for the state equation)" << std::endl
+              << "  --relaxation-steps N" << std::endl
+              << "                     Let the fluid settle for N damped steps before t = 0 (default: 0)" << std::endl
+              << "  --relaxation-time-step F" << std::endl
+              << "                     Time step of the relaxation (default: the time step)" << std::endl
+              << "  --history-particles I,J,..." << std::endl
+              << "                     Indices of the particles whose history is recorded (default: 0; all: empty list)" << std::endl
+              << "  --history-capacity N" << std::endl
+              << "                     Recent samples of each history, older ones being decimated (default: 512; 0: unbounded)" << std::endl
+              << "  --record FILE      Stream the state of the fluid at every step into a columnar history file" << std::endl
+              << "  --load-checkpoint FILE" << std::endl
+              << "                     Resume the simulation saved in FILE, with the settings of the command line" << std::endl
+              << "  --save-checkpoint FILE" << std::endl
+              << "                     Save the simulation to FILE when it is closed" << std::endl
+              << "  --checkpoint-neighbors" << std::endl
+              << "                     Also save the neighbor lists, which the resumed simulation reuses with a Verlet skin" << std::endl
+              << "  --snapshot FILE    Save the simulation to FILE periodically, from a forked process (see --snapshot-interval)" << std::endl
+              << "  --snapshot-interval N" << std::endl
+              << "                     Steps between two snapshots (default: 1000)" << std::endl
+              << "  --snapshot-sync    Save the snapshots from the simulation thread, which pauses until they are written" << std::endl
+              << "  --headless         Run the simulation without visualization and print its throughput" << std::endl
+              << "  --steps N          Number of simulation steps of the headless mode (default: 1000)" << std::endl
+              << "  --trace FILE       Record the phases of the simulation and of the rendering into a Chrome trace file" << std::endl
+              << "  --help             Print this message" << std::endl;
+}
+
+// Comma-separated list of indices given on the command line.
+static std::vector<size_t> ParseIndices(const std::string &list)
+{
+    std::vector<size_t> indices;
+    size_t begin = 0;
+    while (begin < list.size())
+    {
+        size_t end = list.find(',', begin);
+        end = end == std::string::npos ? list.size() : end;
+        indices.push_back(std::stoul(list.substr(begin, end - begin)));
+        begin = end + 1;
+    }
+    return indices;
+}
+
+// Number of threads given on the command line: at least 1, and at most 4 per hardware thread.
+static unsigned ParseThreadCount(const std::string &value)
+{
+    const long count = std::stol(value);
+    if (count < 1)
+    {
+        throw std::invalid_argument("the number of threads must be at least 1, not " + value);
+    }
+    const long maximum = 4l * ThreadPool::HardwareThreadCount();
+    if (count > maximum)
+    {
+        std::cerr << "Warning: " << count << " threads requested, using " << maximum
+                  << " (4 per hardware thread)" << std::endl;
+        return static_cast<unsigned>(maximum);
+    }
+    return static_cast<unsigned>(count);
+}
+
+// Instruction set given on the command line ("native" for the best one of the CPU).
+static SimdLevel ParseSimdLevel(const std::string &name)
+{
+    if (name == "native")
+    {
+        return KernelBatch::DetectedLevel();
+    }
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512})
+    {
+        if (name == KernelBatch::Name(level))
+        {
+            return level;
+        }
+    }
+    throw std::invalid_argument("unknown instruction set " + name);
+}
 
 int main(int argc, char *argv[])
 {
     try
     {
+        unsigned threadCount = 1;
+        float verletSkin = 0.f;
+        bool pairwiseForces = false;
+        KernelType kernelType = KernelType::CubicSpline;
+        unsigned kernelTableResolution = 0;
+        KernelInterpolation kernelInterpolation = KernelInterpolation::Linear;
+        SimdLevel simdLevel = SimdLevel::Scalar;
+        float timeStep = .01f;
+        bool adaptiveTimeStep = false;
+        PressureSolver pressureSolver = PressureSolver::StateEquation;
+        float pressureTolerance = 1e-3f;
+        unsigned maxPressureIterations = 100;
+        bool sdfBoundaries = false;
+        bool hydrostatic = false;
+        unsigned relaxationSteps = 0;
+        float relaxationTimeStep = 0.f;
+        std::vector<size_t> historyParticles{0};
+        unsigned long historyCapacity = 512;
+        bool headless = false;
+        unsigned long steps = 1000;
+        std::string tracePath;
+        std::string recordPath;
+        std::string loadCheckpointPath, saveCheckpointPath;
+        bool checkpointNeighbors = false;
+        std::string snapshotPath;
+        unsigned long snapshotInterval = 1000;
+        bool forkedSnapshots = true;
+        for (int i = 1; i < argc; i++)
+        {
+            const std::string argument(argv[i]);
+            if (argument == "--threads" && i + 1 < argc)
+            {
+                threadCount = ParseThreadCount(argv[++i]);
+            }
+            else if (argument == "--verlet-skin" && i + 1 < argc)
+            {
+                verletSkin = std::stof(argv[++i]);
+            }
+            else if (argument == "--pairwise")
+            {
+                pairwiseForces = true;
+            }
+            else if (argument == "--kernel" && i + 1 < argc)
+            {
+                kernelType = Kernel::FromName(argv[++i]);
+            }
+            else if (argument == "--kernel-table" && i + 1 < argc)
+            {
+                kernelTableResolution = std::stoul(argv[++i]);
+            }
+            else if (argument == "--kernel-interpolation" && i + 1 < argc && std::string(argv[i + 1]) == "linear")
+            {
+                kernelInterpolation = KernelInterpolation::Linear;
+                i++;
+            }
+            else if (argument == "--kernel-interpolation" && i + 1 < argc && std::string(argv[i + 1]) == "cubic")
+            {
+                kernelInterpolation = KernelInterpolation::Cubic;
+                i++;
+            }
+            else if (argument == "--simd" && i + 1 < argc)
+            {
+                simdLevel = ParseSimdLevel(argv[++i]);
+            }
+            else if (argument == "--time-step" && i + 1 < argc)
+            {
+                timeStep = std::stof(argv[++i]);
+            }
+            else if (argument == "--adaptive-time-step")
+            {
+                adaptiveTimeStep = true;
+            }
+            else if (argument == "--pressure-solver" && i + 1 < argc)
+            {
+                pressureSolver = ParticleSimulation::PressureSolverFromName(argv[++i]);
+            }
+            else if (argument == "--pressure-tolerance" && i + 1 < argc)
+            {
+                pressureTolerance = std::stof(argv[++i]);
+            }
+            else if (argument == "--max-pressure-iterations" && i + 1 < argc)
+            {
+                maxPressureIterations = std::stoul(argv[++i]);
+            }
+            else if (argument == "--sdf-boundaries")
+            {
+                sdfBoundaries = true;
+            }
+            else if (argument == "--hydrostatic")
+            {
+                hydrostatic = true;
+            }
+            else if (argument == "--relaxation-steps" && i + 1 < argc)
+            {
+                relaxationSteps = std::stoul(argv[++i]);
+            }
+            else if (argument == "--relaxation-time-step" && i + 1 < argc)
+            {
+                relaxationTimeStep = std::stof(argv[++i]);
+            }
+            else if (argument == "--history-particles" && i + 1 < argc)
+            {
+                historyParticles = ParseIndices(argv[++i]);
+            }
+            else if (argument == "--history-capacity" && i + 1 < argc)
+            {
+                historyCapacity = std::stoul(argv[++i]);
+            }
+            else if (argument == "--record" && i + 1 < argc)
+            {
+                recordPath = argv[++i];
+            }
+            else if (argument == "--load-checkpoint" && i + 1 < argc)
+            {
+                loadCheckpointPath = argv[++i];
+            }
+            else if (argument == "--save-checkpoint" && i + 1 < argc)
+            {
+                saveCheckpointPath = argv[++i];
+            }
+            else if (argument == "--checkpoint-neighbors")
+            {
+                checkpointNeighbors = true;
+            }
+            else if (argument == "--snapshot" && i + 1 < argc)
+            {
+                snapshotPath = argv[++i];
+            }
+            else if (argument == "--snapshot-interval" && i + 1 < argc)
+            {
+                snapshotInterval = std::stoul(argv[++i]);
+            }
+            else if (argument == "--snapshot-sync")
+            {
+                forkedSnapshots = false;
+            }
+            else if (argument == "--headless")
+            {
+                headless = true;
+            }
+            else if (argument == "--steps" && i + 1 < argc)
+            {
+                steps = std::stoul(argv[++i]);
+            }
+            else if (argument == "--trace" && i + 1 < argc)
+            {
+                tracePath = argv[++i];
+            }
+            else if (argument == "--help")
+            {
+                PrintUsage(argv[0]);
+                return EXIT_SUCCESS;
+            }
+            else
+            {
+                PrintUsage(argv[0]);
+                throw std::invalid_argument("unknown or incomplete option " + argument);
+            }
+        }
+
         BoundaryExperiment boundaryExperiment;
-        boundaryExperiment.Run();
+        boundaryExperiment.SetSdfBoundaries(sdfBoundaries);
+        boundaryExperiment.SetHistoryBounds(historyParticles, historyCapacity);
+        boundaryExperiment.SetThreadCount(threadCount);
+        boundaryExperiment.SetVerletSkin(verletSkin);
+        boundaryExperiment.SetPairwiseForces(pairwiseForces);
+        boundaryExperiment.SetKernel(kernelType);
+        boundaryExperiment.SetKernelTable(kernelTableResolution, kernelInterpolation);
+        boundaryExperiment.SetSimdLevel(simdLevel);
+        boundaryExperiment.SetTimeStep(timeStep);
+        boundaryExperiment.SetAdaptiveTimeStep(adaptiveTimeStep);
+        boundaryExperiment.SetPressureSolver(pressureSolver);
+        boundaryExperiment.SetPressureTolerance(pressureTolerance);
+        boundaryExperiment.SetMaxPressureIterations(maxPressureIterations);
+        if (hydrostatic || relaxationSteps > 0)
+        {
+            // Resets the scene, with the settings above
+            boundaryExperiment.SetInitialization(hydrostatic, relaxationSteps, relaxationTimeStep);
+        }
+        if (!loadCheckpointPath.empty())
+        {
+            boundaryExperiment.LoadCheckpoint(loadCheckpointPath);
+        }
+        boundaryExperiment.SetCheckpointOnClose(saveCheckpointPath, checkpointNeighbors);
+        if (!snapshotPath.empty())
+        {
+            boundaryExperiment.SetSnapshots(snapshotPath, snapshotInterval, checkpointNeighbors, forkedSnapshots);
+        }
+        if (!recordPath.empty())
+        {
+            boundaryExperiment.StartRecording(recordPath);
+        }
+        if (!tracePath.empty())
+        {
+            TraceRecorder::Global().Start(tracePath);
+        }
+        if (headless)
+        {
+            boundaryExperiment.RunHeadless(steps);
+        }
+        else
+        {
+            boundaryExperiment.Run();
+        }
+        TraceRecorder::Global().Stop();
     }
     catch (const std::exception &e)
     {
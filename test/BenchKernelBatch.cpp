@@ -0,0 +1,62 @@
+#include "catch_amalgamated.hpp"
+
+#include <glm/trigonometric.hpp> // glm::cos, glm::sin
+#include <random>                // std::mt19937
+#include <vector>                // std::vector
+// Benchmarked files
+#include <KernelBatch.hpp>
+#include <KernelFunctions.hpp>
+
+// Micro-benchmarks of the batched kernels, hidden from the default run:
+//     ./testmain "[benchmark]"
+// Build with -DCMAKE_BUILD_TYPE=Release for meaningful numbers.
+TEST_CASE("Kernel evaluation for rows of neighbors", "[.][benchmark]")
+{
+    const float h = 1.f;
+    const CubicSplineKernel<2> kernel(h);
+    // Rows of jittered neighbors within the support, of a typical length
+    const size_t rowLength = 21, rowCount = 1000;
+    std::mt19937 generator(1234);
+    std::uniform_real_distribution<float> distance(0.f, 2.f * h), angle(0.f, 6.2832f);
+    std::vector<float> x(rowLength * rowCount), y(rowLength * rowCount);
+    for (size_t k = 0; k < x.size(); k++)
+    {
+        const float r = distance(generator), theta = angle(generator);
+        x[k] = r * glm::cos(theta);
+        y[k] = r * glm::sin(theta);
+    }
+    std::vector<float> values(rowLength), gradientX(rowLength), gradientY(rowLength);
+
+    BENCHMARK("scalar CubicSplineKernel<2>")
+    {
+        float sum = 0.f;
+        for (size_t row = 0; row < rowCount; row++)
+        {
+            for (size_t k = row * rowLength; k < (row + 1) * rowLength; k++)
+            {
+                sum += kernel.Function(glm::vec2(0.f, 0.f), glm::vec2(x[k], y[k]));
+                sum += kernel.Derivative(glm::vec2(0.f, 0.f), glm::vec2(x[k], y[k])).x;
+            }
+        }
+        return sum;
+    };
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512})
+    {
+        const KernelBatch batch(h, level);
+        if (batch.Level() != level)
+        {
+            continue; // Not supported by this CPU
+        }
+        BENCHMARK(std::string("KernelBatch ") + KernelBatch::Name(level))
+        {
+            float sum = 0.f;
+            for (size_t row = 0; row < rowCount; row++)
+            {
+                batch.Function(0.f, 0.f, &x[row * rowLength], &y[row * rowLength], rowLength, values.data());
+                batch.Derivative(0.f, 0.f, &x[row * rowLength], &y[row * rowLength], rowLength, gradientX.data(), gradientY.data());
+                sum += values[0] + gradientX[0];
+            }
+            return sum;
+        };
+    }
+}
@@ -0,0 +1,84 @@
+#include "catch_amalgamated.hpp" // Test framework
+
+// Tested files
+#include <HistoryFile.hpp>
+#include <HistoryRecorder.hpp>
+#include <ParticleSet.hpp>
+#include <ParticleSimulation.hpp>
+// Libraries
+#include <cstdint>   // uintptr_t
+#include <cstdio>    // std::remove
+#include <stdexcept> // std::runtime_error
+#include <string>    // std::string
+#include <vector>    // std::vector
+
+using namespace Catch; // Test framework
+
+TEST_CASE("The history recorder streams every step into a mappable columnar file", "[history]")
+{
+    const std::string path = "test-history.bin";
+    ParticleSet fluid(7, 5, 3.f, 3e3f, 4e7f, 2e-7f);
+    ParticleSimulation particleSimulation;
+    particleSimulation.AddParticleSet(fluid);
+    HistoryRecorder recorder;
+    recorder.Start(path, fluid, 16 * HistoryFile::StepSize(fluid.size()), 2);
+    REQUIRE(recorder.IsRecording());
+    // Incomplete until stopped
+    REQUIRE_THROWS_AS(HistoryFile(path), std::runtime_error);
+    std::vector<ParticleSet> states;
+    const int steps = 50;
+    for (int step = 0; step < steps; step++)
+    {
+        particleSimulation.UpdateNeighbors(2.f * 3.f);
+        particleSimulation.UpdateParticleQuantities(glm::vec2(0.f, -9.81f));
+        particleSimulation.UpdateParticlePositions(1e-3f);
+        recorder.Record(1e-3f * (step + 1));
+        states.push_back(fluid);
+    }
+    REQUIRE(recorder.StepCount() == steps);
+    // The writer can fall behind, but the buffers stay capped
+    REQUIRE(recorder.BufferCount() == 2);
+    recorder.Stop();
+    REQUIRE_FALSE(recorder.IsRecording());
+
+    {
+        const HistoryFile history(path);
+        REQUIRE(history.StepCount() == steps);
+        REQUIRE(history.ParticleCount() == fluid.size());
+        // 3 full chunks and a partial one
+        REQUIRE(history.ChunkCount() == 4);
+        for (int step = 0; step < steps; step++)
+        {
+            const ParticleSet &state = states[step];
+            REQUIRE(history.Time(step) == 1e-3f * (step + 1));
+            const float *positionX = history.Column(step, HistoryColumn::PositionX);
+            const float *velocityY = history.Column(step, HistoryColumn::VelocityY);
+            const float *density = history.Column(step, HistoryColumn::Density);
+            const float *otherAccelerationY = history.Column(step, HistoryColumn::OtherAccelerationsY);
+            if (step % 16 == 0)
+            {
+                REQUIRE(reinterpret_cast<uintptr_t>(density) % 64 == 0);
+            }
+            for (size_t i = 0; i < fluid.size(); i++)
+            {
+                REQUIRE(positionX[i] == state.positions[i].x);
+                REQUIRE(velocityY[i] == state.velocities[i].y);
+                REQUIRE(density[i] == state.densities[i]);
+                REQUIRE(otherAccelerationY[i] == state.otherAccelerations[i].y);
+            }
+        }
+        REQUIRE_THROWS_AS(history.Time(steps), std::out_of_range);
+    }
+    std::remove(path.c_str());
+}
+
+TEST_CASE("The history recorder sizes its chunks from a byte budget", "[history]")
+{
+    const size_t stepSize = HistoryFile::StepSize(100);
+    REQUIRE(stepSize == (1 + 12 * 100) * sizeof(float));
+    REQUIRE(HistoryRecorder::StepsPerChunk(64 * stepSize, 100) == 64);
+    REQUIRE(HistoryRecorder::StepsPerChunk(64 * stepSize - 1, 100) == 63);
+    // At least 1 step, whatever the budget
+    REQUIRE(HistoryRecorder::StepsPerChunk(stepSize / 2, 100) == 1);
+    REQUIRE(HistoryRecorder::StepsPerChunk(0, 100) == 1);
+}
@@ -1,5 +1,7 @@
 #include "catch_amalgamated.hpp"
 
+#include <algorithm>               // std::max
+#include <cmath>                   // std::fabs
 #include <iostream>
 #include <limits>                  // std::numeric_limits
 #include <cstdlib>                 // Random
@@ -8,6 +10,8 @@
 #include <iomanip>                 // std::setw()
 // Tested files
 #include <Kernel.hpp>
+#include <KernelBatch.hpp>
+#include <KernelTable.hpp>
 #include <ParticleSet.hpp>
 #include <ParticleSimulation.hpp>
 // #include "test-algorithms.hpp"
@@ -57,9 +61,9 @@ TEST_CASE("Kernel function", "[kernel]")
         for (size_t i = 0; i < particleSet.particles.size(); ++i)
         {
             float kernelSum(0.f);
-            for (auto &&neighbor : particleSimulation.GetNeighbors(particleSet.particles.at(i)))
+            for (unsigned j : particleSimulation.GetNeighborTable(0).Neighbors(i, 0))
             {
-                kernelSum += kernel.Function(particleSet.particles.at(i).position, neighbor->position);
+                kernelSum += kernel.Function(particleSet.particles.at(i).position, particleSet.particles.at(j).position);
             }
 
             bool is_top_or_bottom = (i < 5 || i > 19);
@@ -135,9 +139,9 @@ TEST_CASE("Kernel derivative", "[kernel]")
         for (size_t i = 0; i < particleSet.particles.size(); ++i)
         {
             glm::vec2 kernelSum(0.f, 0.f);
-            for (auto &&neighbor : particleSimulation.GetNeighbors(particleSet.particles.at(i)))
+            for (unsigned j : particleSimulation.GetNeighborTable(0).Neighbors(i, 0))
             {
-                kernelSum += kernel.Derivative(particleSet.particles.at(i).position, neighbor->position);
+                kernelSum += kernel.Derivative(particleSet.particles.at(i).position, particleSet.particles.at(j).position);
             }
 
             bool is_top_or_bottom = (i < 5 || i > 19);
@@ -169,3 +173,182 @@ TEST_CASE("Kernel derivative", "[kernel]")
         }
     }
 }
+
+// Integral of f(W, x) over the support of a kernel, approximated by the midpoint rule on a regular grid.
+template <typename KernelFunction, typename Integrand>
+static double IntegrateOverSupport(const KernelFunction &kernel, int stepsPerAxis, Integrand integrand)
+{
+    using Vector = typename KernelFunction::Vector;
+    const int dim = KernelFunction::dimension;
+    const float radius = kernel.SupportRadius();
+    const float step = 2.f * radius / stepsPerAxis;
+    double cellVolume = 1.;
+    long cellCount = 1;
+    for (int d = 0; d < dim; d++)
+    {
+        cellVolume *= step;
+        cellCount *= stepsPerAxis;
+    }
+    const Vector origin(0.f);
+    double sum = 0.;
+    for (long cell = 0; cell < cellCount; cell++)
+    {
+        Vector position;
+        long index = cell;
+        for (int d = 0; d < dim; d++)
+        {
+            position[d] = -radius + (index % stepsPerAxis + .5f) * step;
+            index /= stepsPerAxis;
+        }
+        sum += integrand(position, origin);
+    }
+    return sum * cellVolume;
+}
+
+TEMPLATE_TEST_CASE("Kernels are normalized", "[kernel]",
+                   CubicSplineKernel<1>, CubicSplineKernel<2>, CubicSplineKernel<3>,
+                   WendlandC2Kernel<2>, WendlandC2Kernel<3>,
+                   WendlandC4Kernel<2>, WendlandC4Kernel<3>,
+                   Poly6SpikyKernel<1>, Poly6SpikyKernel<2>, Poly6SpikyKernel<3>)
+{
+    using Vector = typename TestType::Vector;
+    const TestType kernel(.7f);
+    const int steps = TestType::dimension == 3 ? 60 : TestType::dimension == 2 ? 400 : 4000;
+    // Integral of W is 1
+    const double integral = IntegrateOverSupport(kernel, steps, [&](const Vector &x, const Vector &origin) {
+        return kernel.Function(x, origin);
+    });
+    REQUIRE(Approx(1.).epsilon(1e-3) == integral);
+    // Integral of x . grad W is -dim (integration by parts), which checks the normalization of the gradient
+    const double moment = IntegrateOverSupport(kernel, steps, [&](const Vector &x, const Vector &origin) {
+        return glm::dot(x, kernel.Derivative(x, origin));
+    });
+    REQUIRE(Approx(-TestType::dimension).epsilon(1e-3) == moment);
+}
+
+TEMPLATE_TEST_CASE("Kernel derivatives are the gradients of the kernel functions", "[kernel]",
+                   CubicSplineKernel<2>, WendlandC2Kernel<2>, WendlandC4Kernel<2>)
+{
+    const float h = .7f;
+    const TestType kernel(h);
+    const float delta = 1e-3f * h;
+    const glm::vec2 origin(.3f, -.2f);
+    // No branch: zero at the origin and beyond the support
+    REQUIRE(kernel.Derivative(origin, origin) == glm::vec2(0.f, 0.f));
+    REQUIRE(kernel.Function(origin + glm::vec2(2.f * h, 0.f), origin) == 0.f);
+    REQUIRE(kernel.Derivative(origin + glm::vec2(0.f, 2.5f * h), origin) == glm::vec2(0.f, 0.f));
+    for (float q : {.2f, .7f, 1.f, 1.3f, 1.9f})
+    {
+        const glm::vec2 position = origin + q * h * glm::normalize(glm::vec2(.6f, -.8f));
+        const glm::vec2 derivative = kernel.Derivative(position, origin);
+        const float dx = (kernel.Function(position + glm::vec2(delta, 0.f), origin) - kernel.Function(position - glm::vec2(delta, 0.f), origin)) / (2.f * delta);
+        const float dy = (kernel.Function(position + glm::vec2(0.f, delta), origin) - kernel.Function(position - glm::vec2(0.f, delta), origin)) / (2.f * delta);
+        const float scale = kernel.Function(origin, origin) / h;
+        REQUIRE(Approx(dx).margin(1e-3f * scale) == derivative.x);
+        REQUIRE(Approx(dy).margin(1e-3f * scale) == derivative.y);
+        // Antisymmetry, on which pairwise force evaluation relies
+        REQUIRE(kernel.Derivative(origin, position) == -derivative);
+    }
+}
+
+TEST_CASE("Runtime kernel selection", "[kernel]")
+{
+    const glm::vec2 a(.1f, .2f), b(.5f, -.1f);
+    for (KernelType type : Kernel::Types())
+    {
+        REQUIRE(Kernel::FromName(Kernel::Name(type)) == type);
+        const Kernel kernel(.4f, type);
+        DispatchKernel<2>(type, .4f, [&](const auto &expected) {
+            REQUIRE(expected.Function(a, b) == kernel.Function(a, b));
+            REQUIRE(expected.Derivative(a, b) == kernel.Derivative(a, b));
+        });
+    }
+    REQUIRE_THROWS_AS(Kernel::FromName("gaussian"), std::invalid_argument);
+    REQUIRE_THROWS_AS(Kernel(0.f), std::invalid_argument);
+}
+
+template <KernelInterpolation Interpolation>
+static void CheckKernelTable(KernelType type, float maxFunctionError, float maxGradientError, float minDistance)
+{
+    const float h = .7f;
+    KernelTable table;
+    table.Build<2>(type, h, 1024);
+    const TabulatedKernel<2, Interpolation> tabulated(table);
+    DispatchKernel<2>(type, h, [&](const auto &kernel) {
+        const glm::vec2 origin(.3f, -.2f);
+        const glm::vec2 direction(.6f, .8f);
+        float maxGradient = 0.f;
+        for (int n = 0; n <= 10000; n++)
+        {
+            maxGradient = std::max(maxGradient, glm::length(kernel.Derivative(origin + 2.f * h * n / 10000 * direction, origin)));
+        }
+        float functionError = 0.f, gradientError = 0.f;
+        // Up to beyond the support, as with Verlet lists
+        for (int n = 0; n <= 10000; n++)
+        {
+            const float r = 2.2f * h * n / 10000;
+            const glm::vec2 position = origin + r * direction;
+            functionError = std::max(functionError, std::fabs(kernel.Function(position, origin) - tabulated.Function(position, origin)));
+            if (r >= minDistance * h)
+            {
+                gradientError = std::max(gradientError, glm::length(kernel.Derivative(position, origin) - tabulated.Derivative(position, origin)));
+            }
+        }
+        INFO(Kernel::Name(type) << (Interpolation == KernelInterpolation::Linear ? " (linear)" : " (cubic)"));
+        REQUIRE(functionError <= maxFunctionError * kernel.Function(origin, origin));
+        REQUIRE(gradientError <= maxGradientError * maxGradient);
+    });
+}
+
+TEST_CASE("Tabulated kernels stay close to the analytic kernels", "[kernel]")
+{
+    for (KernelType type : Kernel::Types())
+    {
+        // The gradient of the Spiky kernel does not vanish at r = 0, where the table cannot follow it
+        const float minDistance = type == KernelType::Poly6Spiky ? .1f : 0.f;
+        const float maxGradientError = type == KernelType::Poly6Spiky ? 5e-2f : 5e-3f;
+        CheckKernelTable<KernelInterpolation::Linear>(type, 1e-4f, maxGradientError, minDistance);
+        CheckKernelTable<KernelInterpolation::Cubic>(type, 1e-4f, maxGradientError, minDistance);
+    }
+}
+
+TEST_CASE("Batched kernels give the same results as the scalar kernel", "[kernel][simd]")
+{
+    const float h = .7f;
+    const CubicSplineKernel<2> kernel(h);
+    srand(42);
+    const glm::vec2 position(.3f, -.2f);
+    std::vector<float> x, y;
+    // Neighbors at random distances up to beyond the support, and one at the same position
+    for (int k = 0; k < 41; k++)
+    {
+        const float r = 2.2f * h * rand() / RAND_MAX;
+        const float angle = 6.2832f * rand() / RAND_MAX;
+        x.push_back(position.x + r * glm::cos(angle));
+        y.push_back(position.y + r * glm::sin(angle));
+    }
+    x[5] = position.x;
+    y[5] = position.y;
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512})
+    {
+        const KernelBatch batch(h, level);
+        INFO("Instruction set " << KernelBatch::Name(batch.Level()) << " (requested " << KernelBatch::Name(level) << ")");
+        // All tail lengths of all instruction sets
+        for (size_t count = 0; count <= x.size(); count++)
+        {
+            // Values past `count' must be left untouched
+            std::vector<float> values(count + 1, -1.f), gradientX(count + 1, -1.f), gradientY(count + 1, -1.f);
+            batch.Function(position.x, position.y, x.data(), y.data(), count, values.data());
+            batch.Derivative(position.x, position.y, x.data(), y.data(), count, gradientX.data(), gradientY.data());
+            for (size_t k = 0; k < count; k++)
+            {
+                const glm::vec2 neighbor(x[k], y[k]);
+                REQUIRE(values[k] == kernel.Function(position, neighbor));
+                REQUIRE(glm::vec2(gradientX[k], gradientY[k]) == kernel.Derivative(position, neighbor));
+            }
+            REQUIRE(values[count] == -1.f);
+            REQUIRE(gradientX[count] == -1.f);
+            REQUIRE(gradientY[count] == -1.f);
+        }
+    }
+}
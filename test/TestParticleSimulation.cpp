@@ -2,9 +2,15 @@
 
 #include "TestParticleSimulation.hpp"
 // Tested files
+#include <AdaptiveTimeStep.hpp>
+#include <Checkpoint.hpp>
+#include <ForkedSnapshot.hpp>
+#include <HistoryBuffer.hpp>
+#include <HistoryTracker.hpp>
 #include <ParticleSet.hpp>
 #include <ParticleSimulation.hpp>
 // Libraries
+#include <glm/common.hpp>          // glm::min, glm::max
 #include <glm/geometric.hpp>       // Vector maths
 #include <glm/gtx/string_cast.hpp> // For debugging
 #include <iomanip>                 // std::setw()
@@ -13,6 +19,16 @@
 #include <cstdlib>                 // Random
 #include <ctime>                   // To fix seed
 #include <cmath>                   // For cos and sin
+#include <algorithm>               // std::sort
+#include <csignal>                 // raise, SIGKILL
+#include <cstdint>                 // uint32_t
+#include <cstdio>                  // std::remove
+#include <fstream>                 // std::fstream
+#include <stdexcept>               // std::runtime_error
+#include <iterator>                // std::istreambuf_iterator
+#include <string>                  // std::string, std::to_string
+#include <sys/stat.h>              // mkdir
+#include <unistd.h>                // getpid, rmdir
 
 using namespace Catch; // Test framework
 
@@ -27,9 +43,9 @@ void RequireNeighborCountIsCorrect(ParticleSet &particleSet)
     particleSimulation.UpdateNeighbors(2 * particleSet.spacing - 1.e-5f);
     // Check number of neighbors
     std::vector<size_t> neighborsCount;
-    for (auto &&particle : particleSet.particles)
+    for (size_t i = 0; i < particleSet.particles.size(); i++)
     {
-        neighborsCount.push_back(particleSimulation.GetNeighbors(particle).size());
+        neighborsCount.push_back(particleSimulation.GetNeighborTable(0).Neighbors(i, 0).size());
     }
     REQUIRE(neighborsCount == expectedNeighborsCount);
 }
@@ -89,3 +105,700 @@ TEST_CASE("Number of neighbors is correct", "[neighbors]")
         RequireNeighborCountIsCorrect(particleSet);
     }
 }
+
+TEST_CASE("Grid neighbor search finds the same neighbors as an all-pairs search", "[neighbors]")
+{
+    const float spacing = .2f;
+    const float kernelSupport = 2 * spacing;
+    // A jittered fluid block next to a boundary block
+    ParticleSet fluid(12, 9, spacing, 0.f, 0.f, 0.f);
+    ParticleSet boundary(3, 15, spacing, 0.f, 0.f, 0.f);
+    boundary.TranslateAll(12 * spacing, -2 * spacing);
+    boundary.isBoundary = true;
+    srand(42);
+    for (auto &&particle : fluid.particles)
+    {
+        particle.position.x += (((float)rand()) / (float)(RAND_MAX)-.5f) * spacing;
+        particle.position.y += (((float)rand()) / (float)(RAND_MAX)-.5f) * spacing;
+    }
+    ParticleSimulation particleSimulation;
+    particleSimulation.AddParticleSet(fluid);
+    particleSimulation.AddParticleSet(boundary);
+    particleSimulation.UpdateNeighbors(kernelSupport);
+
+    for (size_t i = 0; i < fluid.particles.size(); i++)
+    {
+        const NeighborTable &table = particleSimulation.GetNeighborTable(0);
+        for (size_t s = 0; s < 2; s++)
+        {
+            const ParticleSet &otherSet = s == 0 ? fluid : boundary;
+            std::vector<unsigned> expected;
+            for (unsigned j = 0; j < otherSet.particles.size(); j++)
+            {
+                if (glm::distance(fluid.particles[i].position, otherSet.particles[j].position) < kernelSupport)
+                    expected.push_back(j);
+            }
+            const NeighborTable::Range range = table.Neighbors(i, s);
+            std::vector<unsigned> found(range.begin(), range.end());
+            // The order of the neighbors is not specified
+            std::sort(found.begin(), found.end());
+            REQUIRE(found == expected);
+        }
+    }
+}
+
+TEST_CASE("Fluid particles sliding along a wall are slowed by the viscosity of the wall", "[boundary]")
+{
+    const float spacing = 3.f;
+    const float boundaryViscosity = GENERATE(0.f, 1.f);
+    // One fluid particle without viscosity of its own, moving along a row of wall particles
+    ParticleSet fluid(1, 1, spacing, 3e3f, 4e7f, 0.f);
+    fluid.TranslateAll(4.f * spacing, spacing);
+    fluid.particles[0].velocity = glm::vec2(1.f, 0.f);
+    ParticleSet wall(9, 1, spacing, 3e3f, 4e7f, boundaryViscosity);
+    wall.isBoundary = true;
+    ParticleSimulation particleSimulation;
+    particleSimulation.AddParticleSet(fluid);
+    particleSimulation.AddParticleSet(wall);
+    particleSimulation.UpdateNeighbors(2.f * spacing);
+    particleSimulation.UpdateParticleQuantities(glm::vec2(0.f, 0.f));
+    const glm::vec2 viscosityAcceleration = fluid.particles[0].viscosityAcceleration;
+    REQUIRE(std::abs(viscosityAcceleration.y) < epsilon);
+    if (boundaryViscosity > 0.f)
+    {
+        REQUIRE(viscosityAcceleration.x < 0.f);
+    }
+    else
+    {
+        REQUIRE(viscosityAcceleration.x == 0.f);
+    }
+}
+
+// Fluid block in a tank made of three boundary walls, as in BoundaryExperiment.
+static std::vector<ParticleSet> MakeTank(int countX, int countY, float spacing)
+{
+    std::vector<ParticleSet> particleSets;
+    particleSets.push_back(ParticleSet(countX, countY, spacing, 3e3f, 4e7f, 2e-7f));
+    particleSets.push_back(ParticleSet(countX + 16, 3, spacing, 3e3f, 4e7f, 4e-2f));
+    particleSets.back().TranslateAll(-3.f * spacing, -3.f * spacing);
+    particleSets.push_back(ParticleSet(3, countY + 10, spacing, 3e3f, 4e7f, 4e-2f));
+    particleSets.back().TranslateAll(-3.f * spacing, 0.f);
+    particleSets.push_back(ParticleSet(3, countY + 10, spacing, 3e3f, 4e7f, 4e-2f));
+    particleSets.back().TranslateAll((countX + 10) * spacing, 0.f);
+    for (size_t s = 1; s < particleSets.size(); s++)
+    {
+        particleSets[s].isBoundary = true;
+    }
+    return particleSets;
+}
+
+static void SimulateTank(std::vector<ParticleSet> &particleSets, ParticleSimulation &particleSimulation, int steps)
+{
+    const float spacing = particleSets.front().spacing;
+    for (auto &&particleSet : particleSets)
+    {
+        particleSimulation.AddParticleSet(particleSet);
+    }
+    for (int step = 0; step < steps; step++)
+    {
+        particleSimulation.UpdateNeighbors(2.f * spacing);
+        particleSimulation.UpdateParticleQuantities(glm::vec2(0.f, -9.81f));
+        particleSimulation.UpdateParticlePositions(1e-3f);
+    }
+}
+
+TEST_CASE("Multi-threaded steps give the same results as sequential steps", "[threads]")
+{
+    std::vector<ParticleSet> sequential = MakeTank(15, 10, 3.f);
+    std::vector<ParticleSet> parallel = sequential;
+    ParticleSimulation sequentialSimulation, parallelSimulation;
+    parallelSimulation.SetThreadCount(4);
+    SimulateTank(sequential, sequentialSimulation, 50);
+    SimulateTank(parallel, parallelSimulation, 50);
+    // Each particle is updated by one thread only, in the same order, so results are identical
+    REQUIRE(sequential.front().positions == parallel.front().positions);
+    REQUIRE(sequential.front().velocities == parallel.front().velocities);
+    REQUIRE(sequential.front().densities == parallel.front().densities);
+}
+
+TEST_CASE("Verlet lists give the same results as rebuilding the neighbors on each step", "[neighbors]")
+{
+    std::vector<ParticleSet> rebuilt = MakeTank(15, 10, 3.f);
+    std::vector<ParticleSet> reused = rebuilt;
+    ParticleSimulation rebuildingSimulation, verletSimulation;
+    verletSimulation.SetVerletSkin(.5f * 3.f);
+    const int steps = 1000;
+    SimulateTank(rebuilt, rebuildingSimulation, steps);
+    SimulateTank(reused, verletSimulation, steps);
+    REQUIRE(rebuildingSimulation.GetNeighborRebuildCount() == steps);
+    REQUIRE(verletSimulation.GetNeighborUpdateCount() == steps);
+    REQUIRE(verletSimulation.GetNeighborRebuildCount() > 1);
+    REQUIRE(verletSimulation.GetNeighborRebuildCount() < steps / 2);
+    // Extra neighbors only add exact zeros and rows are sorted, so results are identical
+    REQUIRE(rebuilt.front().positions == reused.front().positions);
+    REQUIRE(rebuilt.front().velocities == reused.front().velocities);
+    REQUIRE(rebuilt.front().densities == reused.front().densities);
+}
+
+TEST_CASE("Frozen boundaries are not searched and give fluid next to a wall the density of the bulk", "[boundary]")
+{
+    std::vector<ParticleSet> particleSets = MakeTank(15, 10, 3.f);
+    ParticleSimulation particleSimulation;
+    SimulateTank(particleSets, particleSimulation, 1);
+    const StaticBoundary &staticBoundary = particleSimulation.GetStaticBoundary();
+    REQUIRE(staticBoundary.Covers(2.f * 3.f));
+    for (size_t s = 1; s < particleSets.size(); s++)
+    {
+        REQUIRE(particleSimulation.GetNeighborTable(s).RowCount() == 0);
+        REQUIRE(staticBoundary.Volumes(s).size() == particleSets[s].size());
+        for (float volume : staticBoundary.Volumes(s))
+        {
+            REQUIRE(volume > .9f * 3.f * 3.f);
+            REQUIRE(volume <= 3.f * 3.f);
+        }
+    }
+    // Particles on the floor (first of each column) and in the bulk of the fluid
+    const ParticleSet &fluid = particleSets.front();
+    const float bulkDensity = fluid.densities[5 * 10 + 5];
+    for (int x = 3; x < 12; x++)
+    {
+        REQUIRE(Approx(bulkDensity).epsilon(1e-3f) == fluid.densities[x * 10]);
+    }
+}
+
+TEST_CASE("Boundary fields give fluid next to a wall the density of the bulk and keep it in the tank", "[boundary]")
+{
+    // The walls of the tank as the boxes covered by their particles
+    std::vector<ParticleSet> particleSets = MakeTank(15, 10, 3.f);
+    const ParticleSet &fluid = particleSets.front();
+    BoundaryField boundaryField;
+    boundaryField.viscosity = 4e-2f;
+    for (size_t s = 1; s < particleSets.size(); s++)
+    {
+        glm::vec2 lower = particleSets[s].positions.front(), upper = lower;
+        for (const glm::vec2 &position : particleSets[s].positions)
+        {
+            lower = glm::min(lower, position);
+            upper = glm::max(upper, position);
+        }
+        boundaryField.AddBox(lower - 1.5f, upper + 1.5f);
+    }
+    ParticleSimulation particleSimulation;
+    particleSimulation.AddParticleSet(particleSets.front());
+    particleSimulation.SetBoundaryField(boundaryField);
+    particleSimulation.SetPressureSolver(PressureSolver::IISPH);
+    const float timeStep = .05f;
+    for (int step = 0; static_cast<float>(step) * timeStep < 10.f; step++)
+    {
+        particleSimulation.UpdateNeighbors(2.f * fluid.spacing);
+        particleSimulation.UpdateParticleQuantities(glm::vec2(0.f, -9.81f));
+        if (step == 0)
+        {
+            // Particles on the floor (first of each column) and in the bulk of the fluid
+            const float bulkDensity = fluid.densities[5 * 10 + 5];
+            for (int x = 3; x < 12; x++)
+            {
+                REQUIRE(Approx(bulkDensity).epsilon(1e-3f) == fluid.densities[x * 10]);
+            }
+        }
+        particleSimulation.SolvePressure(timeStep);
+        particleSimulation.UpdateParticlePositions(timeStep);
+    }
+    // The fluid stays in the tank: no particle goes deeper into the walls than their first layer
+    for (const glm::vec2 &position : fluid.positions)
+    {
+        REQUIRE(std::isfinite(position.x));
+        REQUIRE(std::isfinite(position.y));
+        REQUIRE(position.x > -fluid.spacing);
+        REQUIRE(position.x < 25.f * fluid.spacing);
+        REQUIRE(position.y > -fluid.spacing);
+    }
+}
+
+TEST_CASE("Boundary fields store their maps only near the surface of the shapes", "[boundary]")
+{
+    BoundaryField triangle;
+    triangle.AddPolygon({glm::vec2(0.f, 0.f), glm::vec2(4.f, 0.f), glm::vec2(0.f, 4.f)});
+    REQUIRE(Approx(-1.f) == triangle.SignedDistance(glm::vec2(1.f, 1.f)));
+    REQUIRE(Approx(1.f) == triangle.SignedDistance(glm::vec2(-1.f, 2.f)));
+    REQUIRE(Approx(std::sqrt(2.f)) == triangle.SignedDistance(glm::vec2(3.f, 3.f)));
+    // Doubling the size of a box doubles its surface, and quadruples its area
+    BoundaryField small, large;
+    small.AddBox(glm::vec2(0.f), glm::vec2(120.f));
+    large.AddBox(glm::vec2(0.f), glm::vec2(240.f));
+    small.Update(KernelType::CubicSpline, 3.f);
+    large.Update(KernelType::CubicSpline, 3.f);
+    REQUIRE(small.NodeCount() > 0);
+    REQUIRE(large.NodeCount() < 5 * small.NodeCount() / 2);
+    // Deep inside, a box covers the whole kernel and pushes nothing; on its side, half of the kernel
+    const BoundaryField::Sample inside = large.Lookup(glm::vec2(120.f));
+    REQUIRE(Approx(.5f * inside.volume).epsilon(.01f) == large.Volume(glm::vec2(0.f, 120.f)));
+    REQUIRE(inside.gradient == glm::vec2(0.f));
+    REQUIRE(large.Volume(glm::vec2(-20.f)) == 0.f);
+}
+
+TEST_CASE("Pairwise forces give the same results as per-particle forces", "[forces]")
+{
+    std::vector<ParticleSet> perParticle = MakeTank(15, 10, 3.f);
+    // Start from a disturbed state so that pressure and viscosity are not zero
+    ParticleSimulation warmUpSimulation;
+    SimulateTank(perParticle, warmUpSimulation, 100);
+    std::vector<ParticleSet> pairwise = perParticle;
+    ParticleSimulation perParticleSimulation, pairwiseSimulation;
+    pairwiseSimulation.SetPairwiseForces(true);
+    SECTION("Sequential") {}
+    SECTION("Multi-threaded") { pairwiseSimulation.SetThreadCount(3); }
+    SimulateTank(perParticle, perParticleSimulation, 1);
+    SimulateTank(pairwise, pairwiseSimulation, 1);
+    // Contributions are summed in a different order, so results only match up to rounding
+    const ParticleSet &expected = perParticle.front();
+    const ParticleSet &result = pairwise.front();
+    float pressureScale = 0.f, viscosityScale = 0.f;
+    for (size_t i = 0; i < expected.size(); i++)
+    {
+        pressureScale = std::max(pressureScale, glm::length(expected.pressureAccelerations[i]));
+        viscosityScale = std::max(viscosityScale, glm::length(expected.viscosityAccelerations[i]));
+    }
+    REQUIRE(pressureScale > 0.f);
+    REQUIRE(viscosityScale > 0.f);
+    for (size_t i = 0; i < expected.size(); i++)
+    {
+        REQUIRE(Approx(expected.densities[i]) == result.densities[i]);
+        REQUIRE(Approx(expected.pressures[i]).margin(1e-4f * expected.stiffness) == result.pressures[i]);
+        for (int k = 0; k < 2; k++)
+        {
+            REQUIRE(Approx(expected.pressureAccelerations[i][k]).margin(1e-4f * pressureScale) == result.pressureAccelerations[i][k]);
+            REQUIRE(Approx(expected.viscosityAccelerations[i][k]).margin(1e-4f * viscosityScale) == result.viscosityAccelerations[i][k]);
+        }
+    }
+}
+
+TEST_CASE("SIMD kernel batches give the same results as scalar kernels", "[simd]")
+{
+    std::vector<ParticleSet> scalar = MakeTank(15, 10, 3.f);
+    std::vector<ParticleSet> batched = scalar;
+    ParticleSimulation scalarSimulation, batchedSimulation;
+    batchedSimulation.SetSimdLevel(SimdLevel::AVX512);
+    SimulateTank(scalar, scalarSimulation, 50);
+    SimulateTank(batched, batchedSimulation, 50);
+    REQUIRE(scalar.front().positions == batched.front().positions);
+    REQUIRE(scalar.front().velocities == batched.front().velocities);
+    REQUIRE(scalar.front().densities == batched.front().densities);
+}
+
+TEST_CASE("Adaptive time steps stay within the stability constraints and grow by a limited factor", "[timestep]")
+{
+    std::vector<ParticleSet> particleSets = MakeTank(15, 10, 3.f);
+    ParticleSimulation particleSimulation;
+    SimulateTank(particleSets, particleSimulation, 20);
+    const ParticleSet &fluid = particleSets.front();
+
+    // Constraints computed by hand
+    float maxVelocity = 0.f, maxAcceleration = 0.f;
+    for (size_t i = 0; i < fluid.size(); i++)
+    {
+        maxVelocity = std::max(maxVelocity, glm::length(fluid.velocities[i]));
+        maxAcceleration = std::max(maxAcceleration, glm::length(fluid.accelerations[i]));
+    }
+    REQUIRE(maxVelocity > 0.f);
+    const float expected = std::min({.4f * fluid.spacing / maxVelocity,
+                                     .25f * std::sqrt(fluid.spacing / maxAcceleration),
+                                     .125f * fluid.spacing * fluid.spacing / 4e-2f});
+    REQUIRE(Approx(particleSimulation.ComputeTimeStep(.4f)) == expected);
+
+    // Starting from the largest step, the step drops to the constraints at once, and grows by 10% at most
+    AdaptiveTimeStep adaptiveTimeStep(1.f);
+    REQUIRE(Approx(adaptiveTimeStep.Next(particleSimulation)) == expected);
+    float previous = adaptiveTimeStep.Current();
+    for (int step = 0; step < 100; step++)
+    {
+        particleSimulation.UpdateNeighbors(2.f * fluid.spacing);
+        particleSimulation.UpdateParticleQuantities(glm::vec2(0.f, -9.81f));
+        const float timeStep = adaptiveTimeStep.Next(particleSimulation);
+        REQUIRE(timeStep <= particleSimulation.ComputeTimeStep(.4f) * (1.f + epsilon));
+        REQUIRE(timeStep <= 1.1f * previous * (1.f + epsilon));
+        REQUIRE(timeStep <= 1.f);
+        particleSimulation.UpdateParticlePositions(timeStep);
+        previous = timeStep;
+    }
+    REQUIRE(adaptiveTimeStep.Smallest() <= adaptiveTimeStep.Current());
+}
+
+TEST_CASE("Implicit pressure solvers keep the density error below their tolerance with large time steps", "[pressure]")
+{
+    const PressureSolver solver = GENERATE(PressureSolver::IISPH, PressureSolver::DFSPH, PressureSolver::PCISPH);
+    INFO(ParticleSimulation::Name(solver));
+    std::vector<ParticleSet> particleSets = MakeTank(15, 10, 3.f);
+    ParticleSimulation particleSimulation;
+    particleSimulation.SetPressureSolver(solver);
+    particleSimulation.SetPressureTolerance(1e-3f);
+    particleSimulation.SetMaxPressureIterations(100);
+    for (auto &&particleSet : particleSets)
+    {
+        particleSimulation.AddParticleSet(particleSet);
+    }
+    // 50 times the time step of the state equation in SimulateTank (20 times for PCISPH, less stable)
+    const float timeStep = solver == PressureSolver::PCISPH ? .02f : .05f;
+    const ParticleSet &fluid = particleSets.front();
+    for (int step = 0; static_cast<float>(step) * timeStep < 10.f; step++)
+    {
+        particleSimulation.UpdateNeighbors(2.f * fluid.spacing);
+        particleSimulation.UpdateParticleQuantities(glm::vec2(0.f, -9.81f));
+        particleSimulation.SolvePressure(timeStep);
+        particleSimulation.UpdateParticlePositions(timeStep);
+        REQUIRE(particleSimulation.GetDensityIterations() >= 1);
+        // The solver converges before its iteration limit, on every step
+        REQUIRE(particleSimulation.GetDensityIterations() < 100);
+        REQUIRE(particleSimulation.GetDensityError() <= 1e-3f);
+        // The other iterations are those of the divergence-free solver of DFSPH
+        REQUIRE(particleSimulation.GetPressureIterations() - particleSimulation.GetDensityIterations() < 100);
+    }
+    // The fluid stays in the tank
+    for (const glm::vec2 &position : fluid.positions)
+    {
+        REQUIRE(std::isfinite(position.x));
+        REQUIRE(std::isfinite(position.y));
+        REQUIRE(position.x > -3.f * fluid.spacing);
+        REQUIRE(position.x < 28.f * fluid.spacing);
+        REQUIRE(position.y > -3.f * fluid.spacing);
+    }
+}
+
+TEST_CASE("Bounded histories keep the recent samples and the extremes of the older ones in constant memory", "[history]")
+{
+    HistoryBuffer history(16, 3, 2);
+    std::vector<float> times, values;
+    for (int sample = 0; sample < 10000; sample++)
+    {
+        // A single peak, long before the last samples
+        history.Push(static_cast<float>(sample), sample == 40 ? 100.f : static_cast<float>(sample % 7));
+        // Full rings, and the pending buckets of the coarser levels
+        REQUIRE(history.Size() <= 3 * 16 + 2);
+    }
+    REQUIRE(history.Count() == 10000);
+    REQUIRE(history.LastTime() == 9999.f);
+    REQUIRE(history.LastValue() == static_cast<float>(9999 % 7));
+    history.Linearize(times, values);
+    REQUIRE(std::is_sorted(times.begin(), times.end()));
+    // The last 16 samples are exact
+    for (int k = 1; k <= 16; k++)
+    {
+        REQUIRE(times[times.size() - k] == static_cast<float>(10000 - k));
+        REQUIRE(values[values.size() - k] == static_cast<float>((10000 - k) % 7));
+    }
+    REQUIRE(*std::max_element(values.begin(), values.end()) == 6.f);
+
+    // Without dropping buckets, the peak survives the decimation
+    HistoryBuffer deep(16, 12, 2);
+    for (int sample = 0; sample < 10000; sample++)
+    {
+        deep.Push(static_cast<float>(sample), sample == 40 ? 100.f : static_cast<float>(sample % 7));
+    }
+    deep.Linearize(times, values);
+    REQUIRE(deep.FirstTime() == 0.f);
+    REQUIRE(*std::max_element(values.begin(), values.end()) == 100.f);
+    REQUIRE(*std::min_element(values.begin(), values.end()) == 0.f);
+}
+
+TEST_CASE("History trackers record the tracked particles only", "[history]")
+{
+    std::vector<ParticleSet> particleSets = MakeTank(15, 10, 3.f);
+    ParticleSimulation particleSimulation;
+    HistoryTracker bounded, unbounded;
+    bounded.SetBounds({3, 1000, 7}, 8, 2, 2);
+    bounded.SetTarget(&particleSets.front());
+    unbounded.SetTarget(&particleSets.front());
+    for (auto &&particleSet : particleSets)
+    {
+        particleSimulation.AddParticleSet(particleSet);
+    }
+    for (int step = 0; step < 100; step++)
+    {
+        particleSimulation.UpdateNeighbors(2.f * 3.f);
+        particleSimulation.UpdateParticleQuantities(glm::vec2(0.f, -9.81f));
+        particleSimulation.UpdateParticlePositions(1e-3f);
+        bounded.Step(1e-3f * (step + 1), 1e-3f);
+        unbounded.Step(1e-3f * (step + 1), 1e-3f);
+    }
+    // Index 1000 is out of the set
+    REQUIRE(bounded.TrackedParticles() == std::vector<size_t>{3, 7});
+    REQUIRE(bounded.density.size() == 2);
+    REQUIRE(unbounded.density.size() == particleSets.front().size());
+    REQUIRE(bounded.StepCount() == 100);
+    REQUIRE(bounded.density[1].Size() <= 2 * 8 + 2);
+    REQUIRE(unbounded.density[7].Size() == 100);
+    REQUIRE(bounded.density[1].LastValue() == unbounded.density[7].LastValue());
+    REQUIRE(bounded.maxDistance.LastValue() == unbounded.maxDistance.LastValue());
+}
+
+TEST_CASE("Resuming from a checkpoint gives the same results as not stopping", "[checkpoint]")
+{
+    const bool withNeighbors = GENERATE(false, true);
+    INFO("neighbor lists saved: " << withNeighbors);
+    const std::string path = "test-checkpoint.bin";
+    const float timeStep = .02f;
+    const auto configure = [](ParticleSimulation &particleSimulation) {
+        particleSimulation.SetPressureSolver(PressureSolver::IISPH);
+        particleSimulation.SetVerletSkin(.5f * 3.f);
+    };
+    const auto simulate = [&](ParticleSimulation &particleSimulation, int steps) {
+        for (int step = 0; step < steps; step++)
+        {
+            particleSimulation.UpdateNeighbors(2.f * 3.f);
+            particleSimulation.UpdateParticleQuantities(glm::vec2(0.f, -9.81f));
+            particleSimulation.SolvePressure(timeStep);
+            particleSimulation.UpdateParticlePositions(timeStep);
+        }
+    };
+    std::vector<ParticleSet> continued = MakeTank(15, 10, 3.f);
+    ParticleSimulation continuedSimulation;
+    configure(continuedSimulation);
+    for (auto &&particleSet : continued)
+    {
+        continuedSimulation.AddParticleSet(particleSet);
+    }
+    simulate(continuedSimulation, 20);
+    Checkpoint saved;
+    saved.currentTime = 20 * timeStep;
+    saved.timeStep = timeStep;
+    if (withNeighbors)
+    {
+        saved.neighbors = continuedSimulation.GetNeighborState();
+    }
+    saved.Save(path, continued);
+    const unsigned long rebuildsBefore = continuedSimulation.GetNeighborRebuildCount();
+    simulate(continuedSimulation, 30);
+
+    std::vector<ParticleSet> resumed;
+    Checkpoint loaded;
+    loaded.Load(path, resumed);
+    std::remove(path.c_str());
+    REQUIRE(loaded.currentTime == saved.currentTime);
+    REQUIRE(loaded.timeStep == timeStep);
+    REQUIRE(loaded.neighbors.tables.size() == (withNeighbors ? continued.size() : 0));
+    REQUIRE(resumed.size() == continued.size());
+    ParticleSimulation resumedSimulation;
+    configure(resumedSimulation);
+    for (auto &&particleSet : resumed)
+    {
+        resumedSimulation.AddParticleSet(particleSet);
+    }
+    resumedSimulation.SetNeighborState(loaded.neighbors);
+    simulate(resumedSimulation, 30);
+    if (withNeighbors)
+    {
+        // The saved lists are reused until the same rebuilds
+        REQUIRE(resumedSimulation.GetNeighborRebuildCount() == continuedSimulation.GetNeighborRebuildCount() - rebuildsBefore);
+    }
+    for (size_t s = 0; s < continued.size(); s++)
+    {
+        REQUIRE(resumed[s].isBoundary == continued[s].isBoundary);
+        REQUIRE(resumed[s].particleMass() == continued[s].particleMass());
+        REQUIRE(resumed[s].positions == continued[s].positions);
+        REQUIRE(resumed[s].velocities == continued[s].velocities);
+        REQUIRE(resumed[s].densities == continued[s].densities);
+        REQUIRE(resumed[s].pressures == continued[s].pressures);
+    }
+}
+
+TEST_CASE("Checkpoints of other versions are rejected", "[checkpoint]")
+{
+    const std::string path = "test-checkpoint.bin";
+    Checkpoint().Save(path, MakeTank(5, 5, 3.f));
+    {
+        // Version after the 8 characters of the magic number
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(8);
+        const uint32_t version = Checkpoint::version + 1;
+        file.write(reinterpret_cast<const char *>(&version), sizeof(version));
+    }
+    std::vector<ParticleSet> particleSets;
+    REQUIRE_THROWS_AS(Checkpoint().Load(path, particleSets), std::runtime_error);
+    REQUIRE(particleSets.empty());
+    std::remove(path.c_str());
+    REQUIRE_THROWS_AS(Checkpoint().Load(path, particleSets), std::runtime_error);
+}
+
+TEST_CASE("Truncated and corrupt checkpoints are rejected", "[checkpoint]")
+{
+    const std::string path = "test-checkpoint.bin";
+    std::vector<ParticleSet> particleSets = MakeTank(5, 5, 3.f);
+    Checkpoint().Save(path, particleSets);
+    std::string contents;
+    {
+        std::ifstream file(path, std::ios::binary);
+        contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    REQUIRE(contents.size() > 1024);
+    std::vector<ParticleSet> loaded;
+    Checkpoint().Load(path, loaded);
+    REQUIRE(loaded.size() == particleSets.size());
+    const auto rewrite = [&](const std::string &data) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(data.data(), data.size());
+    };
+    SECTION("Body cut after the header")
+    {
+        rewrite(contents.substr(0, 128));
+    }
+    SECTION("Tail zeroed, as by a save that died")
+    {
+        std::string zeroed = contents;
+        std::fill(zeroed.begin() + zeroed.size() / 2, zeroed.end(), '\0');
+        rewrite(zeroed);
+    }
+    loaded.clear();
+    REQUIRE_THROWS_AS(Checkpoint().Load(path, loaded), std::runtime_error);
+    REQUIRE(loaded.empty());
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Failed checkpoint saves leave the previous checkpoint intact", "[checkpoint]")
+{
+    const std::string path = "test-checkpoint.bin";
+    Checkpoint saved;
+    saved.currentTime = 1.f;
+    saved.Save(path, MakeTank(5, 5, 3.f));
+    // A directory in the way of the temporary file makes the next save fail
+    const std::string temporaryPath = Checkpoint::TemporaryPath(path, getpid());
+    REQUIRE(mkdir(temporaryPath.c_str(), 0755) == 0);
+    Checkpoint failed;
+    failed.currentTime = 2.f;
+    REQUIRE_THROWS_AS(failed.Save(path, MakeTank(6, 6, 3.f)), std::runtime_error);
+    rmdir(temporaryPath.c_str());
+    std::vector<ParticleSet> loaded;
+    Checkpoint checkpoint;
+    checkpoint.Load(path, loaded);
+    std::remove(path.c_str());
+    REQUIRE(checkpoint.currentTime == 1.f);
+    REQUIRE(loaded.front().size() == 25);
+}
+
+TEST_CASE("Forked snapshots save the state at the fork while the simulation continues", "[checkpoint]")
+{
+    const std::string path = "test-snapshot.bin";
+    std::vector<ParticleSet> particleSets = MakeTank(15, 10, 3.f);
+    const std::vector<ParticleSet> forked = particleSets;
+    ForkedSnapshot snapshot;
+    REQUIRE(snapshot.Start([&] {
+        Checkpoint checkpoint;
+        checkpoint.currentTime = 1.f;
+        checkpoint.Save(path, particleSets);
+    }));
+    // Modified by the parent only
+    for (auto &&particleSet : particleSets)
+    {
+        for (auto &&position : particleSet.positions)
+        {
+            position += glm::vec2(1.f, 2.f);
+        }
+    }
+    REQUIRE(snapshot.Wait());
+    REQUIRE_FALSE(snapshot.IsWriting());
+    REQUIRE(snapshot.WrittenCount() == 1);
+    REQUIRE(snapshot.PauseSeconds() <= snapshot.WriteSeconds());
+    std::vector<ParticleSet> loaded;
+    Checkpoint checkpoint;
+    checkpoint.Load(path, loaded);
+    REQUIRE(checkpoint.currentTime == 1.f);
+    REQUIRE(loaded.size() == forked.size());
+    for (size_t s = 0; s < forked.size(); s++)
+    {
+        REQUIRE(loaded[s].positions == forked[s].positions);
+    }
+
+    // Failures of the child are reported to the parent
+    REQUIRE(snapshot.Start([] { throw std::runtime_error("Cannot write"); }));
+    REQUIRE_FALSE(snapshot.Wait());
+    REQUIRE(snapshot.FailedCount() == 1);
+    REQUIRE_FALSE(snapshot.Succeeded());
+
+    // A child killed while writing leaves its temporary file, and the previous snapshot intact
+    REQUIRE(snapshot.Start([&] {
+        std::ofstream(Checkpoint::TemporaryPath(path, getpid())) << "partial";
+        raise(SIGKILL);
+    }));
+    REQUIRE_FALSE(snapshot.Wait());
+    REQUIRE(snapshot.FailedCount() == 2);
+    REQUIRE(std::remove(Checkpoint::TemporaryPath(path, snapshot.LastChild()).c_str()) == 0);
+    checkpoint.Load(path, loaded);
+    std::remove(path.c_str());
+    REQUIRE(checkpoint.currentTime == 1.f);
+}
+
+TEST_CASE("Hydrostatic initialization gives each row the weight of the rows above it", "[initialization]")
+{
+    const float gravity = 9.81f;
+    ParticleSet grid(4, 5, 3.f, 3e3f, 4e7f, 2e-7f);
+    grid.TranslateAll(1.f, 2.f);
+    ParticleSet incompressible = grid, compressible = grid;
+    incompressible.InitHydrostatic(gravity, false);
+    compressible.InitHydrostatic(gravity, true);
+    REQUIRE(incompressible.positions == grid.positions);
+    for (size_t i = 0; i < grid.size(); i++)
+    {
+        // Particles are numbered column by column, from the bottom
+        const int rowsAbove = 4 - static_cast<int>(i % 5);
+        INFO("particle " << i);
+        REQUIRE(Approx(3e3f * gravity * 3.f * rowsAbove) == incompressible.pressures[i]);
+        REQUIRE(incompressible.densities[i] == 3e3f);
+        REQUIRE(compressible.pressures[i] == incompressible.pressures[i]);
+        REQUIRE(Approx(3e3f * (1.f + compressible.pressures[i] / 4e7f)) == compressible.densities[i]);
+        // Compressed towards the floor, below the bottom row
+        REQUIRE(compressible.positions[i].x == grid.positions[i].x);
+        REQUIRE(compressible.positions[i].y < grid.positions[i].y);
+        REQUIRE(compressible.positions[i].y > grid.positions[i].y - 3.f);
+    }
+}
+
+TEST_CASE("Hydrostatic initialization and relaxation shorten the settling of a tank", "[initialization]")
+{
+    // Mean speed of the fluid filling the width of a tank after 100 steps of the state equation
+    const auto settle = [](bool hydrostatic, unsigned relaxationSteps) {
+        const float spacing = 3.f;
+        const glm::vec2 gravity(0.f, -9.81f);
+        std::vector<ParticleSet> particleSets;
+        particleSets.push_back(ParticleSet(20, 10, spacing, 3e3f, 4e7f, 2e-7f));
+        particleSets.push_back(ParticleSet(26, 3, spacing, 3e3f, 4e7f, 4e-2f));
+        particleSets.back().TranslateAll(-3.f * spacing, -3.f * spacing);
+        particleSets.push_back(ParticleSet(3, 20, spacing, 3e3f, 4e7f, 4e-2f));
+        particleSets.back().TranslateAll(-3.f * spacing, 0.f);
+        particleSets.push_back(ParticleSet(3, 20, spacing, 3e3f, 4e7f, 4e-2f));
+        particleSets.back().TranslateAll(20.f * spacing, 0.f);
+        for (size_t s = 1; s < particleSets.size(); s++)
+        {
+            particleSets[s].isBoundary = true;
+        }
+        if (hydrostatic)
+        {
+            particleSets.front().InitHydrostatic(-gravity.y, true);
+        }
+        ParticleSimulation particleSimulation;
+        for (auto &&particleSet : particleSets)
+        {
+            particleSimulation.AddParticleSet(particleSet);
+        }
+        particleSimulation.Relax(2.f * spacing, gravity, 4e-3f, relaxationSteps, .8f);
+        for (const glm::vec2 &velocity : particleSets.front().velocities)
+        {
+            REQUIRE(velocity == glm::vec2(0.f));
+        }
+        for (int step = 0; step < 100; step++)
+        {
+            particleSimulation.UpdateNeighbors(2.f * spacing);
+            particleSimulation.UpdateParticleQuantities(gravity);
+            particleSimulation.SolvePressure(1e-3f);
+            particleSimulation.UpdateParticlePositions(1e-3f);
+        }
+        float meanSpeed = 0.f;
+        for (const glm::vec2 &velocity : particleSets.front().velocities)
+        {
+            meanSpeed += glm::length(velocity) / particleSets.front().size();
+        }
+        return meanSpeed;
+    };
+    const float grid = settle(false, 0), hydrostatic = settle(true, 0), relaxed = settle(true, 100);
+    INFO("mean speeds: " << grid << ", " << hydrostatic << ", " << relaxed);
+    REQUIRE(hydrostatic < .25f * grid);
+    REQUIRE(relaxed < .75f * hydrostatic);
+}
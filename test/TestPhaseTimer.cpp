@@ -0,0 +1,38 @@
+#include "catch_amalgamated.hpp" // Test framework
+
+// Tested files
+#include <PhaseTimer.hpp>
+// Libraries
+#include <vector> // std::vector
+
+using namespace Catch; // Test framework
+
+TEST_CASE("Phase timings keep rolling statistics of the last frames", "[timer]")
+{
+    PhaseTimings timings(100);
+    REQUIRE(timings.FrameCount() == 0);
+    REQUIRE(timings.GetStatistics(Phase::Integration).mean == 0.f);
+
+    // 150 frames of k ms each: only the last 100 (50 to 149 ms) are kept
+    for (int k = 0; k < 150; k++)
+    {
+        timings.Add(Phase::Integration, k * .0005);
+        timings.Add(Phase::Integration, k * .0005);
+        timings.EndFrame();
+    }
+    REQUIRE(timings.FrameCount() == 100);
+    const PhaseTimings::Statistics statistics = timings.GetStatistics(Phase::Integration);
+    CHECK(statistics.mean == Approx(99.5f));
+    CHECK(statistics.p50 == Approx(99.f));
+    CHECK(statistics.p99 == Approx(148.f));
+    CHECK(timings.GetStatistics(Phase::NeighborSearch).p99 == 0.f);
+
+    std::vector<float> history;
+    timings.GetHistory(Phase::Integration, history);
+    REQUIRE(history.size() == 100);
+    CHECK(history.front() == Approx(50.f));
+    CHECK(history.back() == Approx(149.f));
+
+    timings.Clear();
+    CHECK(timings.FrameCount() == 0);
+}
@@ -0,0 +1,88 @@
+#include "catch_amalgamated.hpp" // Test framework
+
+// Tested files
+#include <ThreadPool.hpp>
+#include <TraceRecorder.hpp>
+// Libraries
+#include <cstdio>   // std::remove
+#include <fstream>  // std::ifstream
+#include <iterator> // std::istreambuf_iterator
+#include <string>   // std::string
+
+using namespace Catch; // Test framework
+
+static size_t CountOccurrences(const std::string &text, const std::string &pattern)
+{
+    size_t count = 0;
+    for (size_t position = text.find(pattern); position != std::string::npos; position = text.find(pattern, position + 1))
+    {
+        count++;
+    }
+    return count;
+}
+
+TEST_CASE("The trace recorder writes the scopes of all threads", "[trace]")
+{
+    const std::string path = "test-trace.json";
+    TraceRecorder &recorder = TraceRecorder::Global();
+    {
+        // Not recording: nothing is recorded
+        TraceScope scope("Ignored");
+    }
+    recorder.Start(path);
+    REQUIRE(recorder.IsRecording());
+    ThreadPool threadPool(4);
+    for (int k = 0; k < 10; k++)
+    {
+        TraceScope scope("Loop");
+        threadPool.ParallelFor(4, [](size_t, size_t, unsigned) {
+            TraceScope scope("Chunk");
+        });
+    }
+    recorder.Stop();
+    REQUIRE_FALSE(recorder.IsRecording());
+    CHECK(recorder.DroppedEventCount() == 0);
+
+    std::ifstream file(path);
+    const std::string trace((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    CHECK(trace.compare(0, 15, "{\"displayTimeUn") == 0);
+    CHECK(trace.substr(trace.size() - 3) == "]}\n");
+    CHECK(CountOccurrences(trace, "\"name\":\"Loop\"") == 10);
+    CHECK(CountOccurrences(trace, "\"name\":\"Chunk\"") == 40);
+    CHECK(CountOccurrences(trace, "\"name\":\"Ignored\"") == 0);
+    // One thread name per thread that recorded
+    CHECK(CountOccurrences(trace, "\"thread_name\"") >= 4);
+    file.close();
+    std::remove(path.c_str());
+}
+
+TEST_CASE("The trace recorder reuses the buffers of exited threads", "[trace]")
+{
+    const std::string path = "test-trace.json";
+    TraceRecorder &recorder = TraceRecorder::Global();
+    recorder.Start(path);
+    size_t bufferCount = 0;
+    // As when the thread count is changed while recording
+    for (int k = 0; k < 5; k++)
+    {
+        ThreadPool threadPool(4);
+        threadPool.ParallelFor(4, [](size_t, size_t, unsigned) {
+            TraceScope scope("Chunk");
+        });
+        if (k == 0)
+        {
+            bufferCount = recorder.BufferCount();
+        }
+    }
+    REQUIRE(bufferCount >= 4);
+    REQUIRE(recorder.BufferCount() == bufferCount);
+    recorder.Stop();
+
+    std::ifstream file(path);
+    const std::string trace((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    CHECK(CountOccurrences(trace, "\"name\":\"Chunk\"") == 20);
+    // Only the threads that recorded are named
+    CHECK(CountOccurrences(trace, "\"thread_name\"") <= bufferCount);
+    file.close();
+    std::remove(path.c_str());
+}